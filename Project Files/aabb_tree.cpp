@@ -0,0 +1,319 @@
+#include <algorithm>
+
+#include "aabb_tree.h"
+
+using namespace std;
+
+/* Fat boxes are stretched by this many times the last move */
+static const float DISPLACEMENT_MULTIPLIER = 2.0f;
+
+static Box combine(const Box& a, const Box& b)
+{
+	Box c;
+	c.xmin = a.xmin < b.xmin ? a.xmin : b.xmin;
+	c.xmax = a.xmax > b.xmax ? a.xmax : b.xmax;
+	c.ymin = a.ymin < b.ymin ? a.ymin : b.ymin;
+	c.ymax = a.ymax > b.ymax ? a.ymax : b.ymax;
+	return c;
+}
+
+static real perimeter(const Box& b)
+{
+	return 2 * ((b.xmax - b.xmin) + (b.ymax - b.ymin));
+}
+
+static bool contains(const Box& outer, const Box& inner)
+{
+	return outer.xmin <= inner.xmin && outer.xmax >= inner.xmax && outer.ymin <= inner.ymin && outer.ymax >= inner.ymax;
+}
+
+static bool overlaps(const Box& a, const Box& b)
+{
+	return a.xmin <= b.xmax && a.xmax >= b.xmin && a.ymin <= b.ymax && a.ymax >= b.ymin;
+}
+
+void AabbTree::clear()
+{
+	nodes.clear();
+	moved_leaves.clear();
+	root = -1;
+	free_list = -1;
+	leaves = 0;
+}
+
+int AabbTree::allocateNode()
+{
+	int i;
+	if(free_list >= 0)
+	{
+		i = free_list;
+		free_list = nodes[i].parent;
+	}
+	else
+	{
+		i = (int)nodes.size();
+		nodes.push_back(AabbNode());
+	}
+	AabbNode& n = nodes[i];
+	n.parent = -1;
+	n.child1 = -1;
+	n.child2 = -1;
+	n.height = 0;
+	n.item = -1;
+	n.moved = 0;
+	return i;
+}
+
+/* Free nodes are chained through parent */
+void AabbTree::freeNode(int i)
+{
+	nodes[i].parent = free_list;
+	nodes[i].height = -1;
+	nodes[i].moved = 0;
+	free_list = i;
+}
+
+int AabbTree::insert(const Box& box, int item)
+{
+	int leaf = allocateNode();
+	Box& fat = nodes[leaf].box;
+	fat.xmin = box.xmin - margin;
+	fat.xmax = box.xmax + margin;
+	fat.ymin = box.ymin - margin;
+	fat.ymax = box.ymax + margin;
+	nodes[leaf].item = item;
+	insertLeaf(leaf);
+	nodes[leaf].moved = 1;
+	moved_leaves.push_back(leaf);
+	leaves++;
+	return leaf;
+}
+
+void AabbTree::remove(int leaf)
+{
+	removeLeaf(leaf);
+	freeNode(leaf);
+	leaves--;
+}
+
+int AabbTree::move(int leaf, const Box& box, real dx, real dy)
+{
+	if(contains(nodes[leaf].box, box))
+		return 0;
+
+	removeLeaf(leaf);
+	Box fat = { box.xmin - margin, box.xmax + margin, box.ymin - margin, box.ymax + margin };
+	// Leave room along the motion so the next few moves fit
+	dx *= DISPLACEMENT_MULTIPLIER;
+	dy *= DISPLACEMENT_MULTIPLIER;
+	if(dx < 0) fat.xmin += dx; else fat.xmax += dx;
+	if(dy < 0) fat.ymin += dy; else fat.ymax += dy;
+	nodes[leaf].box = fat;
+	insertLeaf(leaf);
+	if(!nodes[leaf].moved)
+	{
+		nodes[leaf].moved = 1;
+		moved_leaves.push_back(leaf);
+	}
+	return 1;
+}
+
+/* Box and height of an inner node from its children */
+void AabbTree::refit(int i)
+{
+	AabbNode& n = nodes[i];
+	const AabbNode& c1 = nodes[n.child1];
+	const AabbNode& c2 = nodes[n.child2];
+	n.box = combine(c1.box, c2.box);
+	n.height = 1 + (c1.height > c2.height ? c1.height : c2.height);
+}
+
+void AabbTree::insertLeaf(int leaf)
+{
+	if(root < 0)
+	{
+		root = leaf;
+		nodes[leaf].parent = -1;
+		return;
+	}
+
+	// Walk down towards the sibling that makes the tree perimeter grow
+	// least: staying here costs the new parent, going down costs the
+	// growth of this node for everything below plus the best child
+	Box leaf_box = nodes[leaf].box;
+	int i = root;
+	while(nodes[i].child1 >= 0)
+	{
+		int c1 = nodes[i].child1, c2 = nodes[i].child2;
+		real area = perimeter(nodes[i].box);
+		real combined = perimeter(combine(nodes[i].box, leaf_box));
+		real cost = 2 * combined;
+		real inherited = 2 * (combined - area);
+
+		real cost1 = perimeter(combine(leaf_box, nodes[c1].box)) + inherited;
+		if(nodes[c1].child1 >= 0)
+			cost1 -= perimeter(nodes[c1].box);
+		real cost2 = perimeter(combine(leaf_box, nodes[c2].box)) + inherited;
+		if(nodes[c2].child1 >= 0)
+			cost2 -= perimeter(nodes[c2].box);
+
+		if(cost < cost1 && cost < cost2)
+			break;
+		i = cost1 < cost2 ? c1 : c2;
+	}
+
+	int sibling = i;
+	int old_parent = nodes[sibling].parent;
+	int parent = allocateNode();
+	nodes[parent].parent = old_parent;
+	nodes[parent].child1 = sibling;
+	nodes[parent].child2 = leaf;
+	nodes[sibling].parent = parent;
+	nodes[leaf].parent = parent;
+	if(old_parent < 0)
+		root = parent;
+	else if(nodes[old_parent].child1 == sibling)
+		nodes[old_parent].child1 = parent;
+	else
+		nodes[old_parent].child2 = parent;
+
+	for(i = parent; i >= 0; i = nodes[i].parent)
+	{
+		refit(i);
+		i = balance(i);
+	}
+}
+
+void AabbTree::removeLeaf(int leaf)
+{
+	if(leaf == root)
+	{
+		root = -1;
+		return;
+	}
+
+	int parent = nodes[leaf].parent;
+	int grand = nodes[parent].parent;
+	int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+	freeNode(parent);
+	nodes[sibling].parent = grand;
+	if(grand < 0)
+	{
+		root = sibling;
+		return;
+	}
+	if(nodes[grand].child1 == parent)
+		nodes[grand].child1 = sibling;
+	else
+		nodes[grand].child2 = sibling;
+	for(int i = grand; i >= 0; i = nodes[i].parent)
+	{
+		refit(i);
+		i = balance(i);
+	}
+}
+
+/* If one child of a is more than one level taller than the other, rotates
+ * it up to take the place of a and hands its shorter child down to a.
+ * Returns the node now at the place of a. */
+int AabbTree::balance(int a)
+{
+	if(nodes[a].child1 < 0 || nodes[a].height < 2)
+		return a;
+
+	int b = nodes[a].child1, c = nodes[a].child2;
+	int diff = nodes[c].height - nodes[b].height;
+	if(diff >= -1 && diff <= 1)
+		return a;
+
+	int up = diff > 1 ? c : b;
+	int f = nodes[up].child1, g = nodes[up].child2;
+
+	// up replaces a under a's parent and takes a as its first child
+	nodes[up].child1 = a;
+	nodes[up].parent = nodes[a].parent;
+	nodes[a].parent = up;
+	if(nodes[up].parent < 0)
+		root = up;
+	else if(nodes[nodes[up].parent].child1 == a)
+		nodes[nodes[up].parent].child1 = up;
+	else
+		nodes[nodes[up].parent].child2 = up;
+
+	// up keeps its taller child, a gets the shorter one in up's old place
+	int keep = nodes[f].height > nodes[g].height ? f : g;
+	int give = keep == f ? g : f;
+	nodes[up].child2 = keep;
+	if(up == c)
+		nodes[a].child2 = give;
+	else
+		nodes[a].child1 = give;
+	nodes[give].parent = a;
+
+	refit(a);
+	refit(up);
+	return up;
+}
+
+void AabbTree::query(const Box& region, vector<int>& out) const
+{
+	out.clear();
+	if(root < 0)
+		return;
+	stack.clear();
+	stack.push_back(root);
+	while(!stack.empty())
+	{
+		int i = stack.back();
+		stack.pop_back();
+		const AabbNode& n = nodes[i];
+		if(!overlaps(n.box, region))
+			continue;
+		if(n.child1 < 0)
+			out.push_back(n.item);
+		else
+		{
+			stack.push_back(n.child1);
+			stack.push_back(n.child2);
+		}
+	}
+}
+
+void AabbTree::findPairs(vector<pair<int, int> >& pairs)
+{
+	pairs.clear();
+	for(int k = 0; k < (int)moved_leaves.size(); k++)
+	{
+		int leaf = moved_leaves[k];
+		if(nodes[leaf].height != 0 || !nodes[leaf].moved)
+			continue; // removed since
+		const Box& box = nodes[leaf].box;
+		stack.clear();
+		stack.push_back(root);
+		while(!stack.empty())
+		{
+			int i = stack.back();
+			stack.pop_back();
+			const AabbNode& n = nodes[i];
+			if(!overlaps(n.box, box))
+				continue;
+			if(n.child1 >= 0)
+			{
+				stack.push_back(n.child1);
+				stack.push_back(n.child2);
+				continue;
+			}
+			// Two moved leaves find each other twice, keep one
+			if(i == leaf || (n.moved && i < leaf))
+				continue;
+			int a = nodes[leaf].item, b = n.item;
+			pairs.push_back(a < b ? make_pair(a, b) : make_pair(b, a));
+		}
+	}
+	for(int k = 0; k < (int)moved_leaves.size(); k++)
+		nodes[moved_leaves[k]].moved = 0;
+	moved_leaves.clear();
+	// A leaf removed and reused can be listed twice
+	sort(pairs.begin(), pairs.end());
+	pairs.erase(unique(pairs.begin(), pairs.end()), pairs.end());
+}
@@ -0,0 +1,65 @@
+#ifndef AABB_TREE_H
+#define AABB_TREE_H
+
+#include <vector>
+#include <utility>
+
+#include "collision.h"
+
+struct AabbNode {
+	Box box;
+	int parent;    // -1 for the root
+	int child1;    // -1 for a leaf
+	int child2;
+	int height;    // 0 for a leaf, -1 for a free node
+	int item;      // what the leaf stands for
+	int moved;     // leaf was (re)inserted since the last findPairs()
+};
+
+/* Bounding volume tree over boxes that move. Each leaf keeps a fat box,
+ * the real box grown by margin and stretched along the last move, so a body
+ * moving a little stays inside it and the tree is only touched once it
+ * leaves it. Inserts pick the sibling that grows the tree perimeter least
+ * and rotations keep it balanced, so queries cost O(log n). */
+class AabbTree {
+public:
+	std::vector<AabbNode> nodes;
+	real margin;   // how far fat boxes stick out of the real ones
+
+	void clear();
+	/* Adds a leaf for item with the given box, returns its id */
+	int insert(const Box& box, int item);
+	void remove(int leaf);
+	/* New box of a leaf that moved by (dx, dy) since the last call. Only
+	 * re-inserts it when box left the fat box; returns 1 if it did. */
+	int move(int leaf, const Box& box, real dx, real dy);
+
+	/* Items of the leaves whose fat box overlaps region, in any order */
+	void query(const Box& region, std::vector<int>& out) const;
+	/* Pairs of items (smaller first, sorted) whose fat boxes overlap, at
+	 * least one of them moved since the last call. Only the moved leaves
+	 * query the tree, so the cost is O(m log n) for m moved leaves. */
+	void findPairs(std::vector<std::pair<int, int> >& pairs);
+
+	int size() const { return leaves; }
+	int height() const { return root < 0 ? 0 : nodes[root].height; }
+
+private:
+	int root;
+	int free_list;
+	int leaves;
+	std::vector<int> moved_leaves;
+	mutable std::vector<int> stack;
+
+	int allocateNode();
+	void freeNode(int i);
+	void insertLeaf(int leaf);
+	void removeLeaf(int leaf);
+	void refit(int i);
+	int balance(int a);
+
+public:
+	AabbTree() : margin(0.05f), root(-1), free_list(-1), leaves(0) {}
+};
+
+#endif
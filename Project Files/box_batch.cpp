@@ -0,0 +1,169 @@
+#include <cmath>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "box_batch.h"
+
+/* Arrays are padded to a multiple of this so kernels never need a tail loop */
+static const int LANES = 8;
+
+/* Padding boxes sit at (FAR, FAR) with no size, where nothing reaches them.
+ * Stands in for 1/0 as well, so no lane ever computes 0 * inf. */
+static const float FAR = 1e30f;
+
+void BoxBatch::clear()
+{
+	count = 0;
+	xmin.clear();
+	xmax.clear();
+	ymin.clear();
+	ymax.clear();
+	item.clear();
+}
+
+int BoxBatch::add(const Box& b, int id)
+{
+	int i = count;
+	if(count + 1 > (int)xmin.size())
+	{
+		int padded = (count + LANES) / LANES * LANES;
+		xmin.resize(padded, FAR);
+		xmax.resize(padded, FAR);
+		ymin.resize(padded, FAR);
+		ymax.resize(padded, FAR);
+		item.resize(padded, -1);
+	}
+	count++;
+	xmin[i] = b.xmin;
+	xmax[i] = b.xmax;
+	ymin[i] = b.ymin;
+	ymax[i] = b.ymax;
+	item[i] = id;
+	return i;
+}
+
+void BoxBatch::pad()
+{
+	int padded = (count + LANES - 1) / LANES * LANES;
+	xmin.resize(padded, FAR);
+	xmax.resize(padded, FAR);
+	ymin.resize(padded, FAR);
+	ymax.resize(padded, FAR);
+	item.resize(padded, -1);
+	count = padded;
+}
+
+static float inverse(float d)
+{
+	return fabs(d) > 1 / FAR ? 1 / d : FAR;
+}
+
+/* Slab test: the move enters the grown box at the latest of the times it
+ * crosses into the x and y slabs and leaves it at the earliest exit. The
+ * vector kernels do the same operations in the same order. */
+int BoxBatch::sweepCircleScalar(float x0, float y0, float dx, float dy, float r, int begin, int end)
+{
+	float ix = inverse(dx), iy = inverse(dy);
+	hits.assign((end - begin) / 32 + 1, 0);
+	int count = 0;
+	for(int i = begin; i < end; i++)
+	{
+		float ax = (xmin[i] - r - x0) * ix, bx = (xmax[i] + r - x0) * ix;
+		float ay = (ymin[i] - r - y0) * iy, by = (ymax[i] + r - y0) * iy;
+		float lx = ax < bx ? ax : bx, hx = ax > bx ? ax : bx;
+		float ly = ay < by ? ay : by, hy = ay > by ? ay : by;
+		float enter = lx > ly ? lx : ly;
+		float leave = hx < hy ? hx : hy;
+		enter = enter > 0 ? enter : 0;
+		leave = leave < 1 ? leave : 1;
+		if(enter <= leave)
+		{
+			hits[(i - begin) >> 5] |= 1u << ((i - begin) & 31);
+			count++;
+		}
+	}
+	return count;
+}
+
+#if defined(__AVX2__)
+
+const char* boxKernelName() { return "avx2"; }
+
+int BoxBatch::sweepCircle(float x0, float y0, float dx, float dy, float r, int begin, int end)
+{
+	const __m256 vx0 = _mm256_set1_ps(x0);
+	const __m256 vy0 = _mm256_set1_ps(y0);
+	const __m256 vr = _mm256_set1_ps(r);
+	const __m256 ix = _mm256_set1_ps(inverse(dx));
+	const __m256 iy = _mm256_set1_ps(inverse(dy));
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+
+	hits.assign((end - begin) / 32 + 1, 0);
+	int count = 0;
+	for(int i = begin; i < end; i += 8)
+	{
+		__m256 ax = _mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(&xmin[i]), vr), vx0), ix);
+		__m256 bx = _mm256_mul_ps(_mm256_sub_ps(_mm256_add_ps(_mm256_loadu_ps(&xmax[i]), vr), vx0), ix);
+		__m256 ay = _mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(_mm256_loadu_ps(&ymin[i]), vr), vy0), iy);
+		__m256 by = _mm256_mul_ps(_mm256_sub_ps(_mm256_add_ps(_mm256_loadu_ps(&ymax[i]), vr), vy0), iy);
+		__m256 enter = _mm256_max_ps(_mm256_min_ps(ax, bx), _mm256_min_ps(ay, by));
+		__m256 leave = _mm256_min_ps(_mm256_max_ps(ax, bx), _mm256_max_ps(ay, by));
+		enter = _mm256_max_ps(enter, zero);
+		leave = _mm256_min_ps(leave, one);
+		__m256 hit = _mm256_cmp_ps(enter, leave, _CMP_LE_OQ);
+
+		int mask = _mm256_movemask_ps(hit);
+		hits[(i - begin) >> 5] |= (unsigned int)mask << ((i - begin) & 31);
+		count += __builtin_popcount(mask);
+	}
+	return count;
+}
+
+#elif defined(__SSE2__)
+
+const char* boxKernelName() { return "sse"; }
+
+int BoxBatch::sweepCircle(float x0, float y0, float dx, float dy, float r, int begin, int end)
+{
+	const __m128 vx0 = _mm_set1_ps(x0);
+	const __m128 vy0 = _mm_set1_ps(y0);
+	const __m128 vr = _mm_set1_ps(r);
+	const __m128 ix = _mm_set1_ps(inverse(dx));
+	const __m128 iy = _mm_set1_ps(inverse(dy));
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	hits.assign((end - begin) / 32 + 1, 0);
+	int count = 0;
+	for(int i = begin; i < end; i += 4)
+	{
+		__m128 ax = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(&xmin[i]), vr), vx0), ix);
+		__m128 bx = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_loadu_ps(&xmax[i]), vr), vx0), ix);
+		__m128 ay = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(&ymin[i]), vr), vy0), iy);
+		__m128 by = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_loadu_ps(&ymax[i]), vr), vy0), iy);
+		__m128 enter = _mm_max_ps(_mm_min_ps(ax, bx), _mm_min_ps(ay, by));
+		__m128 leave = _mm_min_ps(_mm_max_ps(ax, bx), _mm_max_ps(ay, by));
+		enter = _mm_max_ps(enter, zero);
+		leave = _mm_min_ps(leave, one);
+		__m128 hit = _mm_cmple_ps(enter, leave);
+
+		int mask = _mm_movemask_ps(hit);
+		hits[(i - begin) >> 5] |= (unsigned int)mask << ((i - begin) & 31);
+		count += __builtin_popcount(mask);
+	}
+	return count;
+}
+
+#else
+
+const char* boxKernelName() { return "scalar"; }
+
+int BoxBatch::sweepCircle(float x0, float y0, float dx, float dy, float r, int begin, int end)
+{
+	return sweepCircleScalar(x0, y0, dx, dy, r, begin, end);
+}
+
+#endif
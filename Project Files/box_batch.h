@@ -0,0 +1,49 @@
+#ifndef BOX_BATCH_H
+#define BOX_BATCH_H
+
+#include <vector>
+
+#include "collision.h"
+
+/* Many boxes stored as one array per side, so one ball can be tested
+ * against 8 (AVX2) or 4 (SSE) of them per instruction. The obstacle grid
+ * keeps its buckets in one to weed out the boxes a ball can't reach before
+ * the exact sweeps in collision.h. */
+class BoxBatch {
+public:
+	std::vector<float> xmin;
+	std::vector<float> xmax;
+	std::vector<float> ymin;
+	std::vector<float> ymax;
+	std::vector<int> item;           // caller's id for each box
+	std::vector<unsigned int> hits;  // bit k set if the last test hit box begin + k
+
+	int size() const { return count; }
+	void clear();
+	/* Adds a box, returns its index */
+	int add(const Box& b, int id);
+	/* Fills up the last block of 8 with boxes nothing can hit (item -1),
+	 * so the next box added starts a new block */
+	void pad();
+
+	/* Circle of radius r moving in a straight line from (x0, y0) to
+	 * (x0 + dx, y0 + dy) against the boxes [begin, end), grown by r so with
+	 * square corners: every box the circle touches is hit, and some it only
+	 * passes near the corner of. begin and end are multiples of 8 (blocks
+	 * from pad()). Sets hits and returns how many boxes are hit. A circle
+	 * that doesn't move gets the boxes it overlaps. */
+	int sweepCircle(float x0, float y0, float dx, float dy, float r, int begin, int end);
+	/* Plain loop version of sweepCircle(); --bench-pairs compares the two */
+	int sweepCircleScalar(float x0, float y0, float dx, float dy, float r, int begin, int end);
+
+private:
+	int count;
+
+public:
+	BoxBatch() : count(0) {}
+};
+
+/* Name of the kernel sweepCircle() was compiled with: "avx2", "sse" or "scalar" */
+const char* boxKernelName();
+
+#endif
@@ -0,0 +1,412 @@
+#include <cmath>
+
+#include "collision.h"
+
+/* Contacts closer than this count as touching */
+static const float CONTACT_EPS = 1e-4f;
+
+template<typename T>
+void pathPosition(const BallPathT<T>& p, T time, T* x, T* y)
+{
+	*x = p.x0 + p.vx * (time - p.tx);
+	*y = p.y0 + p.uy * time - 0.5f * p.g * time * time;
+}
+
+template<typename T>
+void pathVelocity(const BallPathT<T>& p, T time, T* vx, T* vy)
+{
+	*vx = p.vx;
+	*vy = p.uy - p.g * time;
+}
+
+template<typename T>
+BoxT<T> pathBounds(const BallPathT<T>& p, T t0, T t1, T pad)
+{
+	T x0, y0, x1, y1;
+	pathPosition(p, t0, &x0, &y0);
+	pathPosition(p, t1, &x1, &y1);
+	BoxT<T> b;
+	b.xmin = x0 < x1 ? x0 : x1;
+	b.xmax = x0 < x1 ? x1 : x0;
+	b.ymin = y0 < y1 ? y0 : y1;
+	b.ymax = y0 < y1 ? y1 : y0;
+	// The top of the arc if it is inside the interval
+	if(p.g > 0 && p.uy > p.g * t0 && p.uy < p.g * t1)
+	{
+		T xa, ya;
+		pathPosition(p, p.uy / p.g, &xa, &ya);
+		if(ya > b.ymax)
+			b.ymax = ya;
+	}
+	pad += CONTACT_EPS;
+	b.xmin -= pad;
+	b.xmax += pad;
+	b.ymin -= pad;
+	b.ymax += pad;
+	return b;
+}
+
+template<typename T>
+T boxDistance(const BoxT<T>& b, T x, T y, T* nx, T* ny)
+{
+	T dx = 0, dy = 0;
+	if(x < b.xmin)
+		dx = x - b.xmin;
+	else if(x > b.xmax)
+		dx = x - b.xmax;
+	if(y < b.ymin)
+		dy = y - b.ymin;
+	else if(y > b.ymax)
+		dy = y - b.ymax;
+
+	if(dx != 0 || dy != 0)
+	{
+		T d = sqrt(dx*dx + dy*dy);
+		*nx = dx / d;
+		*ny = dy / d;
+		return d;
+	}
+
+	// Inside: push out through the nearest face
+	T left = x - b.xmin, right = b.xmax - x;
+	T bottom = y - b.ymin, top = b.ymax - y;
+	T d = left;
+	*nx = -1; *ny = 0;
+	if(right < d) { d = right; *nx = 1; *ny = 0; }
+	if(bottom < d) { d = bottom; *nx = 0; *ny = -1; }
+	if(top < d) { d = top; *nx = 0; *ny = 1; }
+	return -d;
+}
+
+/* Upper bound of the ball speed over [t0, t1]. vy is linear in time so its
+ * largest magnitude is at one of the ends. */
+template<typename T>
+static T maxSpeed(const BallPathT<T>& p, T t0, T t1)
+{
+	T vx, vy0, vy1;
+	pathVelocity(p, t0, &vx, &vy0);
+	pathVelocity(p, t1, &vx, &vy1);
+	T vy = fabs(vy0) > fabs(vy1) ? fabs(vy0) : fabs(vy1);
+	return sqrt(vx*vx + vy*vy);
+}
+
+template<typename T>
+T sweepCircleBox(const BallPathT<T>& p, T radius, T t0, T t1, const BoxT<T>& b, T* nx, T* ny)
+{
+	T vmax = maxSpeed(p, t0, t1);
+	T time = t0;
+	for(int iter = 0; iter < 64; iter++)
+	{
+		T x, y, vx, vy;
+		pathPosition(p, time, &x, &y);
+		T gap = boxDistance(b, x, y, nx, ny) - radius;
+
+		// Quick reject: can't close the gap in what's left of the interval
+		if(gap > vmax * (t1 - time))
+			return -1;
+
+		if(gap <= CONTACT_EPS)
+		{
+			pathVelocity(p, time, &vx, &vy);
+			if(vx * *nx + vy * *ny < 0)
+				return time;
+			// Touching but moving apart, step past the contact
+			gap = CONTACT_EPS;
+		}
+		if(vmax <= 0)
+			return -1;
+		time += gap / vmax;
+		if(time > t1)
+			return -1;
+	}
+	return -1;
+}
+
+/* Roots of a*t^2 + b*t + c = 0 in increasing order, returns how many */
+template<typename T>
+static int solveQuadratic(T a, T b, T c, T* r0, T* r1)
+{
+	if(fabs(a) < 1e-12f)
+	{
+		if(fabs(b) < 1e-12f)
+			return 0;
+		*r0 = -c / b;
+		return 1;
+	}
+	T disc = b*b - 4*a*c;
+	if(disc < 0)
+		return 0;
+	T sq = sqrt(disc);
+	// Numerically stable form, avoids cancelling b against sq
+	T q = b >= 0 ? -0.5f * (b + sq) : -0.5f * (b - sq);
+	T x0 = q / a;
+	T x1 = q != 0 ? c / q : x0;
+	*r0 = x0 < x1 ? x0 : x1;
+	*r1 = x0 < x1 ? x1 : x0;
+	return 2;
+}
+
+/* Earliest time in [t0, t1] where y(t) == level while y is moving in the
+ * direction dir (-1 down, +1 up), or -1 */
+template<typename T>
+static T crossLevel(const BallPathT<T>& p, T level, int dir, T t0, T t1)
+{
+	T r[2];
+	int n = solveQuadratic(-0.5f * p.g, p.uy, p.y0 - level, &r[0], &r[1]);
+	for(int i = 0; i < n; i++)
+	{
+		if(r[i] < t0 || r[i] > t1)
+			continue;
+		T vx, vy;
+		pathVelocity(p, r[i], &vx, &vy);
+		if(vy * dir > 0)
+			return r[i];
+	}
+	return -1;
+}
+
+/* Time x(t) == level, or -1 if it never is in [t0, t1] */
+template<typename T>
+static T crossX(const BallPathT<T>& p, T level, T t0, T t1)
+{
+	if(p.vx == 0)
+		return -1;
+	T time = p.tx + (level - p.x0) / p.vx;
+	if(time < t0 || time > t1)
+		return -1;
+	return time;
+}
+
+template<typename T>
+static T cornerGap(const BallPathT<T>& p, T time, T cx, T cy, T radius)
+{
+	T x, y;
+	pathPosition(p, time, &x, &y);
+	return (x - cx)*(x - cx) + (y - cy)*(y - cy) - radius*radius;
+}
+
+/* Time derivative of cornerGap() */
+template<typename T>
+static T cornerGapRate(const BallPathT<T>& p, T time, T cx, T cy)
+{
+	T x, y, vx, vy;
+	pathPosition(p, time, &x, &y);
+	pathVelocity(p, time, &vx, &vy);
+	return 2 * ((x - cx) * vx + (y - cy) * vy);
+}
+
+/* Earliest entry of the path into the circle around a corner */
+template<typename T>
+static T cornerImpact(const BallPathT<T>& p, T radius, T t0, T t1, T cx, T cy)
+{
+	T lo = t0, hi = t1;
+	if(p.vx != 0)
+	{
+		T ta = p.tx + (cx - radius - p.x0) / p.vx;
+		T tb = p.tx + (cx + radius - p.x0) / p.vx;
+		if(ta > tb) { T tmp = ta; ta = tb; tb = tmp; }
+		if(ta > lo) lo = ta;
+		if(tb < hi) hi = tb;
+	}
+	else
+	{
+		T x, y;
+		pathPosition(p, t0, &x, &y);
+		if(fabs(x - cx) > radius)
+			return -1;
+	}
+	if(lo > hi)
+		return -1;
+
+	// The window is at most one ball diameter wide along x, a few samples
+	// are enough to bracket the entry
+	const int samples = 8;
+	T prev_t = lo;
+	if(cornerGap(p, lo, cx, cy, radius) <= 0)
+		return -1; // already inside at the start, the faces handle this
+	for(int i = 1; i <= samples; i++)
+	{
+		T time = lo + (hi - lo) * i / samples;
+		T f = cornerGap(p, time, cx, cy, radius);
+		if(f > 0 && cornerGapRate(p, prev_t, cx, cy) < 0 && cornerGapRate(p, time, cx, cy) > 0)
+		{
+			// The gap has a minimum between the samples, a grazing path
+			// can dip inside there and come back out
+			T a = prev_t, b = time;
+			for(int k = 0; k < 32; k++)
+			{
+				T m = 0.5f * (a + b);
+				if(cornerGapRate(p, m, cx, cy) < 0)
+					a = m;
+				else
+					b = m;
+			}
+			if(cornerGap(p, a, cx, cy, radius) <= 0)
+			{
+				time = a;
+				f = 0;
+			}
+		}
+		if(f <= 0)
+		{
+			T a = prev_t, b = time;
+			for(int k = 0; k < 32; k++)
+			{
+				T m = 0.5f * (a + b);
+				if(cornerGap(p, m, cx, cy, radius) > 0)
+					a = m;
+				else
+					b = m;
+			}
+			return a;
+		}
+		prev_t = time;
+	}
+	return -1;
+}
+
+template<typename T>
+T impactCircleBox(const BallPathT<T>& p, T radius, T t0, T t1, const BoxT<T>& b, T* nx, T* ny)
+{
+	T best = -1;
+	T x, y, h;
+
+	// Top and bottom faces
+	h = crossLevel(p, b.ymax + radius, -1, t0, t1);
+	if(h >= 0)
+	{
+		pathPosition(p, h, &x, &y);
+		if(x >= b.xmin && x <= b.xmax && (best < 0 || h < best)) { best = h; *nx = 0; *ny = 1; }
+	}
+	h = crossLevel(p, b.ymin - radius, 1, t0, t1);
+	if(h >= 0)
+	{
+		pathPosition(p, h, &x, &y);
+		if(x >= b.xmin && x <= b.xmax && (best < 0 || h < best)) { best = h; *nx = 0; *ny = -1; }
+	}
+
+	// Left and right faces
+	if(p.vx > 0)
+	{
+		h = crossX(p, b.xmin - radius, t0, t1);
+		if(h >= 0)
+		{
+			pathPosition(p, h, &x, &y);
+			if(y >= b.ymin && y <= b.ymax && (best < 0 || h < best)) { best = h; *nx = -1; *ny = 0; }
+		}
+	}
+	else if(p.vx < 0)
+	{
+		h = crossX(p, b.xmax + radius, t0, t1);
+		if(h >= 0)
+		{
+			pathPosition(p, h, &x, &y);
+			if(y >= b.ymin && y <= b.ymax && (best < 0 || h < best)) { best = h; *nx = 1; *ny = 0; }
+		}
+	}
+
+	// Rounded corners
+	const T cx[4] = { b.xmin, b.xmax, b.xmin, b.xmax };
+	const T cy[4] = { b.ymin, b.ymin, b.ymax, b.ymax };
+	for(int i = 0; i < 4; i++)
+	{
+		T hi = best >= 0 ? best : t1;
+		h = cornerImpact(p, radius, t0, hi, cx[i], cy[i]);
+		if(h < 0)
+			continue;
+		pathPosition(p, h, &x, &y);
+		T dx = x - cx[i], dy = y - cy[i];
+		T d = sqrt(dx*dx + dy*dy);
+		T vx, vy;
+		pathVelocity(p, h, &vx, &vy);
+		if(d > 0 && vx * dx + vy * dy < 0)
+		{
+			best = h;
+			*nx = dx / d;
+			*ny = dy / d;
+		}
+	}
+	return best;
+}
+
+template<typename T>
+T firstTimeInBox(const BallPathT<T>& p, T t0, T t1, const BoxT<T>& b)
+{
+	T lo = t0, hi = t1;
+	if(p.vx != 0)
+	{
+		T ta = p.tx + (b.xmin - p.x0) / p.vx;
+		T tb = p.tx + (b.xmax - p.x0) / p.vx;
+		if(ta > tb) { T tmp = ta; ta = tb; tb = tmp; }
+		if(ta > lo) lo = ta;
+		if(tb < hi) hi = tb;
+	}
+	else
+	{
+		T x, y;
+		pathPosition(p, t0, &x, &y);
+		if(x < b.xmin || x > b.xmax)
+			return -1;
+	}
+	if(lo > hi)
+		return -1;
+
+	T x, y;
+	pathPosition(p, lo, &x, &y);
+	if(y >= b.ymin && y <= b.ymax)
+		return lo;
+	T h = y < b.ymin ? crossLevel(p, b.ymin, 1, lo, hi) : crossLevel(p, b.ymax, -1, lo, hi);
+	return h;
+}
+
+template<typename T>
+T applyContactImpulse(T* vx, T* vy, T nx, T ny, T e, T mu)
+{
+	T vn = *vx * nx + *vy * ny;
+	if(vn >= 0)
+		return 0;
+	T tx = -ny, ty = nx;
+	T vt = *vx * tx + *vy * ty;
+
+	T jn = -(1 + e) * vn;
+	T jt = -vt;
+	if(jt > mu * jn)
+		jt = mu * jn;
+	else if(jt < -mu * jn)
+		jt = -mu * jn;
+
+	*vx += jn * nx + jt * tx;
+	*vy += jn * ny + jt * ty;
+	return -vn;
+}
+
+template<typename T>
+T applySlidingFriction(T* vx, T* vy, T nx, T ny, T dv)
+{
+	T tx = -ny, ty = nx;
+	T vt = *vx * tx + *vy * ty;
+	T left = fabs(vt) > dv ? fabs(vt) - dv : 0;
+	T change = (vt > 0 ? left : -left) - vt;
+	*vx += change * tx;
+	*vy += change * ty;
+	return left;
+}
+
+template void pathPosition<float>(const BallPathT<float>&, float, float*, float*);
+template void pathPosition<double>(const BallPathT<double>&, double, double*, double*);
+template void pathVelocity<float>(const BallPathT<float>&, float, float*, float*);
+template void pathVelocity<double>(const BallPathT<double>&, double, double*, double*);
+template BoxT<float> pathBounds<float>(const BallPathT<float>&, float, float, float);
+template BoxT<double> pathBounds<double>(const BallPathT<double>&, double, double, double);
+template float boxDistance<float>(const BoxT<float>&, float, float, float*, float*);
+template double boxDistance<double>(const BoxT<double>&, double, double, double*, double*);
+template float sweepCircleBox<float>(const BallPathT<float>&, float, float, float, const BoxT<float>&, float*, float*);
+template double sweepCircleBox<double>(const BallPathT<double>&, double, double, double, const BoxT<double>&, double*, double*);
+template float impactCircleBox<float>(const BallPathT<float>&, float, float, float, const BoxT<float>&, float*, float*);
+template double impactCircleBox<double>(const BallPathT<double>&, double, double, double, const BoxT<double>&, double*, double*);
+template float firstTimeInBox<float>(const BallPathT<float>&, float, float, const BoxT<float>&);
+template double firstTimeInBox<double>(const BallPathT<double>&, double, double, const BoxT<double>&);
+template float applyContactImpulse<float>(float*, float*, float, float, float, float);
+template double applyContactImpulse<double>(double*, double*, double, double, double, double);
+template float applySlidingFriction<float>(float*, float*, float, float, float);
+template double applySlidingFriction<double>(double*, double*, double, double, double);
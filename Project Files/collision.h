@@ -0,0 +1,79 @@
+#ifndef COLLISION_H
+#define COLLISION_H
+
+#include "real.h"
+
+/* Geometric queries used by the ball physics. No game state in here.
+ * Everything is a template over the scalar type, instantiated for float
+ * and double in collision.cpp; Box and BallPath use the build's real. */
+
+template<typename T>
+struct BoxT {
+	T xmin;
+	T xmax;
+	T ymin;
+	T ymax;
+};
+typedef BoxT<real> Box;
+
+/* Ball path between two contacts, the closed form of updateBallPosition():
+ *   x(t) = x0 + vx * (t - tx)
+ *   y(t) = y0 + uy * t - g * t * t / 2 */
+template<typename T>
+struct BallPathT {
+	T x0;
+	T y0;
+	T vx;
+	T tx;
+	T uy;
+	T g;
+};
+typedef BallPathT<real> BallPath;
+
+template<typename T>
+void pathPosition(const BallPathT<T>& p, T time, T* x, T* y);
+template<typename T>
+void pathVelocity(const BallPathT<T>& p, T time, T* vx, T* vy);
+
+/* Box around the path over [t0, t1], grown by pad on every side */
+template<typename T>
+BoxT<T> pathBounds(const BallPathT<T>& p, T t0, T t1, T pad);
+
+/* Signed distance from (x, y) to the box (negative inside) and the outward
+ * normal of the closest feature */
+template<typename T>
+T boxDistance(const BoxT<T>& b, T x, T y, T* nx, T* ny);
+
+/* Earliest time in [t0, t1] at which a circle of the given radius moving
+ * along p touches b while moving towards it, or -1 if it doesn't.
+ * (*nx, *ny) is the box normal at the contact. Uses conservative
+ * advancement, so corners and large steps are handled exactly. */
+template<typename T>
+T sweepCircleBox(const BallPathT<T>& p, T radius, T t0, T t1, const BoxT<T>& b, T* nx, T* ny);
+
+/* Same contact as sweepCircleBox() but solved in closed form: roots of the
+ * path against the four faces pushed out by the radius (linear in x,
+ * quadratic in y), plus the four rounded corners, which are bracketed by
+ * the time window where x is within radius of the corner and bisected.
+ * Cost does not depend on t1 - t0. */
+template<typename T>
+T impactCircleBox(const BallPathT<T>& p, T radius, T t0, T t1, const BoxT<T>& b, T* nx, T* ny);
+
+/* Earliest time in [t0, t1] the path point is inside b, or -1 */
+template<typename T>
+T firstTimeInBox(const BallPathT<T>& p, T t0, T t1, const BoxT<T>& b);
+
+/* Impulse of a ball hitting a static surface with outward normal (nx, ny):
+ * restitution e on the normal part of the velocity and Coulomb friction
+ * (coefficient mu, bounded by the normal impulse) on the tangential part.
+ * Returns the speed the ball had into the surface, 0 if it was separating. */
+template<typename T>
+T applyContactImpulse(T* vx, T* vy, T nx, T ny, T e, T mu);
+
+/* Slows the tangential part of the velocity of a ball sliding on a surface
+ * by dv (friction deceleration times the time spent sliding). Returns the
+ * tangential speed left. */
+template<typename T>
+T applySlidingFriction(T* vx, T* vy, T nx, T ny, T dv);
+
+#endif
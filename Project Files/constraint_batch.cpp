@@ -0,0 +1,188 @@
+#if !defined(SIM_DOUBLE) && (defined(__AVX2__) || defined(__SSE2__))
+#include <immintrin.h>
+#endif
+
+#include "constraint_batch.h"
+#include "rigid_world.h"
+
+/* Groups are padded to a multiple of this so kernels never need a tail loop */
+static const int LANES = CONSTRAINT_LANES;
+
+/* Reals per SolverBody, to find a field of body i at i * STRIDE */
+static const int STRIDE = sizeof(SolverBody) / sizeof(real);
+
+void ConstraintBatch::resize(int n)
+{
+	a.resize(n);
+	b.resize(n);
+	nx.resize(n);
+	ny.resize(n);
+	rax.resize(n);
+	ray.resize(n);
+	rbx.resize(n);
+	rby.resize(n);
+	mass.resize(n);
+	bias.resize(n);
+	lo.resize(n);
+	hi.resize(n);
+	impulse.resize(n);
+}
+
+void ConstraintBatch::clearRow(int i, int fixed)
+{
+	a[i] = b[i] = fixed;
+	nx[i] = 1;
+	ny[i] = rax[i] = ray[i] = rbx[i] = rby[i] = 0;
+	mass[i] = bias[i] = lo[i] = hi[i] = impulse[i] = 0;
+}
+
+/* The same as the contact normals of rigid_world: the impulse that brings
+ * the relative velocity along n to bias, clamped on the total. The vector
+ * kernels do the same operations in the same order. */
+void ConstraintBatch::solveScalar(SolverBody* bodies, int begin, int end)
+{
+	for(int i = begin; i < end; i++)
+	{
+		SolverBody& A = bodies[a[i]];
+		SolverBody& B = bodies[b[i]];
+		real dvx = B.vx - B.w * rby[i] - A.vx + A.w * ray[i];
+		real dvy = B.vy + B.w * rbx[i] - A.vy - A.w * rax[i];
+		real vn = dvx * nx[i] + dvy * ny[i];
+		real p = impulse[i] + mass[i] * (bias[i] - vn);
+		p = p < lo[i] ? lo[i] : (p > hi[i] ? hi[i] : p);
+		real dp = p - impulse[i];
+		impulse[i] = p;
+		real px = dp * nx[i], py = dp * ny[i];
+		A.vx -= A.inv_mass * px;
+		A.vy -= A.inv_mass * py;
+		A.w -= A.inv_inertia * (rax[i] * py - ray[i] * px);
+		B.vx += B.inv_mass * px;
+		B.vy += B.inv_mass * py;
+		B.w += B.inv_inertia * (rbx[i] * py - rby[i] * px);
+	}
+}
+
+#if !defined(SIM_DOUBLE) && defined(__AVX2__)
+
+const char* constraintKernelName() { return "avx2"; }
+
+void ConstraintBatch::solve(SolverBody* bodies, int begin, int end)
+{
+	const float* base = &bodies[0].vx;
+	const __m256i stride = _mm256_set1_epi32(STRIDE);
+	for(int i = begin; i < end; i += LANES)
+	{
+		// No two rows of a group move the same body, so the lanes can't
+		// overwrite each other's velocities
+		__m256i ia = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)&a[i]), stride);
+		__m256i ib = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)&b[i]), stride);
+		__m256 avx = _mm256_i32gather_ps(base + 0, ia, 4);
+		__m256 avy = _mm256_i32gather_ps(base + 1, ia, 4);
+		__m256 aw = _mm256_i32gather_ps(base + 2, ia, 4);
+		__m256 am = _mm256_i32gather_ps(base + 3, ia, 4);
+		__m256 ai = _mm256_i32gather_ps(base + 4, ia, 4);
+		__m256 bvx = _mm256_i32gather_ps(base + 0, ib, 4);
+		__m256 bvy = _mm256_i32gather_ps(base + 1, ib, 4);
+		__m256 bw = _mm256_i32gather_ps(base + 2, ib, 4);
+		__m256 bm = _mm256_i32gather_ps(base + 3, ib, 4);
+		__m256 bi = _mm256_i32gather_ps(base + 4, ib, 4);
+
+		__m256 vnx = _mm256_loadu_ps(&nx[i]), vny = _mm256_loadu_ps(&ny[i]);
+		__m256 vrax = _mm256_loadu_ps(&rax[i]), vray = _mm256_loadu_ps(&ray[i]);
+		__m256 vrbx = _mm256_loadu_ps(&rbx[i]), vrby = _mm256_loadu_ps(&rby[i]);
+		__m256 dvx = _mm256_add_ps(_mm256_sub_ps(_mm256_sub_ps(bvx, _mm256_mul_ps(bw, vrby)), avx), _mm256_mul_ps(aw, vray));
+		__m256 dvy = _mm256_sub_ps(_mm256_sub_ps(_mm256_add_ps(bvy, _mm256_mul_ps(bw, vrbx)), avy), _mm256_mul_ps(aw, vrax));
+		__m256 vn = _mm256_add_ps(_mm256_mul_ps(dvx, vnx), _mm256_mul_ps(dvy, vny));
+		__m256 old = _mm256_loadu_ps(&impulse[i]);
+		__m256 p = _mm256_add_ps(old, _mm256_mul_ps(_mm256_loadu_ps(&mass[i]), _mm256_sub_ps(_mm256_loadu_ps(&bias[i]), vn)));
+		p = _mm256_min_ps(_mm256_max_ps(p, _mm256_loadu_ps(&lo[i])), _mm256_loadu_ps(&hi[i]));
+		__m256 dp = _mm256_sub_ps(p, old);
+		_mm256_storeu_ps(&impulse[i], p);
+		__m256 px = _mm256_mul_ps(dp, vnx), py = _mm256_mul_ps(dp, vny);
+
+		float out[6][8];
+		_mm256_storeu_ps(out[0], _mm256_sub_ps(avx, _mm256_mul_ps(am, px)));
+		_mm256_storeu_ps(out[1], _mm256_sub_ps(avy, _mm256_mul_ps(am, py)));
+		_mm256_storeu_ps(out[2], _mm256_sub_ps(aw, _mm256_mul_ps(ai, _mm256_sub_ps(_mm256_mul_ps(vrax, py), _mm256_mul_ps(vray, px)))));
+		_mm256_storeu_ps(out[3], _mm256_add_ps(bvx, _mm256_mul_ps(bm, px)));
+		_mm256_storeu_ps(out[4], _mm256_add_ps(bvy, _mm256_mul_ps(bm, py)));
+		_mm256_storeu_ps(out[5], _mm256_add_ps(bw, _mm256_mul_ps(bi, _mm256_sub_ps(_mm256_mul_ps(vrbx, py), _mm256_mul_ps(vrby, px)))));
+		for(int k = 0; k < LANES; k++)
+		{
+			SolverBody& A = bodies[a[i + k]];
+			A.vx = out[0][k];
+			A.vy = out[1][k];
+			A.w = out[2][k];
+			SolverBody& B = bodies[b[i + k]];
+			B.vx = out[3][k];
+			B.vy = out[4][k];
+			B.w = out[5][k];
+		}
+	}
+}
+
+#elif !defined(SIM_DOUBLE) && defined(__SSE2__)
+
+const char* constraintKernelName() { return "sse"; }
+
+static inline __m128 gather4(const SolverBody* bodies, const int* rows, int field)
+{
+	const float* f = &bodies[0].vx + field;
+	return _mm_setr_ps(f[rows[0] * STRIDE], f[rows[1] * STRIDE], f[rows[2] * STRIDE], f[rows[3] * STRIDE]);
+}
+
+void ConstraintBatch::solve(SolverBody* bodies, int begin, int end)
+{
+	for(int i = begin; i < end; i += 4)
+	{
+		// No two rows of a group move the same body, so the lanes can't
+		// overwrite each other's velocities
+		__m128 avx = gather4(bodies, &a[i], 0), avy = gather4(bodies, &a[i], 1), aw = gather4(bodies, &a[i], 2);
+		__m128 am = gather4(bodies, &a[i], 3), ai = gather4(bodies, &a[i], 4);
+		__m128 bvx = gather4(bodies, &b[i], 0), bvy = gather4(bodies, &b[i], 1), bw = gather4(bodies, &b[i], 2);
+		__m128 bm = gather4(bodies, &b[i], 3), bi = gather4(bodies, &b[i], 4);
+
+		__m128 vnx = _mm_loadu_ps(&nx[i]), vny = _mm_loadu_ps(&ny[i]);
+		__m128 vrax = _mm_loadu_ps(&rax[i]), vray = _mm_loadu_ps(&ray[i]);
+		__m128 vrbx = _mm_loadu_ps(&rbx[i]), vrby = _mm_loadu_ps(&rby[i]);
+		__m128 dvx = _mm_add_ps(_mm_sub_ps(_mm_sub_ps(bvx, _mm_mul_ps(bw, vrby)), avx), _mm_mul_ps(aw, vray));
+		__m128 dvy = _mm_sub_ps(_mm_sub_ps(_mm_add_ps(bvy, _mm_mul_ps(bw, vrbx)), avy), _mm_mul_ps(aw, vrax));
+		__m128 vn = _mm_add_ps(_mm_mul_ps(dvx, vnx), _mm_mul_ps(dvy, vny));
+		__m128 old = _mm_loadu_ps(&impulse[i]);
+		__m128 p = _mm_add_ps(old, _mm_mul_ps(_mm_loadu_ps(&mass[i]), _mm_sub_ps(_mm_loadu_ps(&bias[i]), vn)));
+		p = _mm_min_ps(_mm_max_ps(p, _mm_loadu_ps(&lo[i])), _mm_loadu_ps(&hi[i]));
+		__m128 dp = _mm_sub_ps(p, old);
+		_mm_storeu_ps(&impulse[i], p);
+		__m128 px = _mm_mul_ps(dp, vnx), py = _mm_mul_ps(dp, vny);
+
+		float out[6][4];
+		_mm_storeu_ps(out[0], _mm_sub_ps(avx, _mm_mul_ps(am, px)));
+		_mm_storeu_ps(out[1], _mm_sub_ps(avy, _mm_mul_ps(am, py)));
+		_mm_storeu_ps(out[2], _mm_sub_ps(aw, _mm_mul_ps(ai, _mm_sub_ps(_mm_mul_ps(vrax, py), _mm_mul_ps(vray, px)))));
+		_mm_storeu_ps(out[3], _mm_add_ps(bvx, _mm_mul_ps(bm, px)));
+		_mm_storeu_ps(out[4], _mm_add_ps(bvy, _mm_mul_ps(bm, py)));
+		_mm_storeu_ps(out[5], _mm_add_ps(bw, _mm_mul_ps(bi, _mm_sub_ps(_mm_mul_ps(vrbx, py), _mm_mul_ps(vrby, px)))));
+		for(int k = 0; k < 4; k++)
+		{
+			SolverBody& A = bodies[a[i + k]];
+			A.vx = out[0][k];
+			A.vy = out[1][k];
+			A.w = out[2][k];
+			SolverBody& B = bodies[b[i + k]];
+			B.vx = out[3][k];
+			B.vy = out[4][k];
+			B.w = out[5][k];
+		}
+	}
+}
+
+#else
+
+const char* constraintKernelName() { return "scalar"; }
+
+void ConstraintBatch::solve(SolverBody* bodies, int begin, int end)
+{
+	solveScalar(bodies, begin, end);
+}
+
+#endif
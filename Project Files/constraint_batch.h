@@ -0,0 +1,47 @@
+#ifndef CONSTRAINT_BATCH_H
+#define CONSTRAINT_BATCH_H
+
+#include <vector>
+
+#include "real.h"
+
+struct SolverBody;
+
+/* Rows per group; arrays are padded to a multiple of it */
+#define CONSTRAINT_LANES 8
+
+/* Rows of the joint constraints of rigid_world, stored as one array per
+ * field in groups of 8 that share no moving body, so a whole group is
+ * solved at once: 8 rows per instruction with AVX2, 4 with SSE (float
+ * builds only). A row keeps the velocity of b relative to a along (nx, ny)
+ * at bias, with its accumulated impulse kept within [lo, hi]: a rod is
+ * unbounded, a rope only pulls. Padding rows have mass 0 and do nothing. */
+class ConstraintBatch {
+public:
+	std::vector<int> a, b;          // rows of the bodies in the solver
+	std::vector<real> nx, ny;
+	std::vector<real> rax, ray;     // from the centre of a to its anchor
+	std::vector<real> rbx, rby;
+	std::vector<real> mass;         // 1 / effective mass along n, 0 for padding
+	std::vector<real> bias;         // relative velocity the row aims for
+	std::vector<real> lo, hi;       // bounds of the accumulated impulse
+	std::vector<real> impulse;      // accumulated impulse
+
+	int size() const { return (int)mass.size(); }
+	/* n rows, all padding */
+	void resize(int n);
+	/* Makes row i padding on the solver row fixed */
+	void clearRow(int i, int fixed);
+
+	/* One Gauss-Seidel sweep over the rows [begin, end) against the
+	 * velocities in bodies, a group of 8 at a time. begin and end are
+	 * multiples of 8. */
+	void solve(SolverBody* bodies, int begin, int end);
+	/* Plain loop version of solve(); --bench-joints compares the two */
+	void solveScalar(SolverBody* bodies, int begin, int end);
+};
+
+/* Name of the kernel solve() was compiled with: "avx2", "sse" or "scalar" */
+const char* constraintKernelName();
+
+#endif
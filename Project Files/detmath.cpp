@@ -0,0 +1,51 @@
+#include <cmath>
+
+#include "detmath.h"
+
+static const double HALF_PI = 1.57079632679489661923;
+
+/* Taylor series, within about 1e-11 on [-pi/4, pi/4]: a few ulp of a
+ * float, not of a double */
+static void sinCosKernel(double r, double* s, double* c)
+{
+	double r2 = r * r;
+	*s = r * (1 + r2 * (-1/6.0 + r2 * (1/120.0 + r2 * (-1/5040.0 + r2 * (1/362880.0 + r2 * (-1/39916800.0))))));
+	*c = 1 + r2 * (-1/2.0 + r2 * (1/24.0 + r2 * (-1/720.0 + r2 * (1/40320.0 + r2 * (-1/3628800.0 + r2 * (1/479001600.0))))));
+}
+
+/* Rotates (sin r, cos r) by quarter turns to (sin, cos) of r + q * pi/2 */
+static void quadrant(long q, double s, double c, double* out_s, double* out_c)
+{
+	switch(q & 3)
+	{
+		case 0: *out_s = s;  *out_c = c;  break;
+		case 1: *out_s = c;  *out_c = -s; break;
+		case 2: *out_s = -s; *out_c = -c; break;
+		default: *out_s = -c; *out_c = s; break;
+	}
+}
+
+void detSinCos(double x, double* s, double* c)
+{
+	double q = floor(x / HALF_PI + 0.5);
+	double ks, kc;
+	sinCosKernel(x - q * HALF_PI, &ks, &kc);
+	quadrant((long)q, ks, kc, s, c);
+}
+
+void detSinCosDeg(double deg, double* s, double* c)
+{
+	double q = floor(deg / 90.0 + 0.5);
+	double r = deg - q * 90.0; // exact for any float angle
+	double ks, kc;
+	sinCosKernel(r * (HALF_PI / 90.0), &ks, &kc);
+	quadrant((long)q, ks, kc, s, c);
+}
+
+void detSinCosDeg(float deg, float* s, float* c)
+{
+	double ds, dc;
+	detSinCosDeg((double)deg, &ds, &dc);
+	*s = (float)ds;
+	*c = (float)dc;
+}
@@ -0,0 +1,18 @@
+#ifndef DETMATH_H
+#define DETMATH_H
+
+/* Sine and cosine built only from +, -, * and / so they give the same bits
+ * on every machine and libm, as long as the compiler does not fuse or
+ * reorder the operations (the Makefile builds with -ffp-contract=off).
+ * Used by the deterministic mode instead of sin()/cos(). */
+
+/* sin and cos of x radians. Accurate to a few ulp of a float for
+ * |x| up to a few thousand. */
+void detSinCos(double x, double* s, double* c);
+
+/* Same for an angle in degrees, reduced in degrees first so multiples of
+ * 90 give exact 0 and 1 */
+void detSinCosDeg(double deg, double* s, double* c);
+void detSinCosDeg(float deg, float* s, float* c);
+
+#endif
@@ -0,0 +1,79 @@
+#include "entities.h"
+
+using namespace std;
+
+EntityPool entities;
+
+void EntityPool::reserve(int capacity)
+{
+	items.assign(capacity, Entity());
+	generation.assign(capacity, 0);
+	in_use.assign(capacity, 0);
+	next_free.resize(capacity);
+	clear();
+}
+
+/* The free list starts in slot order, so a fresh pool fills from slot 0
+ * and two runs of the same shot use the same slots */
+void EntityPool::clear()
+{
+	int n = capacity();
+	for(int i = 0; i < n; i++)
+	{
+		if(in_use[i])
+			generation[i]++;
+		in_use[i] = 0;
+		next_free[i] = i + 1 < n ? i + 1 : -1;
+	}
+	first_free = n > 0 ? 0 : -1;
+	count = 0;
+}
+
+EntityHandle EntityPool::create(int kind)
+{
+	EntityHandle h = { -1, 0 };
+	if(first_free < 0)
+		return h;
+	int i = first_free;
+	first_free = next_free[i];
+	items[i] = Entity();
+	items[i].kind = kind;
+	items[i].body = -1;
+	in_use[i] = 1;
+	count++;
+	return handle(i);
+}
+
+void EntityPool::destroy(EntityHandle h)
+{
+	if(!get(h))
+		return;
+	generation[h.index]++;
+	in_use[h.index] = 0;
+	next_free[h.index] = first_free;
+	first_free = h.index;
+	count--;
+}
+
+Entity* EntityPool::get(EntityHandle h)
+{
+	if(h.index < 0 || h.index >= capacity() || !in_use[h.index] || generation[h.index] != h.generation)
+		return 0;
+	return &items[h.index];
+}
+
+EntityHandle addEffect(real x, real y, real radius, real life, const float color[3])
+{
+	EntityHandle h = entities.create(ENTITY_EFFECT);
+	Entity* fx = entities.get(h);
+	if(!fx)
+		return h;
+	fx->x = x;
+	fx->y = y;
+	fx->radius = radius;
+	fx->life = life;
+	fx->color[0] = color[0];
+	fx->color[1] = color[1];
+	fx->color[2] = color[2];
+	return h;
+}
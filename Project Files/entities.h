@@ -0,0 +1,84 @@
+#ifndef ENTITIES_H
+#define ENTITIES_H
+
+#include <vector>
+
+#include "real.h"
+
+/* Short lived things a shot makes besides the ball: the birds a split
+ * bird turns into, the pieces of shattered blocks and the puffs drawn
+ * where something broke. They live in a pool of slots made once with
+ * reserve(); a free list hands out the slots of dead entities again, so
+ * an ability spawning hundreds of them per shot never allocates. Whoever
+ * keeps an entity keeps an EntityHandle, which goes stale when the entity
+ * dies instead of pointing at whatever took its slot. Every piece of
+ * debris is an entity too, so the pool has to hold the debris pool of
+ * rigid_world besides the birds and puffs. What they do each
+ * step is up to simulation.cpp. No OpenGL in here. */
+
+/* Entity::kind */
+#define ENTITY_PROJECTILE 0   // a bird of its own, flying like the ball
+#define ENTITY_DEBRIS 1       // a piece of debris, body of rigid_world
+#define ENTITY_EFFECT 2       // a puff that grows and fades, drawn only
+
+struct Entity {
+	int kind;
+	real x, y;
+	real vx, vy;
+	real radius;
+	real mass;       // ENTITY_PROJECTILE: against the blocks, like ball_mass
+	real age;        // seconds since it was made
+	real life;       // seconds it lives, 0 for as long as it is needed
+	int body;        // ENTITY_DEBRIS: its body in rigid_world
+	real still;      // ENTITY_PROJECTILE: seconds it has been slow and touching something
+	int lane;        // ENTITY_PROJECTILE: its ball in the flock of simulation.cpp
+	float color[3];
+};
+
+/* Slot and the generation of the slot the entity was made in. index -1
+ * is no entity. */
+struct EntityHandle {
+	int index;
+	unsigned int generation;
+};
+
+class EntityPool {
+public:
+	std::vector<Entity> items;              // by slot, dead ones included
+	std::vector<unsigned int> generation;   // bumped every time a slot is freed
+
+	/* Makes the slots; the only call that allocates. Kills every entity. */
+	void reserve(int capacity);
+	/* Kills every entity, keeping the slots */
+	void clear();
+	/* New entity of kind, zeroed, in the most recently freed slot. Handle
+	 * with index -1 if every slot is taken. */
+	EntityHandle create(int kind);
+	/* Kills the entity of h, if it is still alive */
+	void destroy(EntityHandle h);
+	/* Entity of h, 0 once it died */
+	Entity* get(EntityHandle h);
+	/* Handle of the entity in slot i */
+	EntityHandle handle(int i) const { EntityHandle h = { i, generation[i] }; return h; }
+	int alive(int i) const { return in_use[i]; }
+
+	int capacity() const { return (int)items.size(); }
+	int live() const { return count; }
+
+private:
+	std::vector<char> in_use;
+	std::vector<int> next_free;   // next slot of the free list, -1 at its end
+	int first_free;
+	int count;
+
+public:
+	EntityPool() : first_free(-1), count(0) {}
+};
+
+extern EntityPool entities;
+
+/* Puff of radius at (x, y) in color that grows and fades over life
+ * seconds. Handle with index -1 if the pool is full. */
+EntityHandle addEffect(real x, real y, real radius, real life, const float color[3]);
+
+#endif
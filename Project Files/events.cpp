@@ -0,0 +1,52 @@
+#include "events.h"
+
+/* Enough for several seconds of a ball rattling between boxes */
+EventRing sim_events(1024);
+
+EventRing::EventRing(int capacity) : written(0)
+{
+	int n = 1;
+	while(n < capacity)
+		n *= 2;
+	events.resize(n);
+	mask = n - 1;
+}
+
+int EventRing::read(unsigned int* cursor, SimEvent* ev, unsigned int* lost) const
+{
+	// Unsigned differences stay right when the counters wrap
+	unsigned int behind = written - *cursor;
+	if(behind > mask + 1)
+	{
+		if(lost)
+			*lost += behind - (mask + 1);
+		*cursor = written - (mask + 1);
+	}
+	if(*cursor == written)
+		return 0;
+	*ev = events[*cursor & mask];
+	(*cursor)++;
+	return 1;
+}
+
+void printEvent(FILE* out, const SimEvent& ev)
+{
+	if(ev.type == EVENT_CONTACT)
+		fprintf(out, "%.4f ball hit %s %d at (%.3f, %.3f), %.3f towards it\n", ev.t,
+		        ev.ny * ev.ny >= ev.nx * ev.nx ? "the top or bottom of box" : "the side of box",
+		        ev.body, ev.x, ev.y, ev.speed);
+	else if(ev.type == EVENT_REST)
+		fprintf(out, "%.4f ball at rest at (%.3f, %.3f)\n", ev.t, ev.x, ev.y);
+	else if(ev.type == EVENT_OUT)
+		fprintf(out, "%.4f ball left the play area at (%.3f, %.3f)\n", ev.t, ev.x, ev.y);
+	else if(ev.type == EVENT_BODY)
+		fprintf(out, "%.4f ball hit block %d at (%.3f, %.3f), %.3f towards it\n", ev.t, ev.body, ev.x, ev.y, ev.speed);
+	else if(ev.type == EVENT_BREAK)
+		fprintf(out, "%.4f block %d shattered at (%.3f, %.3f)\n", ev.t, ev.body, ev.x, ev.y);
+	else if(ev.type == EVENT_SPLIT)
+		fprintf(out, "%.4f ball split into %d birds at (%.3f, %.3f)\n", ev.t, ev.body, ev.x, ev.y);
+	else if(ev.type == EVENT_BLAST)
+		fprintf(out, "%.4f ball blew up at (%.3f, %.3f), pushing %d blocks\n", ev.t, ev.x, ev.y, ev.body);
+	else if(ev.type == EVENT_TARGET)
+		fprintf(out, "%.4f ball hit target %d at (%.3f, %.3f)\n", ev.t, ev.body, ev.x, ev.y);
+}
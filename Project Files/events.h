@@ -0,0 +1,65 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <cstdio>
+#include <vector>
+
+#include "real.h"
+
+/* What happened to the ball, written by the simulation while it steps and
+ * read afterwards by whoever cares (scoring, sound, logging). Writing one
+ * is a copy into a slot that already exists: no I/O and no allocation. */
+
+/* SimEvent::type */
+#define EVENT_CONTACT 0   // the ball bounced off box body of the level, or landed on it
+#define EVENT_REST 1      // the ball came to rest
+#define EVENT_OUT 2       // the ball left the play area
+#define EVENT_TARGET 3    // the ball hit target body (targets.h)
+#define EVENT_BODY 4      // the ball hit body of rigid_world (rigid_world.h)
+#define EVENT_BREAK 5     // body of rigid_world shattered (fracture.h)
+#define EVENT_SPLIT 6     // the ball split into body birds (entities.h)
+#define EVENT_BLAST 7     // the ball blew up, pushing body blocks (rigid_world.h)
+
+struct SimEvent {
+	int type;
+	int body;       // index in obstacles, targets or rigid_world.bodies, birds of a split, blocks of a blast, -1 if none
+	real t;         // simulated seconds since the shot was fired
+	real x, y;      // ball centre, or the block that broke without the ball
+	real nx, ny;    // normal of the surface touched (EVENT_CONTACT, EVENT_BODY)
+	real speed;     // speed towards the surface before the contact (EVENT_CONTACT, EVENT_BODY, EVENT_BREAK)
+};
+
+/* Ring of the last events. Every reader keeps its own cursor, so several
+ * readers see every event in order without taking them from each other.
+ * The writer never waits: a reader that falls more than a whole ring
+ * behind skips to the oldest event left and the ones it missed are
+ * counted in *lost. */
+class EventRing {
+public:
+	void push(const SimEvent& ev)
+	{
+		events[written & mask] = ev;
+		written++;
+	}
+	/* Next event after *cursor into *ev; returns 0 when there is none */
+	int read(unsigned int* cursor, SimEvent* ev, unsigned int* lost = 0) const;
+	/* Cursor that only sees events written from now on */
+	unsigned int end() const { return written; }
+	int capacity() const { return (int)events.size(); }
+
+private:
+	std::vector<SimEvent> events;
+	unsigned int mask;
+	unsigned int written;   // events ever pushed, wraps around
+
+public:
+	/* capacity is rounded up to a power of two */
+	EventRing(int capacity);
+};
+
+extern EventRing sim_events;
+
+/* One line describing ev, for logs */
+void printEvent(FILE* out, const SimEvent& ev);
+
+#endif
@@ -0,0 +1,263 @@
+#include <cmath>
+#include <map>
+
+#include "fracture.h"
+#include "rigid_world.h"
+#include "entities.h"
+#include "targets.h"
+
+using namespace std;
+
+vector<FracturePattern> fracture_patterns;
+int fracture_cells = 8;
+real debris_burst = 0.5f;
+real debris_share = 0.3f;
+real debris_density = 5.0f;
+real debris_life = 8.0f;
+
+/* Pattern of each size and shape made so far */
+static map<long long, int> pattern_of;
+
+/* Next number in [0, 1) of a small LCG, so a size always breaks the same way */
+static real nextRandom(unsigned int* state)
+{
+	*state = *state * 1664525u + 1013904223u;
+	return (real)(*state >> 8) * (real)(1.0 / 16777216.0);
+}
+
+/* Keeps the part of the convex polygon (x, y) where n . p <= offset
+ * (Sutherland-Hodgman against one line) */
+static void clipPolygon(vector<real>& x, vector<real>& y, real nx, real ny, real offset)
+{
+	vector<real> ox, oy;
+	int n = (int)x.size();
+	for(int k = 0; k < n; k++)
+	{
+		int l = (k + 1) % n;
+		real dk = nx * x[k] + ny * y[k] - offset;
+		real dl = nx * x[l] + ny * y[l] - offset;
+		if(dk <= 0)
+		{
+			ox.push_back(x[k]);
+			oy.push_back(y[k]);
+		}
+		if(dk * dl < 0)
+		{
+			real f = dk / (dk - dl);
+			ox.push_back(x[k] + f * (x[l] - x[k]));
+			oy.push_back(y[k] + f * (y[l] - y[k]));
+		}
+	}
+	x.swap(ox);
+	y.swap(oy);
+}
+
+/* Whether (px, py) is inside the anticlockwise convex polygon (x, y) */
+static int insidePolygon(const vector<real>& x, const vector<real>& y, real px, real py)
+{
+	int n = (int)x.size();
+	for(int k = 0; k < n; k++)
+	{
+		int l = (k + 1) % n;
+		if((x[l] - x[k]) * (py - y[k]) - (y[l] - y[k]) * (px - x[k]) < 0)
+			return 0;
+	}
+	return 1;
+}
+
+/* Adds the cell outlined by (x, y) to p: its centroid, and the box with
+ * the same axes and the same spread of area along them (second moments),
+ * shrunk until its corners are inside the cell, so the pieces of a block
+ * don't start out overlapping and pushing each other apart */
+static void addCell(FracturePattern& p, const vector<real>& x, const vector<real>& y)
+{
+	int n = (int)x.size();
+	real area = 0, mx = 0, my = 0;
+	for(int k = 0; k < n; k++)
+	{
+		int l = (k + 1) % n;
+		real cross = x[k] * y[l] - x[l] * y[k];
+		area += cross;
+		mx += (x[k] + x[l]) * cross;
+		my += (y[k] + y[l]) * cross;
+	}
+	area /= 2;
+	if(area <= 1e-6f)
+		return;
+	mx /= 6 * area;
+	my /= 6 * area;
+	real sxx = 0, syy = 0, sxy = 0;
+	for(int k = 0; k < n; k++)
+	{
+		int l = (k + 1) % n;
+		real xk = x[k] - mx, yk = y[k] - my, xl = x[l] - mx, yl = y[l] - my;
+		real cross = xk * yl - xl * yk;
+		sxx += (xk * xk + xk * xl + xl * xl) * cross;
+		syy += (yk * yk + yk * yl + yl * yl) * cross;
+		sxy += (xk * yl + 2 * xk * yk + 2 * xl * yl + xl * yk) * cross;
+	}
+	sxx /= 12;
+	syy /= 12;
+	sxy /= 24;
+	real angle = 0.5f * atan2(2 * sxy, sxx - syy);
+	real c = cos(angle), s = sin(angle);
+	real su = c * c * sxx + 2 * c * s * sxy + s * s * syy;
+	real sv = s * s * sxx - 2 * c * s * sxy + c * c * syy;
+	// A w by h rectangle has su = area w^2 / 12
+	real hx = sqrt(3 * (su > 0 ? su : 0) / area), hy = sqrt(3 * (sv > 0 ? sv : 0) / area);
+	if(hx <= 0 || hy <= 0)
+		return;
+	real shrink = sqrt(area / (4 * hx * hy));
+	for(;;)
+	{
+		real ux = c * hx * shrink, uy = s * hx * shrink, vx = -s * hy * shrink, vy = c * hy * shrink;
+		if(insidePolygon(x, y, mx + ux + vx, my + uy + vy) && insidePolygon(x, y, mx - ux + vx, my - uy + vy) &&
+		   insidePolygon(x, y, mx - ux - vx, my - uy - vy) && insidePolygon(x, y, mx + ux - vx, my + uy - vy))
+			break;
+		shrink *= 0.95f;
+	}
+
+	FractureCell cell = { (int)p.x.size(), n, mx, my, hx * shrink, hy * shrink, angle };
+	for(int k = 0; k < n; k++)
+	{
+		real dx = x[k] - mx, dy = y[k] - my;
+		p.x.push_back(c * dx + s * dy);
+		p.y.push_back(-s * dx + c * dy);
+	}
+	p.cells.push_back(cell);
+}
+
+/* Seeds on a grid about as many cells across as the block is long, each
+ * moved at random within its cell, and the cell of every seed clipped
+ * out of the block by the lines halfway to the others */
+static void buildPattern(FracturePattern& p, int shape, unsigned int state)
+{
+	int n = fracture_cells < 1 ? 1 : fracture_cells;
+	int nx = (int)floor(sqrt(n * p.w / p.h) + 0.5f);
+	nx = nx < 1 ? 1 : (nx > n ? n : nx);
+	int ny = (n + nx - 1) / nx;
+	vector<real> sx, sy;
+	for(int j = 0; j < ny; j++)
+		for(int i = 0; i < nx; i++)
+		{
+			sx.push_back(p.w * ((i + 0.5f + 0.8f * (nextRandom(&state) - 0.5f)) / nx - 0.5f));
+			sy.push_back(p.h * ((j + 0.5f + 0.8f * (nextRandom(&state) - 0.5f)) / ny - 0.5f));
+		}
+
+	vector<real> x, y;
+	for(int k = 0; k < (int)sx.size(); k++)
+	{
+		x.clear();
+		y.clear();
+		if(shape == SHAPE_CIRCLE)
+			for(int m = 0; m < 16; m++)
+			{
+				x.push_back(p.w / 2 * cos(m * 2 * (real)M_PI / 16));
+				y.push_back(p.h / 2 * sin(m * 2 * (real)M_PI / 16));
+			}
+		else
+		{
+			real hw = p.w / 2, hh = p.h / 2;
+			real bx[4] = { -hw, hw, hw, -hw }, by[4] = { -hh, -hh, hh, hh };
+			x.assign(bx, bx + 4);
+			y.assign(by, by + 4);
+		}
+		for(int m = 0; m < (int)sx.size() && x.size() >= 3; m++)
+		{
+			if(m == k)
+				continue;
+			real dx = sx[m] - sx[k], dy = sy[m] - sy[k];
+			clipPolygon(x, y, dx, dy, dx * (sx[m] + sx[k]) / 2 + dy * (sy[m] + sy[k]) / 2);
+		}
+		if(x.size() >= 3)
+			addCell(p, x, y);
+	}
+}
+
+static int patternOf(real w, real h, int shape)
+{
+	int qw = (int)floor(w * 100 + 0.5f), qh = (int)floor(h * 100 + 0.5f);
+	long long key = ((long long)qw << 32 | (unsigned int)qh) << 1 | shape;
+	map<long long, int>::iterator it = pattern_of.find(key);
+	if(it != pattern_of.end())
+		return it->second;
+	FracturePattern p;
+	p.w = qw > 0 ? qw / (real)100 : w;
+	p.h = qh > 0 ? qh / (real)100 : h;
+	buildPattern(p, shape, (unsigned int)qw * 73856093u ^ (unsigned int)qh * 19349663u);
+	fracture_patterns.push_back(p);
+	pattern_of[key] = (int)fracture_patterns.size() - 1;
+	return (int)fracture_patterns.size() - 1;
+}
+
+int fracturePattern(real w, real h)
+{
+	return patternOf(w, h, SHAPE_BOX);
+}
+
+void prepareFracture()
+{
+	for(int i = 0; i < rigid_world.size(); i++)
+	{
+		const RigidBody& b = rigid_world.bodies[i];
+		if((b.flags & BODY_BREAKABLE) && !(b.flags & BODY_REMOVED))
+			patternOf(2 * b.hx, 2 * b.hy, b.shape);
+	}
+	for(int i = 0; i < (int)targets.size(); i++)
+		fracturePattern(targets[i].box.xmax - targets[i].box.xmin, targets[i].box.ymax - targets[i].box.ymin);
+	rigid_world.reserveDebris();
+}
+
+/* Pieces of pattern k for a block at (x, y) turned by angle, moving at
+ * (bvx, bvy) and turning at w */
+static int spawnPieces(int k, real x, real y, real angle, real bvx, real bvy, real w, real vx, real vy, real density, const float color[3])
+{
+	const FracturePattern& p = fracture_patterns[k];
+	real c = cos(angle), s = sin(angle);
+	int added = 0;
+	for(int q = 0; q < (int)p.cells.size(); q++)
+	{
+		const FractureCell& cell = p.cells[q];
+		real rx = c * cell.cx - s * cell.cy, ry = s * cell.cx + c * cell.cy;
+		real r = sqrt(rx * rx + ry * ry);
+		real px = bvx - w * ry + debris_share * vx, py = bvy + w * rx + debris_share * vy;
+		if(r > 0)
+		{
+			px += debris_burst * rx / r;
+			py += debris_burst * ry / r;
+		}
+		int i = rigid_world.addDebris(x + rx, y + ry, 2 * cell.hx, 2 * cell.hy, angle + cell.angle, px, py, w, density, color);
+		if(i < 0)
+			break;
+		rigid_world.bodies[i].pattern = k;
+		rigid_world.bodies[i].cell = q;
+		EntityHandle h = entities.create(ENTITY_DEBRIS);
+		if(Entity* piece = entities.get(h))
+		{
+			piece->body = i;
+			piece->life = debris_life;
+			rigid_world.bodies[i].entity = h.index;
+		}
+		added++;
+	}
+	addEffect(x, y, (p.w > p.h ? p.w : p.h) / 2, 0.4f, color);
+	return added;
+}
+
+int shatterBody(int i, real vx, real vy)
+{
+	const RigidBody b = rigid_world.bodies[i];
+	if(b.flags & BODY_REMOVED)
+		return 0;
+	rigid_world.remove(i);
+	real area = b.shape == SHAPE_CIRCLE ? (real)M_PI * b.hx * b.hx : 4 * b.hx * b.hy;
+	real density = b.inv_mass > 0 ? 1 / (b.inv_mass * area) : debris_density;
+	int k = patternOf(2 * b.hx, 2 * b.hy, b.shape);
+	return spawnPieces(k, b.x, b.y, b.angle, b.vx, b.vy, b.w, vx, vy, density, b.color);
+}
+
+int shatterBox(const Box& box, real vx, real vy, const float color[3])
+{
+	int k = fracturePattern(box.xmax - box.xmin, box.ymax - box.ymin);
+	return spawnPieces(k, (box.xmin + box.xmax) / 2, (box.ymin + box.ymax) / 2, 0, 0, 0, 0, vx, vy, debris_density, color);
+}
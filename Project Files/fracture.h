@@ -0,0 +1,57 @@
+#ifndef FRACTURE_H
+#define FRACTURE_H
+
+#include <vector>
+
+#include "collision.h"
+
+/* Blocks that shatter. The pieces of a block are the Voronoi cells of a
+ * few seeds scattered over it, worked out for every size of block and
+ * target when the level is built (prepareFracture), so a break is a table
+ * lookup and a few debris bodies from the slots rigid_world made for them
+ * then (rigid_world.h). Every
+ * piece is simulated as a box along the axes of its cell and inside it
+ * (the world has no polygons), and drawn as the cell itself. Every piece
+ * is also an entity (entities.h) that takes it away after debris_life
+ * seconds, and a puff marks where the block was. No OpenGL in here. */
+
+struct FractureCell {
+	int first, count;  // outline in the pattern's x and y, anticlockwise
+	real cx, cy;       // centroid, from the centre of the block
+	real hx, hy;       // half extents of the box simulated
+	real angle;        // of the box, from the axes of the block
+};
+
+/* The pieces of a w by h block. Outlines are in the frame of the box of
+ * their cell, so a piece is drawn from its body alone. */
+struct FracturePattern {
+	real w, h;
+	std::vector<real> x, y;
+	std::vector<FractureCell> cells;
+};
+
+extern std::vector<FracturePattern> fracture_patterns;
+extern int fracture_cells;     // about how many pieces a new pattern has
+extern real debris_burst;      // speed the pieces fly apart at, from the centre
+extern real debris_share;      // share of the velocity of what hit it the pieces get
+extern real debris_density;    // of the pieces of targets and of blocks that never moved
+extern real debris_life;       // seconds a piece lasts, 0 for until its slot is needed
+
+/* Index of the pattern of a w by h block, made the first time that size
+ * (to a hundredth) is asked for */
+int fracturePattern(real w, real h);
+
+/* Makes the pattern of every breakable block of rigid_world and of every
+ * target, and the slots of the debris pool, so breaking them during play
+ * never allocates. Call it once the level is built. */
+void prepareFracture();
+
+/* Replaces block i of rigid_world by its pieces, flying apart and carried
+ * on by (vx, vy), the velocity of what broke it. A circle breaks along a
+ * pattern of its own. Returns the pieces added. */
+int shatterBody(int i, real vx, real vy);
+/* Pieces of a box that is not a body (a target hit), at rest until hit
+ * by something moving at (vx, vy) */
+int shatterBox(const Box& box, real vx, real vy, const float color[3]);
+
+#endif
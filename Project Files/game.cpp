@@ -2,6 +2,9 @@
 #include <cmath>
 #include <fstream>
 #include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -13,9 +16,21 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "simulation.h"
+#include "obstacles.h"
+#include "events.h"
+#include "targets.h"
+#include "fracture.h"
+#include "rigid_world.h"
+#include "kinematic.h"
+#include "entities.h"
+#include "scene.h"
+
 using namespace std;
 
 double last_update_time, current_time;
+int steps_since_reset = 0;   // physics steps, the timeout clock of the deterministic mode
+FILE* record_file = NULL;    // --record: every shot fired, as input for --headless
 
 
 struct VAO {
@@ -337,12 +352,6 @@ GLuint createTexture (const char* filename)
 float rectangle_rot_dir = 1;
 bool triangle_rot_status = true;
 bool rectangle_rot_status = true;*/
-float u = 4.0;
-float g = 4.0;
-float thita = 45;
-float thita_ball = 45;
-int fire = 0;
-int fl = 0;
 float u_xn = -4.0f;
 float u_xp = 4.0f;
 float u_yn = -4.0f;
@@ -403,10 +412,14 @@ void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
 
             case GLFW_KEY_SPACE:
             {
-            	thita_ball = thita;
-                fire = 1;
-                fl = 1;
+            	fireBall();
+            	if (record_file)
+            	{
+            		fprintf(record_file, "%.9g %.9g\n", u, thita);
+            		fflush(record_file);
+            	}
                 last_update_time = glfwGetTime();
+                steps_since_reset = 0;
 	            break;
 
 	        }
@@ -419,6 +432,14 @@ void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
             	u -= 0.2;
             	break;
 
+            case GLFW_KEY_D:
+            	splitBall();
+            	break;
+
+            case GLFW_KEY_E:
+            	explodeBall();
+            	break;
+
             default:
                 break;
         }
@@ -529,7 +550,16 @@ void reshapeWindow (GLFWwindow* window, int width, int height)
     Matrices.projection = glm::ortho(u_xn, u_xp, u_yn, u_yp, 0.1f, 500.0f);
 }
 
-VAO *triangle, *rectangle1, *rectangle2, *trep, *cannon_circle, *cannon_ball, *zameen, *obs1, *obs2_1, *obs2_2, *obs3;
+/* A mesh of the scene (scene.h). One drawn from a table of the simulation
+ * has the function that fills its vertices again. */
+struct Mesh {
+	VAO* vao;
+	int (*vertices)(vector<GLfloat>&, vector<GLfloat>&); // NULL for a mesh made once
+	const int* version;  // filled again only when this changes, NULL for every frame
+	int drawn_version;
+};
+
+vector<Mesh> meshes;
 
 // Creates the triangle object used in this sample code
 /*void createTriangle ()
@@ -552,7 +582,7 @@ VAO *triangle, *rectangle1, *rectangle2, *trep, *cannon_circle, *cannon_ball, *z
   // create3DObject creates and returns a handle to a VAO that can be used later
   triangle = create3DObject(GL_TRIANGLES, 3, vertex_buffer_data, color_buffer_data, GL_LINE);
 }*/
-void createTrep()
+VAO* createTrep()
 {
 	static const GLfloat vertex_buffer_data [] = {
     0.3,0,0,
@@ -581,297 +611,345 @@ void createTrep()
     0,0,0, // color 4
     0,0,0  // color 1
   };
-  trep = create3DObject(GL_TRIANGLES, 9, vertex_buffer_data, color_buffer_data, GL_FILL);
+  return create3DObject(GL_TRIANGLES, 9, vertex_buffer_data, color_buffer_data, GL_FILL);
 }
 
+/* Black disc of radius 1, for the cannon wheel and the ball, which the
+ * scene scales to their size */
 float TwoPI = 2 * 3.14159;
-void createCannonCircle()
+VAO* createDisc()
 {
 	int NoOfTriangles = 360;
 	int i;
-	float radius = 0.3;
 	GLfloat vertex_buffer_data[3240];
 	GLfloat color_buffer_data[3240];
 	for(i=0 ; i<NoOfTriangles ; i++)
 	{
 		vertex_buffer_data[9*i] = 0;
 		vertex_buffer_data[9*i+1] = 0;
-		vertex_buffer_data[9*i+2] = 0;	
-		
-		vertex_buffer_data [9*i+3] = radius * cos(i * TwoPI / NoOfTriangles);
-		vertex_buffer_data [9*i+4] = radius * sin(i * TwoPI / NoOfTriangles);
+		vertex_buffer_data[9*i+2] = 0;
+
+		vertex_buffer_data [9*i+3] = cos(i * TwoPI / NoOfTriangles);
+		vertex_buffer_data [9*i+4] = sin(i * TwoPI / NoOfTriangles);
 		vertex_buffer_data [9*i+5] = 0;
 
-		vertex_buffer_data [9*i+6] = radius * cos((i+1) * TwoPI / NoOfTriangles);
-		vertex_buffer_data [9*i+7] = radius * sin((i+1) * TwoPI / NoOfTriangles);
+		vertex_buffer_data [9*i+6] = cos((i+1) * TwoPI / NoOfTriangles);
+		vertex_buffer_data [9*i+7] = sin((i+1) * TwoPI / NoOfTriangles);
 		vertex_buffer_data [9*i+8] = 0;
 	}
-	for(i=0 ; i<NoOfTriangles ; i++)
-	{
-		color_buffer_data[9*i] = 0;
-		color_buffer_data[9*i+1] = 0;
-		color_buffer_data[9*i+2] = 0;
+	for(i=0 ; i<3*3*NoOfTriangles ; i++)
+		color_buffer_data[i] = 0;
 
-		color_buffer_data[9*i+3] = 0;
-		color_buffer_data[9*i+4] = 0;
-		color_buffer_data[9*i+5] = 0;
-
-		color_buffer_data[9*i+6] = 0;
-		color_buffer_data[9*i+7] = 0;
-		color_buffer_data[9*i+8] = 0;
+	return create3DObject(GL_TRIANGLES, 1080 , vertex_buffer_data, color_buffer_data, GL_FILL);
+}
 
+/* Appends the two triangles of box b in world coordinates */
+void addQuad (vector<GLfloat>& vertex_buffer_data, vector<GLfloat>& color_buffer_data, const Box& b, const float* color)
+{
+	GLfloat x0 = b.xmin, x1 = b.xmax, y0 = b.ymin, y1 = b.ymax;
+	GLfloat quad[18] = {
+		x1,y1,0, // vertex 1
+		x0,y1,0, // vertex 2
+		x0,y0,0, // vertex 3
+
+		x0,y0,0, // vertex 3
+		x1,y0,0, // vertex 4
+		x1,y1,0  // vertex 1
+	};
+	for(int k = 0; k < 18; k++)
+	{
+		vertex_buffer_data.push_back(quad[k]);
+		color_buffer_data.push_back(color[k % 3]);
 	}
-
-	cannon_circle = create3DObject(GL_TRIANGLES, 1080 , vertex_buffer_data, color_buffer_data, GL_FILL);
 }
 
-void createCannonBall()
+/* Quad per box of the obstacle table, floor included, in world coordinates.
+ * Kinematic boxes move every step and have a VAO of their own. Returns the
+ * number of vertices. */
+int obstacleVertices (vector<GLfloat>& vertex_buffer_data, vector<GLfloat>& color_buffer_data)
 {
-	int NoOfTriangles = 360;
-	int i;
-	float radius = 0.15;
-	GLfloat vertex_buffer_data[3240];
-	GLfloat color_buffer_data[3240];
-	for(i=0 ; i<NoOfTriangles ; i++)
+	vertex_buffer_data.clear();
+	color_buffer_data.clear();
+	for(int i = 0; i < (int)obstacles.size(); i++)
 	{
-		vertex_buffer_data[9*i] = 0;
-		vertex_buffer_data[9*i+1] = 0;
-		vertex_buffer_data[9*i+2] = 0;	
-		
-		vertex_buffer_data [9*i+3] = radius * cos(i * TwoPI / NoOfTriangles);
-		vertex_buffer_data [9*i+4] = radius * sin(i * TwoPI / NoOfTriangles);
-		vertex_buffer_data [9*i+5] = 0;
-
-		vertex_buffer_data [9*i+6] = radius * cos((i+1) * TwoPI / NoOfTriangles);
-		vertex_buffer_data [9*i+7] = radius * sin((i+1) * TwoPI / NoOfTriangles);
-		vertex_buffer_data [9*i+8] = 0;
+		if(obstacles[i].state == OBSTACLE_REMOVED || obstacles[i].state == OBSTACLE_KINEMATIC)
+			continue;
+		addQuad(vertex_buffer_data, color_buffer_data, obstacles[i].box, obstacles[i].color);
 	}
-	for(i=0 ; i<NoOfTriangles ; i++)
-	{
-		color_buffer_data[9*i] = 0;
-		color_buffer_data[9*i+1] = 0;
-		color_buffer_data[9*i+2] = 0;
-
-		color_buffer_data[9*i+3] = 0;
-		color_buffer_data[9*i+4] = 0;
-		color_buffer_data[9*i+5] = 0;
-
-		color_buffer_data[9*i+6] = 0;
-		color_buffer_data[9*i+7] = 0;
-		color_buffer_data[9*i+8] = 0;
+	return (int)vertex_buffer_data.size() / 3;
+}
 
+/* Quad per kinematic box where it is now. Returns the number of vertices. */
+int kinematicVertices (vector<GLfloat>& vertex_buffer_data, vector<GLfloat>& color_buffer_data)
+{
+	vertex_buffer_data.clear();
+	color_buffer_data.clear();
+	for(int k = 0; k < (int)kinematics.size(); k++)
+	{
+		const Obstacle& o = obstacles[kinematics[k].obstacle];
+		if(o.state == OBSTACLE_KINEMATIC)
+			addQuad(vertex_buffer_data, color_buffer_data, o.box, o.color);
 	}
-
-	cannon_ball = create3DObject(GL_TRIANGLES, 1080 , vertex_buffer_data, color_buffer_data, GL_FILL);
+	return (int)vertex_buffer_data.size() / 3;
 }
-// Creates the rectangle object used in this sample code
 
-void CreateTarget1()
+/* Black quad per live target. Returns the number of vertices. */
+int targetVertices (vector<GLfloat>& vertex_buffer_data, vector<GLfloat>& color_buffer_data)
 {
-	// GL3 accepts only Triangles. Quads are not supported
-	static const GLfloat vertex_buffer_data [] = {
-		0.5,0,0, // vertex 1
-		0.5,1,0, // vertex 2
-		-0.5,1,0, // vertex 3
-
-		-0.5,1,0, // vertex 3
-		-0.5,0,0, // vertex 4
-		0.5,0,0  // vertex 1
-	};
-
-	static const GLfloat color_buffer_data [] = {
-		0,0,0, // color 1
-		0,0,0, // color 2
-		0,0,0, // color 3
-
-		0,0,0, // color 3
-		0,0,0, // color 4
-		0,0,0  // color 1
-	};
-
-	// create3DObject creates and returns a handle to a VAO that can be used later
-	rectangle1 = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
+	static const float black[3] = { 0, 0, 0 };
+	vertex_buffer_data.clear();
+	color_buffer_data.clear();
+	for(int i = 0; i < (int)targets.size(); i++)
+		if(targets[i].alive)
+			addQuad(vertex_buffer_data, color_buffer_data, targets[i].box, black);
+	return (int)vertex_buffer_data.size() / 3;
 }
-void CreateTarget2()
-{
-	// GL3 accepts only Triangles. Quads are not supported
-	static const GLfloat vertex_buffer_data [] = {
-		0.4,0,0, // vertex 1
-		0.4,1,0, // vertex 2
-		-0.4,1,0, // vertex 3
-
-		-0.4,1,0, // vertex 3
-		-0.4,0,0, // vertex 4
-		0.4,0,0  // vertex 1
-	};
 
-	static const GLfloat color_buffer_data [] = {
-		0,0,0, // color 1
-		0,0,0, // color 2
-		0,0,0, // color 3
-
-		0,0,0, // color 3
-		0,0,0, // color 4
-		0,0,0  // color 1
-	};
-
-	// create3DObject creates and returns a handle to a VAO that can be used later
-	rectangle2 = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
-}
-void createObs2_1 ()
+/* Triangles of every block of rigid_world where it is now, boxes turned by
+ * their angle, circles as 16 sided fans and debris as fans of the outline
+ * of its fracture cell. Returns the number of vertices. */
+int bodyVertices (vector<GLfloat>& vertex_buffer_data, vector<GLfloat>& color_buffer_data)
 {
-	// GL3 accepts only Triangles. Quads are not supported
-	static const GLfloat vertex_buffer_data [] = {
-		0.2,1.0f,0, // vertex 1
-		-0.2,1.0f,0, // vertex 2
-		-0.2,-1,0, // vertex 3
-
-		-0.2,-1,0, // vertex 3
-		0.2,-1,0, // vertex 4
-		0.2,1.0f,0  // vertex 1
-	};
-
-	static const GLfloat color_buffer_data [] = {
-		0.4f,0.6f,0.6f, // color 1
-		0.4f,0.6f,0.6f,
-		0.4f,0.6f,0.6f,
-		0.4f,0.6f,0.6f,
-		0.4f,0.6f,0.6f,
-		0.4f,0.6f,0.6f
-	};
-
-	// create3DObject creates and returns a handle to a VAO that can be used later
-	obs2_1 = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
+	vertex_buffer_data.clear();
+	color_buffer_data.clear();
+	for(int i = 0; i < rigid_world.size(); i++)
+	{
+		const RigidBody& b = rigid_world.bodies[i];
+		if(b.flags & BODY_REMOVED)
+			continue;
+		if(b.pattern >= 0)
+		{
+			const FracturePattern& p = fracture_patterns[b.pattern];
+			const FractureCell& cell = p.cells[b.cell];
+			for(int k = 0; k < cell.count; k++)
+			{
+				int k0 = cell.first + k, k1 = cell.first + (k + 1) % cell.count;
+				GLfloat tri[9] = {
+					(GLfloat)b.x, (GLfloat)b.y, 0,
+					(GLfloat)(b.x + b.c * p.x[k0] - b.s * p.y[k0]), (GLfloat)(b.y + b.s * p.x[k0] + b.c * p.y[k0]), 0,
+					(GLfloat)(b.x + b.c * p.x[k1] - b.s * p.y[k1]), (GLfloat)(b.y + b.s * p.x[k1] + b.c * p.y[k1]), 0
+				};
+				for(int m = 0; m < 9; m++)
+				{
+					vertex_buffer_data.push_back(tri[m]);
+					color_buffer_data.push_back(b.color[m % 3]);
+				}
+			}
+			continue;
+		}
+		if(b.shape == SHAPE_BOX)
+		{
+			GLfloat ax = b.c * b.hx, ay = b.s * b.hx;  // half of the x side
+			GLfloat bx = -b.s * b.hy, by = b.c * b.hy; // half of the y side
+			GLfloat x = b.x, y = b.y;
+			GLfloat quad[18] = {
+				x+ax+bx,y+ay+by,0, // vertex 1
+				x-ax+bx,y-ay+by,0, // vertex 2
+				x-ax-bx,y-ay-by,0, // vertex 3
+
+				x-ax-bx,y-ay-by,0, // vertex 3
+				x+ax-bx,y+ay-by,0, // vertex 4
+				x+ax+bx,y+ay+by,0  // vertex 1
+			};
+			for(int k = 0; k < 18; k++)
+			{
+				vertex_buffer_data.push_back(quad[k]);
+				color_buffer_data.push_back(b.color[k % 3]);
+			}
+			continue;
+		}
+		for(int k = 0; k < 16; k++)
+		{
+			float a0 = b.angle + k * 2 * M_PI / 16, a1 = b.angle + (k + 1) * 2 * M_PI / 16;
+			GLfloat tri[9] = {
+				(GLfloat)b.x, (GLfloat)b.y, 0,
+				(GLfloat)(b.x + b.hx * cos(a0)), (GLfloat)(b.y + b.hx * sin(a0)), 0,
+				(GLfloat)(b.x + b.hx * cos(a1)), (GLfloat)(b.y + b.hx * sin(a1)), 0
+			};
+			for(int m = 0; m < 9; m++)
+			{
+				vertex_buffer_data.push_back(tri[m]);
+				// The centre darker, so it can be seen rolling
+				color_buffer_data.push_back(m < 3 ? b.color[m] * 0.5f : b.color[m % 3]);
+			}
+		}
+	}
+	return (int)vertex_buffer_data.size() / 3;
 }
-void createObs2_2()
-{
-	// GL3 accepts only Triangles. Quads are not supported
-	static const GLfloat vertex_buffer_data [] = {
-		0.2,1.0f,0, // vertex 1
-		-0.2,1.0f,0, // vertex 2
-		-0.2,-1,0, // vertex 3
-
-		-0.2,-1,0, // vertex 3
-		0.2,-1,0, // vertex 4
-		0.2,1.0f,0  // vertex 1
-	};
 
-	static const GLfloat color_buffer_data [] = {
-		0.4f,0.6f,0.6f, // color 1
-		0.4f,0.6f,0.6f,
-		0.4f,0.6f,0.6f,
-		0.4f,0.6f,0.6f,
-		0.4f,0.6f,0.6f,
-		0.4f,0.6f,0.6f
-	};
-
-	// create3DObject creates and returns a handle to a VAO that can be used later
-	obs2_2 = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
-}
-void createObs1()
+/* Lines of every joint of rigid_world: rods and ropes from anchor to
+ * anchor, hinges as a small cross. Returns the number of vertices. */
+int jointVertices (vector<GLfloat>& vertex_buffer_data, vector<GLfloat>& color_buffer_data)
 {
-	// GL3 accepts only Triangles. Quads are not supported
-	static const GLfloat vertex_buffer_data [] = {
-		0.2,1.5,0, // vertex 1
-		-0.2,1.5,0, // vertex 2
-		-0.2,-2,0, // vertex 3
-
-		-0.2,-2,0, // vertex 3
-		0.2,-2,0, // vertex 4
-		0.2,1.5,0  // vertex 1
-	};
-
-	static const GLfloat color_buffer_data [] = {
-		0.4f,0.6f,0.6f, // color 1
-		0.4f,0.6f,0.6f,
-		0.4f,0.6f,0.6f,
-		0.4f,0.6f,0.6f,
-		0.4f,0.6f,0.6f,
-		0.4f,0.6f,0.6f
-	};
-
-	// create3DObject creates and returns a handle to a VAO that can be used later
-	obs1 = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
+	vertex_buffer_data.clear();
+	color_buffer_data.clear();
+	for(int k = 0; k < (int)rigid_world.joints.size(); k++)
+	{
+		const Joint& j = rigid_world.joints[k];
+		const RigidBody& a = rigid_world.bodies[j.a];
+		GLfloat ax = a.x + a.c * j.lax - a.s * j.lay, ay = a.y + a.s * j.lax + a.c * j.lay;
+		GLfloat bx = j.lbx, by = j.lby;
+		if(j.b >= 0)
+		{
+			const RigidBody& b = rigid_world.bodies[j.b];
+			bx = b.x + b.c * j.lbx - b.s * j.lby;
+			by = b.y + b.s * j.lbx + b.c * j.lby;
+		}
+		GLfloat line[12] = { ax, ay, 0, bx, by, 0 };
+		int count = 6;
+		if(j.type == JOINT_REVOLUTE)
+		{
+			GLfloat cross[12] = { ax-0.03f,ay-0.03f,0, ax+0.03f,ay+0.03f,0, ax-0.03f,ay+0.03f,0, ax+0.03f,ay-0.03f,0 };
+			for(int m = 0; m < 12; m++)
+				line[m] = cross[m];
+			count = 12;
+		}
+		// Ropes brown, rods and hinges dark grey
+		GLfloat color[3] = { 0.25f, 0.25f, 0.25f };
+		if(j.type == JOINT_ROPE)
+		{
+			color[0] = 0.5f;
+			color[1] = 0.35f;
+			color[2] = 0.15f;
+		}
+		for(int m = 0; m < count; m++)
+		{
+			vertex_buffer_data.push_back(line[m]);
+			color_buffer_data.push_back(color[m % 3]);
+		}
+	}
+	return (int)vertex_buffer_data.size() / 3;
 }
-void createObs3()
+
+/* Replaces the vertices of vao with n new ones */
+void uploadVertices (VAO* vao, const vector<GLfloat>& vertex_buffer_data, const vector<GLfloat>& color_buffer_data, int n)
 {
-	// GL3 accepts only Triangles. Quads are not supported
-	static const GLfloat vertex_buffer_data [] = {
-		0.2,2,0, // vertex 1
-		-0.2,2,0, // vertex 2
-		-0.2,-2,0, // vertex 3
+	vao->NumVertices = n;
+	glBindBuffer (GL_ARRAY_BUFFER, vao->VertexBuffer);
+	glBufferData (GL_ARRAY_BUFFER, 3*n*sizeof(GLfloat), n ? &vertex_buffer_data[0] : NULL, GL_STREAM_DRAW);
+	glBindBuffer (GL_ARRAY_BUFFER, vao->ColorBuffer);
+	glBufferData (GL_ARRAY_BUFFER, 3*n*sizeof(GLfloat), n ? &color_buffer_data[0] : NULL, GL_STREAM_DRAW);
+}
 
-		-0.2,-2,0, // vertex 3
-		0.2,-2,0, // vertex 4
-		0.2,2,0  // vertex 1
-	};
+/* Octagon per bird of a split and per effect. An effect grows to twice
+ * its radius and fades into the background over its life. Returns the
+ * number of vertices. */
+int entityVertices (vector<GLfloat>& vertex_buffer_data, vector<GLfloat>& color_buffer_data)
+{
+	static const float background[3] = { 1.0f, 0.6f, 0.4f };
+	vertex_buffer_data.clear();
+	color_buffer_data.clear();
+	for(int i = 0; i < entities.capacity(); i++)
+	{
+		if(!entities.alive(i) || entities.items[i].kind == ENTITY_DEBRIS)
+			continue;
+		const Entity& en = entities.items[i];
+		float f = en.kind == ENTITY_EFFECT && en.life > 0 ? en.age / en.life : 0;
+		float r = en.radius * (1 + f);
+		float color[3];
+		for(int c = 0; c < 3; c++)
+			color[c] = en.color[c] + f * (background[c] - en.color[c]);
+		for(int k = 0; k < 8; k++)
+		{
+			float a0 = k * (float)M_PI / 4, a1 = (k + 1) * (float)M_PI / 4;
+			GLfloat tri[9] = {
+				(GLfloat)en.x, (GLfloat)en.y, 0,
+				(GLfloat)(en.x + r * cos(a0)), (GLfloat)(en.y + r * sin(a0)), 0,
+				(GLfloat)(en.x + r * cos(a1)), (GLfloat)(en.y + r * sin(a1)), 0
+			};
+			for(int m = 0; m < 9; m++)
+			{
+				vertex_buffer_data.push_back(tri[m]);
+				color_buffer_data.push_back(color[m % 3]);
+			}
+		}
+	}
+	return (int)vertex_buffer_data.size() / 3;
+}
 
-	static const GLfloat color_buffer_data [] = {
-		0.4f,0.6f,0.6f, // color 1
-		0.4f,0.6f,0.6f,
-		0.4f,0.6f,0.6f,
-		0.4f,0.6f,0.6f,
-		0.4f,0.6f,0.6f,
-		0.4f,0.6f,0.6f
-	};
+/* Index in meshes of a mesh made once */
+int addMesh (VAO* vao)
+{
+	Mesh m = { vao, NULL, NULL, 0 };
+	meshes.push_back(m);
+	return (int)meshes.size() - 1;
+}
 
+/* Index in meshes of a mesh made from what vertices returns, and filled
+ * again by updateMeshes() */
+int addMesh (GLenum primitive_mode, int (*vertices)(vector<GLfloat>&, vector<GLfloat>&), const int* version)
+{
+	vector<GLfloat> vertex_buffer_data, color_buffer_data;
+	int n = vertices(vertex_buffer_data, color_buffer_data);
+	GLenum fill_mode = primitive_mode == GL_LINES ? GL_LINE : GL_FILL;
 	// create3DObject creates and returns a handle to a VAO that can be used later
-	obs3 = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
+	Mesh m = { create3DObject(primitive_mode, n, n ? &vertex_buffer_data[0] : NULL, n ? &color_buffer_data[0] : NULL, fill_mode),
+	           vertices, version, version ? *version : 0 };
+	meshes.push_back(m);
+	return (int)meshes.size() - 1;
 }
 
-
-void createFloor ()
+/* Fills the meshes drawn from the simulation again: the ones with a
+ * version when it changed, the others every frame unless they were and
+ * stay empty */
+void updateMeshes ()
 {
-  // GL3 accepts only Triangles. Quads are not supported
-  static const GLfloat vertex_buffer_data [] = {
-    4,0.3,0, // vertex 1
-    -4,0.3,0, // vertex 2
-    -4,-0.8,0, // vertex 3
-
-    -4,-0.8,0, // vertex 3
-    4,-0.8,0, // vertex 4
-    4,0.3,0  // vertex 1
-  };
-
-  static const GLfloat color_buffer_data [] = {
-    0,0.51,0, // color 1
-    0,0.51,0, // color 2
-    0,0.51,0, // color 3
+	static vector<GLfloat> vertex_buffer_data, color_buffer_data;
+	for(int k = 0; k < (int)meshes.size(); k++)
+	{
+		Mesh& m = meshes[k];
+		if(!m.vertices || (m.version && *m.version == m.drawn_version))
+			continue;
+		int n = m.vertices(vertex_buffer_data, color_buffer_data);
+		if(m.version)
+			m.drawn_version = *m.version;
+		else if(n == 0 && m.vao->NumVertices == 0)
+			continue;
+		uploadVertices(m.vao, vertex_buffer_data, color_buffer_data, n);
+	}
+}
 
-    0,0.51,0, // color 3
-    0,0.51,0, // color 4
-    0,0.51,0  // color 1
-  };
+/* Row of the scene drawing mesh in layer at (x, y), scale times its size */
+SceneObject addDrawn (unsigned int mask, int mesh, int layer, float x, float y, float scale)
+{
+	SceneObject o = scene.add(mask | COMPONENT_TRANSFORM | COMPONENT_MESH);
+	Archetype& a = scene.archetypes[o.archetype];
+	a.mesh[o.row] = mesh;
+	a.layer[o.row] = layer;
+	a.x[o.row] = x;
+	a.y[o.row] = y;
+	a.scale[o.row] = scale;
+	return o;
+}
 
-  // create3DObject creates and returns a handle to a VAO that can be used later
-  zameen = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
+/* Everything the window draws, as rows of the scene in the order they
+ * are drawn. The level, its targets, blocks and entities are one mesh
+ * each, already in world coordinates; the cannon stands where shots leave
+ * from and its barrel turns with thita. */
+void createScene ()
+{
+	int disc = addMesh(createDisc());
+	int layer = 0;
+	addDrawn(0, addMesh(GL_TRIANGLES, obstacleVertices, &obstacle_version), layer++, 0, 0, 1);
+	addDrawn(0, addMesh(GL_TRIANGLES, kinematicVertices, NULL), layer++, 0, 0, 1);
+	SceneObject barrel = addDrawn(COMPONENT_AIM, addMesh(createTrep()), layer++, -3, -2.75f, 1);
+	scene.archetypes[barrel.archetype].aim[barrel.row] = -90;
+	addDrawn(0, disc, layer++, -3, -2.75f, 0.3f);
+	addDrawn(0, addMesh(GL_TRIANGLES, targetVertices, &target_version), layer++, 0, 0, 1);
+	addDrawn(0, addMesh(GL_TRIANGLES, bodyVertices, NULL), layer++, 0, 0, 1);
+	addDrawn(0, addMesh(GL_LINES, jointVertices, NULL), layer++, 0, 0, 1);
+	addDrawn(0, addMesh(GL_TRIANGLES, entityVertices, NULL), layer++, 0, 0, 1);
+	addDrawn(COMPONENT_BALL, disc, layer++, 0, 0, ball_radius);
 }
 
 float camera_rotation_angle = 90;
 float rectangle_rotation = 0;
 float triangle_rotation = 0;
-float t = 0;
 int difficulty_level  = 1;
-int Target_visible = 1;
-float x_cannonball;
-float y_cannonball;
-float e = 0.6;
-float v = u; 
-float ux;
-float uy;
-float vx = ux;
-float vy;
-int score = 0;
 int ball_visible = 1;
-int collision_flag = 0;
-int in_air_flag = 0;
-float x_till_collision = -3.0f;
-float y_till_collision = -2.75f;
 float delta;
 float alpha;
 float beta;
-int obs_collision = 0;
-float t_till_now = 0;
 //int updatescore = 0 ;
 
 //if(updatescore == 1)
@@ -879,211 +957,13 @@ float t_till_now = 0;
 //	score += 5;
 //}
 
-bool checkCollisionTarget(float x_ball, float y_ball, float xsmall_target, float xlarge_target, float ysmall_target, float ylarge_target)
-{
-	if(x_ball >= xsmall_target && x_ball <= xlarge_target && y_ball <= ylarge_target && y_ball >= ysmall_target)
-		return true;
-	else
-		return false;
-}
-
-void CheckFloorCollisions(float x_ball, float y_ball, float x_small, float x_large,float y_small)
-{
-	if(y_ball >= y_small && y_ball < (y_small + 0.15f) && x_ball < x_large && x_ball > x_small)
-	{	
-		///cout << "collide with floor!\n";
-		cout << "thita ball collide with floor" << thita_ball << " thita: " << thita << "\n";
-		collision_flag = 1;
-		in_air_flag = 0;
-		fire = 0;
-		x_till_collision = x_ball;
-		y_till_collision = y_ball + 0.1f;
-		//u = inst_velocty;
-		obs_collision = 0;
-		t_till_now = 0;
-	}
-}
-
-bool checkCollisionObs(float x_ball, float y_ball,  float xsmall_obs, float xlarge_obs, float ysmall_obs, float ylarge_obs, float t)
-{
-	///cout << "x_ball: " << x_ball << "\n";
-	///cout << "y_ball: " << y_ball << "\n" ;
-	if(x_ball >= (xsmall_obs - 0.15f) && x_ball < (xlarge_obs + 0.15f) && y_ball < ylarge_obs && y_ball > ysmall_obs)
-	{
-		///cout << "Collide with Obs\n";
-		cout << "thita ball collide with OBS: " << thita_ball << " thita: " << thita << "\n";
-		//cout << "dist bw centers:" << sqrt(pow((x_ball - x_centroid),2) + pow((y_ball - y_centroid),2)) << "<" << "radius + 0.15: "<< 0.15f + radius << "\n";
-		collision_flag = 1;
-		in_air_flag = 0;
-		fire = 0;
-		if(vx > 0)
-		{
-			x_till_collision = x_ball - 0.1f;
-		}
-		else
-		{
-			x_till_collision = x_ball + 0.1f;
-		}
-		//y_till_collision = y_ball;
-		t_till_now = t;
-		//alpha = acos((float)( (u * cos((float)((thita_ball+90)*M_PI/180.0f))) / inst_velocty));
-		//delta = atan((float)((0 - x_till_collision)/(-2.0f - y_till_collision)));
-		//u = inst_velocty;
-		obs_collision = 1;
-		return true;
-	}
-	return false;
-}
-
-/* Render the scene with openGL */
-/* Edit this function according to your assignment */
-void drawCannon () //Draws cannon plus fireballs
-{
-  
-  
-  // use the loaded shader program
-  // Don't change unless you know what you are doing
-  glUseProgram (programID);
-
-  // Eye - Location of camera. Don't change unless you are sure!!
-  glm::vec3 eye ( 5*cos(camera_rotation_angle*M_PI/180.0f), 0, 5*sin(camera_rotation_angle*M_PI/180.0f) );
-  // Target - Where is the camera looking at.  Don't change unless you are sure!!
-  glm::vec3 target (0, 0, 0);
-  // Up - Up vector defines tilt of camera.  Don't change unless you are sure!!
-  glm::vec3 up (0, 1, 0);
-
-  // Compute Camera matrix (view)
-  // Matrices.view = glm::lookAt( eye, target, up ); // Rotating Camera for 3D
-  //  Don't change unless you are sure!!
-  Matrices.view = glm::lookAt(glm::vec3(camera_position,0,3), glm::vec3(camera_position,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
-
-  // Compute ViewProject matrix as view/camera might not be changed for this frame (basic scenario)
-  //  Don't change unless you are sure!!
-  glm::mat4 VP = Matrices.projection * Matrices.view;
-
-  // Send our transformation to the currently bound shader, in the "MVP" uniform
-  // For each model you render, since the MVP will be different (at least the M part)
-  //  Don't change unless you are sure!!
-  glm::mat4 MVP;	// MVP = Projection * View * Model
-/*
- // Load identity to model matrix
-  Matrices.model = glm::mat4(1.0f);
-
-  /* Render your scene 
-
-  glm::mat4 translateTriangle = glm::translate (glm::vec3(-2.0f, 0.0f, 0.0f)); // glTranslatef
-  glm::mat4 rotateTriangle = glm::rotate((float)(triangle_rotation*M_PI/180.0f), glm::vec3(0,0,1));  // rotate about vector (1,0,0)
-  glm::mat4 triangleTransform = translateTriangle * rotateTriangle;
-  Matrices.model *= triangleTransform; 
-  MVP = VP * Matrices.model; // MVP = p * V * M
-
-  //  Don't change unless you are sure!!
-  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);*/
-
-  // draw3DObject draws the VAO given to it using current MVP matrix
-  //draw3DObject(triangle);
-
-  // Pop matrix to undo transformations till last push matrix instead of recomputing model matrix
-  // glPopMatrix ();
-
-	
-  Matrices.model = glm::mat4(1.0f);
-
-  glm::mat4 translateTrep = glm::translate (glm::vec3(-3,-2.75,0));        // glTranslatef
-  glm::mat4 rotateTrep = glm::rotate((float)((thita-90) * M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-  Matrices.model *= (translateTrep * rotateTrep);
-  MVP = VP * Matrices.model;
-  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-  // draw3DObject draws the VAO given to it using current MVP matrix,
-  draw3DObject(trep);
-
-  
-
-//***** end of exp code *****//
-   
-   Matrices.model = glm::mat4(1.0f);
-
-
-  glm::mat4 translateCannonCircle = glm::translate (glm::vec3(-3,-2.75,0));        // glTranslatef
-  //glm::mat4 rotateRectangle = glm::rotate((float)(rectangle_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-  Matrices.model *= translateCannonCircle;
-  MVP = VP * Matrices.model;
-  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-  // draw3DObject draws the VAO given to it using current MVP matrix
-  draw3DObject(cannon_circle);
-}
-void drawCannonBall(float x_ball, float y_ball)
-{
-	 // use the loaded shader program
-  // Don't change unless you know what you are doing
-  glUseProgram (programID);
-
-  // Eye - Location of camera. Don't change unless you are sure!!
-  glm::vec3 eye ( 5*cos(camera_rotation_angle*M_PI/180.0f), 0, 5*sin(camera_rotation_angle*M_PI/180.0f) );
-  // Target - Where is the camera looking at.  Don't change unless you are sure!!
-  glm::vec3 target (0, 0, 0);
-  // Up - Up vector defines tilt of camera.  Don't change unless you are sure!!
-  glm::vec3 up (0, 1, 0);
-
-  // Compute Camera matrix (view)
-  // Matrices.view = glm::lookAt( eye, target, up ); // Rotating Camera for 3D
-  //  Don't change unless you are sure!!
-Matrices.view = glm::lookAt(glm::vec3(camera_position,0,3), glm::vec3(camera_position,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
-
-  // Compute ViewProject matrix as view/camera might not be changed for this frame (basic scenario)
-  //  Don't change unless you are sure!!
-  glm::mat4 VP = Matrices.projection * Matrices.view;
-
-  // Send our transformation to the currently bound shader, in the "MVP" uniform
-  // For each model you render, since the MVP will be different (at least the M part)
-  //  Don't change unless you are sure!!
-  glm::mat4 MVP;	// MVP = Projection * View * Model
-  Matrices.model = glm::mat4(1.0f);
-	glm::mat4 translateCannonBall = glm::translate (glm::vec3(x_ball, y_ball,0));        // glTranslatef
-
-	Matrices.model *= translateCannonBall;
-	MVP = VP * Matrices.model;
-	glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-    // draw3DObject draws the VAO given to it using current MVP matrix
-    draw3DObject(cannon_ball);
-}
-
-void drawFloor(){  
+/* Clears the frame and draws the score line. The floor itself is part of
+ * the obstacle table, see createScene(). */
+void drawHud(){  
 	// clear the color and depth in the frame buffer
   glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	glUseProgram (programID);
-
-  // Eye - Location of camera. Don't change unless you are sure!!
-  glm::vec3 eye ( 5*cos(camera_rotation_angle*M_PI/180.0f), 0, 5*sin(camera_rotation_angle*M_PI/180.0f) );
-  // Target - Where is the camera looking at.  Don't change unless you are sure!!
-  glm::vec3 target (0, 0, 0);
-  // Up - Up vector defines tilt of camera.  Don't change unless you are sure!!
-  glm::vec3 up (0, 1, 0);
-
-  // Compute Camera matrix (view)
-  // Matrices.view = glm::lookAt( eye, target, up ); // Rotating Camera for 3D
-  //  Don't change unless you are sure!!
-  Matrices.view = glm::lookAt(glm::vec3(camera_position,0,3), glm::vec3(camera_position,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
-
-  // Compute ViewProject matrix as view/camera might not be changed for this frame (basic scenario)
-  //  Don't change unless you are sure!!
-  glm::mat4 VP = Matrices.projection * Matrices.view;
-
-    glm::mat4 MVP;	// MVP = Projection * View * Model
-
-   Matrices.model = glm::mat4(1.0f);
-
-	  glm::mat4 translateFloor = glm::translate (glm::vec3(0,-3.3,0));        // glTranslatef
-	  //glm::mat4 rotateRectangle = glm::rotate((float)(rectangle_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-	  Matrices.model *= (translateFloor);
- 	  MVP = VP * Matrices.model;
-	  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-	  // draw3DObject draws the VAO given to it using current MVP matrix
-	  draw3DObject(zameen);
+  glm::mat4 MVP;	// MVP = Projection * View * Model
 
 	  // Render font on screen
 	static int fontScale = 0;
@@ -1113,139 +993,27 @@ void drawFloor(){
 	// font size and color changes
 	//fontScale = (fontScale + 1) % 360;
 }
-void drawObs1(){
-
-  // use the loaded shader program
-  // Don't change unless you know what you are doing
-  glUseProgram (programID);
-
-  // Eye - Location of camera. Don't change unless you are sure!!
-  glm::vec3 eye ( 5*cos(camera_rotation_angle*M_PI/180.0f), 0, 5*sin(camera_rotation_angle*M_PI/180.0f) );
-  // Target - Where is the camera looking at.  Don't change unless you are sure!!
-  glm::vec3 target (0, 0, 0);
-  // Up - Up vector defines tilt of camera.  Don't change unless you are sure!!
-  glm::vec3 up (0, 1, 0);
-
-  // Compute Camera matrix (view)
-  // Matrices.view = glm::lookAt( eye, target, up ); // Rotating Camera for 3D
-  //  Don't change unless you are sure!!
-Matrices.view = glm::lookAt(glm::vec3(camera_position,0,3), glm::vec3(camera_position,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
-
-  // Compute ViewProject matrix as view/camera might not be changed for this frame (basic scenario)
-  //  Don't change unless you are sure!!
-  glm::mat4 VP = Matrices.projection * Matrices.view;
-
-  // Send our transformation to the currently bound shader, in the "MVP" uniform
-  // For each model you render, since the MVP will be different (at least the M part)
-  //  Don't change unless you are sure!!
-  glm::mat4 MVP;	// MVP = Projection * View * Model
-
-  Matrices.model = glm::mat4(1.0f);
-
-	  glm::mat4 translateFloor = glm::translate (glm::vec3(-1,-3,0));        // glTranslatef
-	  //glm::mat4 rotateRectangle = glm::rotate((float)(rectangle_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-	  Matrices.model *= (translateFloor);
- 	  MVP = VP * Matrices.model;
-	  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-	  // draw3DObject draws the VAO given to it using current MVP matrix
-	  draw3DObject(obs1);
-
-}
-
-void drawObs2_1(){
-
-	// use the loaded shader program
-	// Don't change unless you know what you are doing
-	glUseProgram (programID);
-
-	// Eye - Location of camera. Don't change unless you are sure!!
-	glm::vec3 eye ( 5*cos(camera_rotation_angle*M_PI/180.0f), 0, 5*sin(camera_rotation_angle*M_PI/180.0f) );
-	// Target - Where is the camera looking at.  Don't change unless you are sure!!
-	glm::vec3 target (0, 0, 0);
-	// Up - Up vector defines tilt of camera.  Don't change unless you are sure!!
-	glm::vec3 up (0, 1, 0);
-
-	// Compute Camera matrix (view)
-	// Matrices.view = glm::lookAt( eye, target, up ); // Rotating Camera for 3D
-	//  Don't change unless you are sure!!
-	Matrices.view = glm::lookAt(glm::vec3(camera_position,0,3), glm::vec3(camera_position,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
-
-	// Compute ViewProject matrix as view/camera might not be changed for this frame (basic scenario)
-	//  Don't change unless you are sure!!
-	glm::mat4 VP = Matrices.projection * Matrices.view;
-
-	// Send our transformation to the currently bound shader, in the "MVP" uniform
-	// For each model you render, since the MVP will be different (at least the M part)
-	//  Don't change unless you are sure!!
-	glm::mat4 MVP;	// MVP = Projection * View * Model
-
-	Matrices.model = glm::mat4(1.0f);
-
-	glm::mat4 translateObs2_1 = glm::translate (glm::vec3(-2.0f,-3.0f,0));        // glTranslatef
-	//glm::mat4 rotateRectangle = glm::rotate((float)(rectangle_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-	Matrices.model *= (translateObs2_1);
-	MVP = VP * Matrices.model;
-	glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-	// draw3DObject draws the VAO given to it using current MVP matrix
-	draw3DObject(obs2_1);
+/* The render system: every visible row with a mesh goes in a queue sorted
+ * by layer, and each one is drawn with its own model matrix. The meshes
+ * from the simulation are brought up to date first. */
+struct DrawItem {
+	int layer;
+	int archetype;
+	int row;
+};
 
+bool drawsBefore (const DrawItem& a, const DrawItem& b)
+{
+	return a.layer < b.layer;
 }
-void drawObs2_2(){
-
-	// use the loaded shader program
-	// Don't change unless you know what you are doing
-	glUseProgram (programID);
-
-	// Eye - Location of camera. Don't change unless you are sure!!
-	glm::vec3 eye ( 5*cos(camera_rotation_angle*M_PI/180.0f), 0, 5*sin(camera_rotation_angle*M_PI/180.0f) );
-	// Target - Where is the camera looking at.  Don't change unless you are sure!!
-	glm::vec3 target (0, 0, 0);
-	// Up - Up vector defines tilt of camera.  Don't change unless you are sure!!
-	glm::vec3 up (0, 1, 0);
 
-	// Compute Camera matrix (view)
-	// Matrices.view = glm::lookAt( eye, target, up ); // Rotating Camera for 3D
-	//  Don't change unless you are sure!!
-	Matrices.view = glm::lookAt(glm::vec3(camera_position,0,3), glm::vec3(camera_position,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
-
-	// Compute ViewProject matrix as view/camera might not be changed for this frame (basic scenario)
-	//  Don't change unless you are sure!!
-	glm::mat4 VP = Matrices.projection * Matrices.view;
-
-	// Send our transformation to the currently bound shader, in the "MVP" uniform
-	// For each model you render, since the MVP will be different (at least the M part)
-	//  Don't change unless you are sure!!
-	glm::mat4 MVP;	// MVP = Projection * View * Model
-
-	Matrices.model = glm::mat4(1.0f);
-
-	glm::mat4 translateObs2_2 = glm::translate (glm::vec3(1.0f,-3.0f,0));        // glTranslatef
-	//glm::mat4 rotateRectangle = glm::rotate((float)(rectangle_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-	Matrices.model *= (translateObs2_2);
-	MVP = VP * Matrices.model;
-	glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-	// draw3DObject draws the VAO given to it using current MVP matrix
-	draw3DObject(obs2_2);
-
-}
-void drawObs3(){
+void drawScene(){
 
 	// use the loaded shader program
 	// Don't change unless you know what you are doing
 	glUseProgram (programID);
 
-	// Eye - Location of camera. Don't change unless you are sure!!
-	glm::vec3 eye ( 5*cos(camera_rotation_angle*M_PI/180.0f), 0, 5*sin(camera_rotation_angle*M_PI/180.0f) );
-	// Target - Where is the camera looking at.  Don't change unless you are sure!!
-	glm::vec3 target (0, 0, 0);
-	// Up - Up vector defines tilt of camera.  Don't change unless you are sure!!
-	glm::vec3 up (0, 1, 0);
-
 	// Compute Camera matrix (view)
-	// Matrices.view = glm::lookAt( eye, target, up ); // Rotating Camera for 3D
 	//  Don't change unless you are sure!!
 	Matrices.view = glm::lookAt(glm::vec3(camera_position,0,3), glm::vec3(camera_position,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
 
@@ -1254,123 +1022,38 @@ void drawObs3(){
 	glm::mat4 VP = Matrices.projection * Matrices.view;
 
 	// Send our transformation to the currently bound shader, in the "MVP" uniform
-	// For each model you render, since the MVP will be different (at least the M part)
 	//  Don't change unless you are sure!!
 	glm::mat4 MVP;	// MVP = Projection * View * Model
 
-	Matrices.model = glm::mat4(1.0f);
+	updateMeshes();
 
-	glm::mat4 translateObs3 = glm::translate (glm::vec3(0,-3.0f,0));        // glTranslatef
-	//glm::mat4 rotateRectangle = glm::rotate((float)(rectangle_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-	Matrices.model *= (translateObs3);
-	MVP = VP * Matrices.model;
-	glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-	// draw3DObject draws the VAO given to it using current MVP matrix
-	draw3DObject(obs3);
-
-}
-void drawTarget1(){
-	// clear the color and depth in the frame buffer
-	//glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	// use the loaded shader program
-	// Don't change unless you know what you are doing
-	glUseProgram (programID);
-
-	// Eye - Location of camera. Don't change unless you are sure!!
-	glm::vec3 eye ( 5*cos(camera_rotation_angle*M_PI/180.0f), 0, 5*sin(camera_rotation_angle*M_PI/180.0f) );
-	// Target - Where is the camera looking at.  Don't change unless you are sure!!
-	glm::vec3 target (0, 0, 0);
-	// Up - Up vector defines tilt of camera.  Don't change unless you are sure!!
-	glm::vec3 up (0, 1, 0);
-
-	// Compute Camera matrix (view)
-	// Matrices.view = glm::lookAt( eye, target, up ); // Rotating Camera for 3D
-	//  Don't change unless you are sure!!
-	Matrices.view = glm::lookAt(glm::vec3(camera_position,0,3), glm::vec3(camera_position,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
-
-	// Compute ViewProject matrix as view/camera might not be changed for this frame (basic scenario)
-	//  Don't change unless you are sure!!
-	glm::mat4 VP = Matrices.projection * Matrices.view;
-
-	// Send our transformation to the currently bound shader, in the "MVP" uniform
-	// For each model you render, since the MVP will be different (at least the M part)
-	//  Don't change unless you are sure!!
-	glm::mat4 MVP;	// MVP = Projection * View * Model
-
-	if(!checkCollisionTarget(x_cannonball, y_cannonball, 1.5f, 2.5f, -3.0f, -2.0f) && Target_visible == 1)
+	static vector<DrawItem> queue;
+	queue.clear();
+	for(int k = 0; k < (int)scene.archetypes.size(); k++)
 	{
-		Matrices.model = glm::mat4(1.0f);
-
-		glm::mat4 translateTarget1 = glm::translate (glm::vec3(2,-3,0));        // glTranslatef
-		//glm::mat4 rote = glm::rotate((float)(rectangle_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-		Matrices.model *= (translateTarget1);
-		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-		// draw3DObject draws the VAO given to it using current MVP matrix
-		draw3DObject(rectangle1);
-
+		const Archetype& a = scene.archetypes[k];
+		if((a.mask & (COMPONENT_TRANSFORM | COMPONENT_MESH)) != (COMPONENT_TRANSFORM | COMPONENT_MESH))
+			continue;
+		for(int i = 0; i < a.count; i++)
+			if(a.visible[i] && a.mesh[i] >= 0)
+			{
+				DrawItem item = { a.layer[i], k, i };
+				queue.push_back(item);
+			}
 	}
-	//else if()
-	//{
-
-	//}
+	stable_sort(queue.begin(), queue.end(), drawsBefore);
 
-	else 
+	for(int q = 0; q < (int)queue.size(); q++)
 	{
-		Target_visible = 0;
-		//updatescore = 1;
-	}
-
-}
-void drawTarget2(){
-	// clear the color and depth in the frame buffer
-	//glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	// use the loaded shader program
-	// Don't change unless you know what you are doing
-	glUseProgram (programID);
-
-	// Eye - Location of camera. Don't change unless you are sure!!
-	glm::vec3 eye ( 5*cos(camera_rotation_angle*M_PI/180.0f), 0, 5*sin(camera_rotation_angle*M_PI/180.0f) );
-	// Target - Where is the camera looking at.  Don't change unless you are sure!!
-	glm::vec3 target (0, 0, 0);
-	// Up - Up vector defines tilt of camera.  Don't change unless you are sure!!
-	glm::vec3 up (0, 1, 0);
-
-	// Compute Camera matrix (view)
-	// Matrices.view = glm::lookAt( eye, target, up ); // Rotating Camera for 3D
-	//  Don't change unless you are sure!!
-	Matrices.view = glm::lookAt(glm::vec3(camera_position,0,3), glm::vec3(camera_position,0,0), glm::vec3(0,1,0)); // Fixed camera for 2D (ortho) in XY plane
-
-	// Compute ViewProject matrix as view/camera might not be changed for this frame (basic scenario)
-	//  Don't change unless you are sure!!
-	glm::mat4 VP = Matrices.projection * Matrices.view;
-
-	// Send our transformation to the currently bound shader, in the "MVP" uniform
-	// For each model you render, since the MVP will be different (at least the M part)
-	//  Don't change unless you are sure!!
-	glm::mat4 MVP;	// MVP = Projection * View * Model
-
-	if(!checkCollisionTarget(x_cannonball, y_cannonball, 1.6f, 2.4f, -2.0f, -1.0f) && Target_visible == 1)
-	{
-		Matrices.model = glm::mat4(1.0f);
-
-		glm::mat4 translateTarget1 = glm::translate (glm::vec3(2,-2,0));        // glTranslatef
-		//glm::mat4 rote = glm::rotate((float)(rectangle_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-		Matrices.model *= (translateTarget1);
+		const Archetype& a = scene.archetypes[queue[q].archetype];
+		int i = queue[q].row;
+		Matrices.model = glm::translate (glm::vec3(a.x[i], a.y[i], 0))        // glTranslatef
+		               * glm::rotate((float)(a.angle[i] * M_PI/180.0f), glm::vec3(0,0,1))
+		               * glm::scale (glm::vec3(a.scale[i], a.scale[i], 1));
 		MVP = VP * Matrices.model;
 		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
 		// draw3DObject draws the VAO given to it using current MVP matrix
-		draw3DObject(rectangle2);
-	}
-	else 
-	{
-		Target_visible = 0;
-		
+		draw3DObject(meshes[a.mesh[i]].vao);
 	}
 
 }
@@ -1429,16 +1112,7 @@ void initGL (GLFWwindow* window, int width, int height)
     /* Objects should be created before any other gl function and shaders */
 	// Create the models
 	//createTriangle (); // Generate the VAO, VBOs, vertices data & copy into the array buffer
-	CreateTarget1();
-	CreateTarget2();
-	createTrep();
-	createCannonCircle();
-	createCannonBall();
-	createFloor();
-	createObs1();
-	createObs2_1();
-	createObs2_2();
-	createObs3();
+	createScene();
 	// Create and compile our GLSL program from the shaders
 	programID = LoadShaders( "Sample_GL.vert", "Sample_GL.frag" );
 	// Get a handle for our "MVP" uniform
@@ -1488,6 +1162,18 @@ void initGL (GLFWwindow* window, int width, int height)
 
 int main (int argc, char** argv)
 {
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--headless") == 0)
+			return runHeadless(argc, argv);
+	}
+	parseSimulationArgs(argc, argv);
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--record") == 0)
+			record_file = fopen(argv[++i], "w");
+	}
+
 	int width = 1000;
 	int height = 1000;
 
@@ -1496,157 +1182,58 @@ int main (int argc, char** argv)
 	initGL (window, width, height);
 
     last_update_time = glfwGetTime();
-    ux = u * cos((float)((thita_ball)*M_PI/180.0f));
-		uy = u * sin((float)((thita_ball)*M_PI/180.0f));
-    vx = ux;
+    initBall();
+
+    // Physics runs in fixed steps of 1/physics_hz real seconds, decoupled from vsync
+    double physics_step = 1.0 / physics_hz;
+    double previous_time = glfwGetTime();
+    double accumulator = 0;
+    int ball_state = BALL_IDLE;
+    unsigned int log_cursor = sim_events.end();
+    unsigned int score_cursor = sim_events.end();
     /* Draw in loop */
     while (!glfwWindowShouldClose(window)) 
     {
-    	if(fl == 1)
+    	double now = glfwGetTime();
+    	double frame_time = now - previous_time;
+    	previous_time = now;
+    	if (frame_time > 0.25)
+    		frame_time = 0.25; // don't spiral after a long stall (window drag etc.)
+    	accumulator += frame_time;
+
+    	while (accumulator >= physics_step)
     	{
-    		//thita_ball = thita;
-    		vx *= sqrt(2)*cos((float)((thita_ball)*M_PI/180.0f));
-    		fl =0;
+    		updateBallPosition();
+    		ball_state = advanceBall();
+    		advanceEntities();
+    		advanceBodies();
+    		if (ball_state == BALL_RESTING)
+    		{
+    			// Nothing left to watch, the next shot can go right away
+    			resetBall();
+    			ball_state = BALL_RESET;
+    		}
+    		if (ball_state == BALL_RESET)
+    		{
+    			last_update_time = glfwGetTime();
+    			steps_since_reset = 0;
+    		}
+    		steps_since_reset++;
+    		accumulator -= physics_step;
     	}
-    	x_cannonball = x_till_collision + vx * (t-t_till_now); 
-		y_cannonball = y_till_collision + u * sin((float)((thita_ball)*M_PI/180.0f))*(t) - 0.5f*g*(t)*(t);
-		
-		//cout << "x till collision: " << x_till_collision << "\n";
-		///cout << "vx: " << vx << "\n";
-		///cout << "t: "<< t << "\n";
-		///cout << "x_till_collision: " << x_till_collision << "\n";
-		//cout << "t : " << t << "\n";
-		//cout << "ux : " << ux << "\n";
-		//cout << "u : " << u << "\n";
-    	//cout << "vy : " << vy << "\n";
-    	//cout << "uy : " << uy << "\n";	
-		///cout << "thita ball Before LOOP" << thita_ball << " thita: " << thita<< "\n";
-		
-		vy = uy - g*t;
-		v = sqrt(pow(vx,2)+pow(vy,2)); 
-		///cout << "v: " << v << "\n";
-		//beta = atan((float) (e * tan(alpha + delta)));
-		//***** cannon Ball *****// 
+
+    	scoreEvents(&score_cursor);
+    	SimEvent event;
+    	while (sim_events.read(&log_cursor, &event))
+    		if (log_collisions)
+    			printEvent(stdout, event);
+    	float alpha = (float)(accumulator / physics_step);
 
         // OpenGL Draw commands
-        drawFloor();
-        drawCannon();
-        drawTarget1();
-        drawTarget2();
-        drawObs1();
-        drawObs3();
-        drawObs2_1();
-        drawObs2_2();
-        CheckFloorCollisions(x_cannonball, y_cannonball,-6.0f,6.0f,-3.0f); //Floor
-						CheckFloorCollisions(x_cannonball, y_cannonball,-1.2f,-0.8f,-2.0f); //Obs1 ka top
-						CheckFloorCollisions(x_cannonball, y_cannonball,-2.2f,-1.8f,-2.25f); //Obs2_1
-						CheckFloorCollisions(x_cannonball, y_cannonball,0.8f,1.2f,-2.25f); //Obs2_2
-						CheckFloorCollisions(x_cannonball, y_cannonball,-0.2f,0.2f,-1.5f); //Obs3
-						if(checkCollisionObs(x_cannonball, y_cannonball,-1.2f,-0.8f,-3.0f,-2.0f,t)) //Obs1
-						{
-							///cout << "ping!!!\n";
-							///cout << "IN IF vx before: "<< vx << "\n";
-							vx = -1 * e * vx;
-							///cout << "e: "<< e << "\n";
-							///cout << "IN IF vx after: "<< vx << "\n";
-						}
-						if(checkCollisionObs(x_cannonball, y_cannonball,-2.2f,-1.8f,-3.0f,-2.25f,t)) //Obs2_1
-						{
-							///cout << "ping!!!\n";
-							///cout << "IN IF vx before: "<< vx << "\n";
-							vx = -1 * e * vx;
-							///cout << "e: "<< e << "\n";
-							///cout << "IN IF vx after: "<< vx << "\n";
-						}
-						if(checkCollisionObs(x_cannonball, y_cannonball,0.8f,1.2f,-3.0f,-2.25f,t)) //Obs2_2
-						{
-							///cout << "ping!!!\n";
-							///cout << "IN IF vx before: "<< vx << "\n";
-							vx = -1 * e * vx;
-							///cout << "e: "<< e << "\n";
-							///cout << "IN IF vx after: "<< vx << "\n";
-						}
-						if(checkCollisionObs(x_cannonball, y_cannonball,-0.2f,0.2f,-3.0f,-1.5f, t)) //Obs3
-						{
-							///cout << "ping!!!\n";
-							///cout << "IN IF vx before: "<< vx << "\n";
-							vx = -1 * e * vx;
-							///cout << "e: "<< e << "\n";
-							///cout << "IN IF vx after: "<< vx << "\n";
-						}
-		/*else
-		{
-			vx = ux;
-		}*/
-        if((fire == 1 || (in_air_flag == 1 && collision_flag == 0)) && (x_cannonball > -4.5f && x_cannonball < 4.5f))
-		{	
-			///cout<<"if\n";
-			///cout << "x_cannonball: "<< x_cannonball << "\n";
-			///cout << "thita ball (if):  " << thita_ball << " thita: " << thita << "\n";
-			
-			//cout << "if\n";
-			//cout << "fire flag value - "<<fire <<"\n";
-			//cout << "in_air_flag - " << in_air_flag << "\n";
-			//cout << "collision_flag - " << collision_flag << "\n";
-			drawCannonBall(x_cannonball,y_cannonball);
-  	
-    		//if(y_cannonball > -2.85f)
-    		t+=0.01;
-		}
-		else if(collision_flag == 1 && in_air_flag == 0)
-		{
-			///cout << "thita ball elif"<< thita_ball << " thita: " << thita<<"\n";
-			///cout << "obs_collision : " <<obs_collision << "\n";
-			//cout << "fire flag value - "<<fire <<"\n";
-			//cout << "in_air_flag - " << in_air_flag << "\n";
-			//cout << "collision_flag - " << collision_flag << "\n";
-	
-			in_air_flag = 1;
-			collision_flag = 0;
-			//x_till_collision += ((float)(v*v*sin(2*(float)((thita_ball+90)*M_PI/180.0f)) / g) + 0.1f); 
-			//x_till_collision *= 1.2f;
-			
-			//if(obs_collision == 1)
-			//{
-			//    thita_ball = (((float)(M_PI/2) + beta - delta) * (float)(180.0f / M_PI)) + 90;
-			//}
-			
-			if(obs_collision == 0)
-			{
-			
-				u *= e;
-				t = 0;	
-				y_cannonball = y_till_collision;
-			}
-			else
-			{
-				///cout << "ping3333!!!!!! \n";
-				t+=0.01;
-			}
-			///cout << "x_till_collision :" << x_till_collision << "\n";
-			///cout << " v - " << v << "\n";
-			///cout << "t - " << t << "\n";
-			///cout << "thita_ball : " << thita_ball << "\n";
-		}
+        updateScene(alpha, ball_state == BALL_FLYING);
+        drawHud();
+        drawScene();
 
-		if ((x_cannonball < -4.5f || x_cannonball > 4.5f))
-		{
-			///cout << "Thita ball (It Should stop now!!!!!!!!!!)"<< thita_ball << " thita: " << thita<<"\n" ;
-			in_air_flag = 0;
-			collision_flag = 0;
-			t = 0;
-			vx = ux;
-			x_till_collision = -3.0f;
-			y_till_collision = -2.75f;
-			fire = 0;
-			u = 4.0f;
-			last_update_time = glfwGetTime();
-		}
-		
-		///cout << "y_cannonball in int main:" << y_cannonball << "\n";
-		///cout << "thita ball after LOOP" << thita_ball << " thita: " << thita << "\n";
-        //drawObs1();
-        //drawTargets();
         // Swap Frame Buffer in double buffering
         glfwSwapBuffers(window);
 
@@ -1655,18 +1242,16 @@ int main (int argc, char** argv)
 
         // Control based on time (Time based transformation like 5 degrees rotation every 0.5s)
         current_time = glfwGetTime(); // Time in seconds
-        if ((current_time - last_update_time) >= 10)
+        // The deterministic mode counts the 10 seconds in physics steps so
+        // a replay times out on the same step
+        bool timed_out = deterministic ? steps_since_reset >= 10 * physics_hz : (current_time - last_update_time) >= 10;
+        if (timed_out)
         {  // atleast 0.5s elapsed since last frame
             // do something every 0.5 seconds ..
-            in_air_flag = 0;
-			collision_flag = 0;
-			t = 0;
-			vx = ux;
-			x_till_collision = -3.0f;
-			y_till_collision = -2.75f;
-			fire = 0;
-			u = 4.0f;
+            resetBall();
+            ball_state = BALL_IDLE;
             last_update_time = current_time;
+            steps_since_reset = 0;
         }
     }
 
@@ -0,0 +1,131 @@
+#include <cmath>
+
+#if !defined(SIM_DOUBLE) && (defined(__AVX2__) || defined(__SSE2__))
+#include <immintrin.h>
+#endif
+
+#include "impulse_batch.h"
+
+using namespace std;
+
+/* Arrays are padded to a multiple of this so kernels never need a tail loop */
+static const int LANES = 8;
+
+/* Padding bodies sit this far from the centre, where no blast reaches.
+ * Squared it still fits in a float. */
+static const real FAR = 1e18f;
+
+/* Distance below which a body counts as at the centre */
+static const real NEAR = 1e-6f;
+
+void ImpulseBatch::clear()
+{
+	count = 0;
+	body.clear();
+	dx.clear();
+	dy.clear();
+	inv_mass.clear();
+}
+
+int ImpulseBatch::add(int id, real x, real y, real m)
+{
+	int i = count;
+	if(count + 1 > (int)dx.size())
+	{
+		int padded = (count + LANES) / LANES * LANES;
+		body.resize(padded, -1);
+		dx.resize(padded, FAR);
+		dy.resize(padded, FAR);
+		inv_mass.resize(padded, 0);
+	}
+	count++;
+	body[i] = id;
+	dx[i] = x;
+	dy[i] = y;
+	inv_mass[i] = m;
+	return i;
+}
+
+/* Linear falloff with the distance from the centre. The vector kernels do
+ * the same operations in the same order, so every build gets the same
+ * pushes. */
+void ImpulseBatch::radialScalar(real radius, real peak)
+{
+	int n = (int)dx.size();
+	impulse.resize(n);
+	dvx.resize(n);
+	dvy.resize(n);
+	real inv_r = 1 / radius;
+	for(int i = 0; i < n; i++)
+	{
+		real d = sqrt(dx[i] * dx[i] + dy[i] * dy[i]);
+		real f = 1 - d * inv_r;
+		f = f > 0 ? f : 0;
+		real j = peak * f;
+		real k = j / (d > NEAR ? d : NEAR) * inv_mass[i];
+		impulse[i] = j;
+		dvx[i] = k * dx[i];
+		dvy[i] = k * dy[i];
+	}
+}
+
+#if !defined(SIM_DOUBLE) && defined(__AVX2__)
+
+const char* impulseKernelName() { return "avx2"; }
+
+void ImpulseBatch::radial(real radius, real peak)
+{
+	int n = (int)dx.size();
+	impulse.resize(n);
+	dvx.resize(n);
+	dvy.resize(n);
+	const __m256 one = _mm256_set1_ps(1), zero = _mm256_setzero_ps(), near = _mm256_set1_ps(NEAR);
+	const __m256 inv_r = _mm256_set1_ps(1 / radius), vpeak = _mm256_set1_ps(peak);
+	for(int i = 0; i < n; i += LANES)
+	{
+		__m256 x = _mm256_loadu_ps(&dx[i]), y = _mm256_loadu_ps(&dy[i]);
+		__m256 d = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)));
+		__m256 f = _mm256_max_ps(_mm256_sub_ps(one, _mm256_mul_ps(d, inv_r)), zero);
+		__m256 j = _mm256_mul_ps(vpeak, f);
+		__m256 k = _mm256_mul_ps(_mm256_div_ps(j, _mm256_max_ps(d, near)), _mm256_loadu_ps(&inv_mass[i]));
+		_mm256_storeu_ps(&impulse[i], j);
+		_mm256_storeu_ps(&dvx[i], _mm256_mul_ps(k, x));
+		_mm256_storeu_ps(&dvy[i], _mm256_mul_ps(k, y));
+	}
+}
+
+#elif !defined(SIM_DOUBLE) && defined(__SSE2__)
+
+const char* impulseKernelName() { return "sse"; }
+
+void ImpulseBatch::radial(real radius, real peak)
+{
+	int n = (int)dx.size();
+	impulse.resize(n);
+	dvx.resize(n);
+	dvy.resize(n);
+	const __m128 one = _mm_set1_ps(1), zero = _mm_setzero_ps(), near = _mm_set1_ps(NEAR);
+	const __m128 inv_r = _mm_set1_ps(1 / radius), vpeak = _mm_set1_ps(peak);
+	for(int i = 0; i < n; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&dx[i]), y = _mm_loadu_ps(&dy[i]);
+		__m128 d = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)));
+		__m128 f = _mm_max_ps(_mm_sub_ps(one, _mm_mul_ps(d, inv_r)), zero);
+		__m128 j = _mm_mul_ps(vpeak, f);
+		__m128 k = _mm_mul_ps(_mm_div_ps(j, _mm_max_ps(d, near)), _mm_loadu_ps(&inv_mass[i]));
+		_mm_storeu_ps(&impulse[i], j);
+		_mm_storeu_ps(&dvx[i], _mm_mul_ps(k, x));
+		_mm_storeu_ps(&dvy[i], _mm_mul_ps(k, y));
+	}
+}
+
+#else
+
+const char* impulseKernelName() { return "scalar"; }
+
+void ImpulseBatch::radial(real radius, real peak)
+{
+	radialScalar(radius, peak);
+}
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef IMPULSE_BATCH_H
+#define IMPULSE_BATCH_H
+
+#include <vector>
+
+#include "real.h"
+
+/* The bodies a blast reaches, stored as one array per field in blocks of
+ * 8, so the push each one gets is worked out 8 bodies per instruction with
+ * AVX2, 4 with SSE (float builds only). rigid_world fills it with what one
+ * query of its tree found and applies the result. Padding bodies sit far
+ * outside any blast and get nothing. */
+class ImpulseBatch {
+public:
+	std::vector<int> body;        // caller's id, -1 for padding
+	std::vector<real> dx, dy;     // from the centre of the blast to the body
+	std::vector<real> inv_mass;   // 0 for padding
+	std::vector<real> dvx, dvy;   // velocity change, set by radial()
+	std::vector<real> impulse;    // size of the push, set by radial()
+
+	int size() const { return count; }
+	void clear();
+	/* Adds a body at (dx, dy) from the centre, returns its index */
+	int add(int id, real dx, real dy, real inv_mass);
+
+	/* A push away from the centre of peak at the centre falling off to 0
+	 * at radius, on every body: sets impulse, dvx and dvy. A body right at
+	 * the centre takes the impulse without being moved. */
+	void radial(real radius, real peak);
+	/* Plain loop version of radial(), used to check the vector kernels */
+	void radialScalar(real radius, real peak);
+
+private:
+	int count;
+
+public:
+	ImpulseBatch() : count(0) {}
+};
+
+/* Name of the kernel radial() was compiled with: "avx2", "sse" or "scalar" */
+const char* impulseKernelName();
+
+#endif
@@ -0,0 +1,208 @@
+#include <cmath>
+#include <cstring>
+
+#include "integrator.h"
+#include "detmath.h"
+
+template<typename T>
+FlightParamsT<T> defaultFlightParams(T g)
+{
+	FlightParamsT<T> fp;
+	fp.g = g;
+	fp.drag = 0;
+	fp.wind_x = 0;
+	fp.wind_y = 0;
+	fp.gust = 0;
+	fp.gust_freq = 0.5f;
+	fp.gust_length = 0;
+	fp.strict_math = 0;
+	return fp;
+}
+
+template<typename T>
+void windAt(const FlightParamsT<T>& fp, T x, T time, T* wx, T* wy)
+{
+	T phase = 2 * M_PI * fp.gust_freq * time;
+	if(fp.gust_length > 0)
+		phase -= 2 * M_PI * x / fp.gust_length;
+	if(fp.strict_math)
+	{
+		double s, c;
+		detSinCos(phase, &s, &c);
+		*wx = fp.wind_x + fp.gust * (T)s;
+	}
+	else
+		*wx = fp.wind_x + fp.gust * sin(phase);
+	*wy = fp.wind_y;
+}
+
+template<typename T>
+void flightAccel(const FlightParamsT<T>& fp, T time, const BodyStateT<T>& s, T* ax, T* ay)
+{
+	*ax = 0;
+	*ay = -fp.g;
+	if(fp.drag == 0)
+		return;
+	T wx, wy;
+	windAt(fp, s.x, time, &wx, &wy);
+	T rx = s.vx - wx, ry = s.vy - wy;
+	T speed = sqrt(rx*rx + ry*ry);
+	*ax -= fp.drag * speed * rx;
+	*ay -= fp.drag * speed * ry;
+}
+
+/* Derivative of the state */
+template<typename T>
+static BodyStateT<T> deriv(const FlightParamsT<T>& fp, T time, const BodyStateT<T>& s)
+{
+	BodyStateT<T> d;
+	d.x = s.vx;
+	d.y = s.vy;
+	flightAccel(fp, time, s, &d.vx, &d.vy);
+	return d;
+}
+
+/* s + h * (sum of c[i] * k[i]) */
+template<typename T>
+static BodyStateT<T> combine(const BodyStateT<T>& s, T h, const BodyStateT<T>* k, const double* c, int n)
+{
+	BodyStateT<T> r = s;
+	for(int i = 0; i < n; i++)
+	{
+		if(c[i] == 0)
+			continue;
+		r.x += h * T(c[i]) * k[i].x;
+		r.y += h * T(c[i]) * k[i].y;
+		r.vx += h * T(c[i]) * k[i].vx;
+		r.vy += h * T(c[i]) * k[i].vy;
+	}
+	return r;
+}
+
+template<typename T>
+BodyStateT<T> stepEuler(const FlightParamsT<T>& fp, T time, const BodyStateT<T>& s, T h)
+{
+	T ax, ay;
+	flightAccel(fp, time, s, &ax, &ay);
+	BodyStateT<T> r;
+	r.vx = s.vx + h * ax;
+	r.vy = s.vy + h * ay;
+	r.x = s.x + h * r.vx;
+	r.y = s.y + h * r.vy;
+	return r;
+}
+
+template<typename T>
+BodyStateT<T> stepRK4(const FlightParamsT<T>& fp, T time, const BodyStateT<T>& s, T h)
+{
+	static const double half[1] = { 0.5 };
+	static const double one[1] = { 1.0 };
+	static const double weights[4] = { 1/6.0, 2/6.0, 2/6.0, 1/6.0 };
+	BodyStateT<T> k[4];
+	k[0] = deriv(fp, time, s);
+	k[1] = deriv(fp, time + 0.5f*h, combine(s, h, &k[0], half, 1));
+	k[2] = deriv(fp, time + 0.5f*h, combine(s, h, &k[1], half, 1));
+	k[3] = deriv(fp, time + h, combine(s, h, &k[2], one, 1));
+	return combine(s, h, k, weights, 4);
+}
+
+/* Dormand-Prince 5(4) tableau */
+static const double dp_c[7] = { 0, 1/5.0, 3/10.0, 4/5.0, 8/9.0, 1, 1 };
+static const double dp_a[7][6] = {
+	{ 0 },
+	{ 1/5.0 },
+	{ 3/40.0, 9/40.0 },
+	{ 44/45.0, -56/15.0, 32/9.0 },
+	{ 19372/6561.0, -25360/2187.0, 64448/6561.0, -212/729.0 },
+	{ 9017/3168.0, -355/33.0, 46732/5247.0, 49/176.0, -5103/18656.0 },
+	{ 35/384.0, 0, 500/1113.0, 125/192.0, -2187/6784.0, 11/84.0 },
+};
+static const double dp_b5[7] = { 35/384.0, 0, 500/1113.0, 125/192.0, -2187/6784.0, 11/84.0, 0 };
+static const double dp_b4[7] = { 5179/57600.0, 0, 7571/16695.0, 393/640.0, -92097/339200.0, 187/2100.0, 1/40.0 };
+
+template<typename T>
+BodyStateT<T> stepRK45(const FlightParamsT<T>& fp, T time, const BodyStateT<T>& s, T h, T* err)
+{
+	BodyStateT<T> k[7];
+	k[0] = deriv(fp, time, s);
+	for(int i = 1; i < 7; i++)
+		k[i] = deriv(fp, time + T(dp_c[i])*h, combine(s, h, k, dp_a[i], i));
+
+	BodyStateT<T> hi = combine(s, h, k, dp_b5, 7);
+	BodyStateT<T> lo = combine(s, h, k, dp_b4, 7);
+	T ex = hi.x - lo.x, ey = hi.y - lo.y;
+	*err = sqrt(ex*ex + ey*ey);
+	return hi;
+}
+
+template<typename T>
+T integrateStep(int integrator, const FlightParamsT<T>& fp, T time, BodyStateT<T>& s, T h, T tol, T* h_next)
+{
+	if(integrator == INTEGRATOR_EULER)
+	{
+		s = stepEuler(fp, time, s, h);
+		*h_next = h;
+		return h;
+	}
+	if(integrator == INTEGRATOR_RK4)
+	{
+		s = stepRK4(fp, time, s, h);
+		*h_next = h;
+		return h;
+	}
+
+	const T h_min = 1e-6f;
+	while(1)
+	{
+		T err;
+		BodyStateT<T> r = stepRK45(fp, time, s, h, &err);
+		// Standard controller: scale by (tol / err)^(1/5) with safety margins.
+		// The strict one only halves or doubles, no libm involved.
+		T scale;
+		if(fp.strict_math)
+			scale = err > tol ? 0.5f : (err < tol / 32 ? 2.0f : 1.0f);
+		else
+			scale = err > 0 ? 0.9f * pow(tol / err, 0.2f) : 5.0f;
+		if(scale > 5.0f) scale = 5.0f;
+		if(scale < 0.2f) scale = 0.2f;
+		if(err <= tol || h <= h_min)
+		{
+			s = r;
+			*h_next = h * scale;
+			return h;
+		}
+		h *= scale;
+		if(h < h_min)
+			h = h_min;
+	}
+}
+
+static const char* integrator_names[] = { "euler", "rk4", "rk45" };
+
+const char* integratorName(int integrator)
+{
+	return integrator_names[integrator];
+}
+
+int integratorFromName(const char* name)
+{
+	for(int i = 0; i < 3; i++)
+		if(strcmp(name, integrator_names[i]) == 0)
+			return i;
+	return -1;
+}
+
+template FlightParamsT<float> defaultFlightParams<float>(float);
+template FlightParamsT<double> defaultFlightParams<double>(double);
+template void windAt<float>(const FlightParamsT<float>&, float, float, float*, float*);
+template void windAt<double>(const FlightParamsT<double>&, double, double, double*, double*);
+template void flightAccel<float>(const FlightParamsT<float>&, float, const BodyStateT<float>&, float*, float*);
+template void flightAccel<double>(const FlightParamsT<double>&, double, const BodyStateT<double>&, double*, double*);
+template BodyStateT<float> stepEuler<float>(const FlightParamsT<float>&, float, const BodyStateT<float>&, float);
+template BodyStateT<double> stepEuler<double>(const FlightParamsT<double>&, double, const BodyStateT<double>&, double);
+template BodyStateT<float> stepRK4<float>(const FlightParamsT<float>&, float, const BodyStateT<float>&, float);
+template BodyStateT<double> stepRK4<double>(const FlightParamsT<double>&, double, const BodyStateT<double>&, double);
+template BodyStateT<float> stepRK45<float>(const FlightParamsT<float>&, float, const BodyStateT<float>&, float, float*);
+template BodyStateT<double> stepRK45<double>(const FlightParamsT<double>&, double, const BodyStateT<double>&, double, double*);
+template float integrateStep<float>(int, const FlightParamsT<float>&, float, BodyStateT<float>&, float, float, float*);
+template double integrateStep<double>(int, const FlightParamsT<double>&, double, BodyStateT<double>&, double, double, double*);
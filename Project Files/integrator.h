@@ -0,0 +1,65 @@
+#ifndef INTEGRATOR_H
+#define INTEGRATOR_H
+
+#include "real.h"
+
+/* Numerical integration of the ball when the closed-form parabola is not
+ * enough, i.e. with air drag and wind. No game state in here. Templated
+ * over the scalar type like collision.h. */
+
+#define INTEGRATOR_EULER 0   // semi-implicit (symplectic) Euler
+#define INTEGRATOR_RK4 1     // classic 4th order Runge-Kutta
+#define INTEGRATOR_RK45 2    // Dormand-Prince 5(4) with error-controlled step
+
+template<typename T>
+struct BodyStateT {
+	T x;
+	T y;
+	T vx;
+	T vy;
+};
+typedef BodyStateT<real> BodyState;
+
+template<typename T>
+struct FlightParamsT {
+	T g;
+	T drag;              // quadratic drag, acceleration = -drag * |v - w| * (v - w)
+	T wind_x;            // steady wind
+	T wind_y;
+	T gust;              // amplitude of the gusts added to wind_x
+	T gust_freq;         // gusts per second
+	T gust_length;       // distance along x between gust crests, 0 for uniform
+	int strict_math;     // detmath sine and a pow() free step controller
+};
+typedef FlightParamsT<real> FlightParams;
+
+template<typename T>
+FlightParamsT<T> defaultFlightParams(T g);
+
+/* Wind velocity at x at the given time, the same at every height */
+template<typename T>
+void windAt(const FlightParamsT<T>& fp, T x, T time, T* wx, T* wy);
+
+/* Acceleration of the ball: gravity plus drag relative to the wind */
+template<typename T>
+void flightAccel(const FlightParamsT<T>& fp, T time, const BodyStateT<T>& s, T* ax, T* ay);
+
+template<typename T>
+BodyStateT<T> stepEuler(const FlightParamsT<T>& fp, T time, const BodyStateT<T>& s, T h);
+template<typename T>
+BodyStateT<T> stepRK4(const FlightParamsT<T>& fp, T time, const BodyStateT<T>& s, T h);
+/* One Dormand-Prince step. *err is the estimated local position error. */
+template<typename T>
+BodyStateT<T> stepRK45(const FlightParamsT<T>& fp, T time, const BodyStateT<T>& s, T h, T* err);
+
+/* Advances s by at most h with the chosen integrator and returns the time
+ * actually taken. RK45 shrinks the step until the error is below tol and
+ * stores a suggestion for the next step in *h_next; the others always take
+ * the full h. */
+template<typename T>
+T integrateStep(int integrator, const FlightParamsT<T>& fp, T time, BodyStateT<T>& s, T h, T tol, T* h_next);
+
+const char* integratorName(int integrator);
+int integratorFromName(const char* name);
+
+#endif
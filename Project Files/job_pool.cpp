@@ -0,0 +1,140 @@
+#include "job_pool.h"
+
+using namespace std;
+
+JobPool job_pool(0);
+
+JobPool::JobPool(int threads) : wanted(threads), count(0), ranges(0), generation(0), stop(0), job(0), context(0), pending(0)
+{
+}
+
+JobPool::~JobPool()
+{
+	stopThreads();
+}
+
+void JobPool::start()
+{
+	count = wanted > 0 ? wanted : (int)thread::hardware_concurrency();
+	if(count < 1)
+		count = 1;
+	ranges = new JobRange[count];
+	for(int i = 0; i < count; i++)
+		ranges[i].jobs.store(0, memory_order_relaxed);
+	for(int i = 1; i < count; i++)
+		workers.push_back(thread(&JobPool::work, this, i));
+}
+
+void JobPool::stopThreads()
+{
+	{
+		lock_guard<mutex> hold(wake_lock);
+		stop = 1;
+	}
+	wake.notify_all();
+	for(int i = 0; i < (int)workers.size(); i++)
+		workers[i].join();
+	workers.clear();
+	delete[] ranges;
+	ranges = 0;
+	count = 0;
+	stop = 0;
+}
+
+int JobPool::threads()
+{
+	if(count == 0)
+		start();
+	return count;
+}
+
+void JobPool::resize(int n)
+{
+	stopThreads();
+	wanted = n;
+}
+
+/* Next job for thread self: the front of its own range, so it runs its
+ * share in order, else the back of the first other range with any left */
+int JobPool::take(int self, int* index)
+{
+	for(int k = 0; k < count; k++)
+	{
+		atomic<unsigned long long>& r = ranges[(self + k) % count].jobs;
+		unsigned long long jobs = r.load(memory_order_acquire);
+		for(;;)
+		{
+			unsigned int first = (unsigned int)(jobs >> 32), end = (unsigned int)jobs;
+			if(first >= end)
+				break;
+			unsigned long long left = k == 0 ? jobs + (1ull << 32) : jobs - 1;
+			if(r.compare_exchange_weak(jobs, left, memory_order_acquire, memory_order_acquire))
+			{
+				*index = k == 0 ? first : end - 1;
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+void JobPool::drain(int self)
+{
+	int index;
+	while(take(self, &index))
+	{
+		job(context, index);
+		if(pending.fetch_sub(1, memory_order_acq_rel) == 1)
+		{
+			lock_guard<mutex> hold(done_lock);
+			done.notify_one();
+		}
+	}
+}
+
+void JobPool::work(int self)
+{
+	unsigned int seen = 0;
+	for(;;)
+	{
+		{
+			unique_lock<mutex> hold(wake_lock);
+			while(!stop && generation == seen)
+				wake.wait(hold);
+			if(stop)
+				return;
+			seen = generation;
+		}
+		drain(self);
+	}
+}
+
+void JobPool::run(int n, void (*fn)(void* context, int index), void* ctx)
+{
+	if(n < threads() || threads() == 1)
+	{
+		for(int i = 0; i < n; i++)
+			fn(ctx, i);
+		return;
+	}
+	// Set before the ranges: a thread only reads them after taking a job
+	// out of a range, which acquires what the release below publishes
+	job = fn;
+	context = ctx;
+	pending.store(n, memory_order_relaxed);
+	for(int t = 0; t < count; t++)
+	{
+		unsigned long long first = (unsigned long long)n * t / count, end = (unsigned long long)n * (t + 1) / count;
+		ranges[t].jobs.store(first << 32 | end, memory_order_release);
+	}
+	{
+		lock_guard<mutex> hold(wake_lock);
+		generation++;
+	}
+	wake.notify_all();
+	drain(0);
+	// Jobs taken by other threads may still be running
+	unique_lock<mutex> hold(done_lock);
+	while(pending.load(memory_order_acquire) > 0)
+		done.wait(hold);
+}
@@ -0,0 +1,67 @@
+#ifndef JOB_POOL_H
+#define JOB_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Threads that run numbered jobs: run() hands every thread an equal,
+ * contiguous range of the job numbers, and a thread whose range is empty
+ * takes from the far end of another's (work stealing), so a few long jobs
+ * don't leave the other threads idle. The calling thread works too. A
+ * range is just its first and last job packed in one atomic word, so a run
+ * neither locks nor allocates. Jobs must not depend on the order they run
+ * in; whoever calls run() gathers their results in job order afterwards,
+ * which keeps the outcome the same for any number of threads. */
+
+struct JobRange {
+	std::atomic<unsigned long long> jobs; // first job << 32 | end
+	char pad[64 - sizeof(std::atomic<unsigned long long>)]; // a cache line each
+};
+
+class JobPool {
+public:
+	/* Calls job(context, i) for every i in [0, count) and returns once all
+	 * of them are done; on the calling thread alone if there are fewer
+	 * jobs than threads */
+	void run(int count, void (*job)(void* context, int index), void* context);
+	/* Number of threads jobs run on, the caller included; starts them the
+	 * first time */
+	int threads();
+	/* Stops the threads; the next run() starts n of them, one per core if
+	 * n <= 0 */
+	void resize(int n);
+
+private:
+	int wanted;
+	int count;                       // threads started, 0 before the first run()
+	JobRange* ranges;                // one per thread, the caller's first
+	std::vector<std::thread> workers;
+	std::mutex wake_lock;
+	std::condition_variable wake;
+	unsigned int generation;         // runs started, under wake_lock
+	int stop;                        // under wake_lock
+	void (*job)(void*, int);
+	void* context;
+	std::atomic<int> pending;        // jobs of this run not finished
+	std::mutex done_lock;
+	std::condition_variable done;    // pending reached 0
+
+	void start();
+	void stopThreads();
+	int take(int self, int* index);
+	void drain(int self);
+	void work(int self);
+
+public:
+	/* threads as for resize() */
+	JobPool(int threads);
+	~JobPool();
+};
+
+/* The pool the physics runs on */
+extern JobPool job_pool;
+
+#endif
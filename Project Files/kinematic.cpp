@@ -0,0 +1,119 @@
+#include <cmath>
+
+#include "kinematic.h"
+#include "obstacles.h"
+#include "rigid_world.h"
+#include "detmath.h"
+
+using namespace std;
+
+vector<Kinematic> kinematics;
+double kinematic_time = 0;
+
+/* Blocks found by the last wake query */
+static vector<int> in_the_way;
+
+static int addKinematic(Kinematic& k, int obstacle, int type, real period, real phase)
+{
+	const Box& b = obstacles[obstacle].box;
+	k.obstacle = obstacle;
+	k.type = type;
+	k.period = period;
+	k.phase = phase;
+	k.hw = (b.xmax - b.xmin) / 2;
+	k.hh = (b.ymax - b.ymin) / 2;
+	k.cx = (b.xmin + b.xmax) / 2;
+	k.cy = (b.ymin + b.ymax) / 2;
+	setKinematic(obstacle);
+	kinematics.push_back(k);
+	return (int)kinematics.size() - 1;
+}
+
+int addOscillation(int obstacle, real ax, real ay, real period, real phase)
+{
+	Kinematic k = Kinematic();
+	k.ax = ax;
+	k.ay = ay;
+	return addKinematic(k, obstacle, PATH_OSCILLATE, period, phase);
+}
+
+int addSplinePath(int obstacle, const real* x, const real* y, int count, real period)
+{
+	Kinematic k = Kinematic();
+	k.key_x.assign(x, x + count);
+	k.key_y.assign(y, y + count);
+	return addKinematic(k, obstacle, PATH_SPLINE, period, 0);
+}
+
+void clearKinematics()
+{
+	kinematics.clear();
+	kinematic_time = 0;
+}
+
+/* The sine comes from detmath, so a path is in the same place on every
+ * machine */
+void kinematicCentre(const Kinematic& k, double time, real* x, real* y)
+{
+	double f = fmod(time / k.period + k.phase, 1.0);
+	if(f < 0)
+		f += 1;
+	if(k.type == PATH_OSCILLATE)
+	{
+		double s, c;
+		detSinCos(2 * M_PI * f, &s, &c);
+		*x = k.cx + k.ax * (real)s;
+		*y = k.cy + k.ay * (real)s;
+		return;
+	}
+	int n = (int)k.key_x.size();
+	double u = f * n;
+	int i = (int)u < n ? (int)u : n - 1;
+	real t = (real)(u - i), t2 = t * t, t3 = t2 * t;
+	int i0 = (i + n - 1) % n, i2 = (i + 1) % n, i3 = (i + 2) % n;
+	const real* px = &k.key_x[0];
+	const real* py = &k.key_y[0];
+	*x = 0.5f * (2 * px[i] + (px[i2] - px[i0]) * t + (2 * px[i0] - 5 * px[i] + 4 * px[i2] - px[i3]) * t2
+	           + (3 * px[i] - px[i0] - 3 * px[i2] + px[i3]) * t3);
+	*y = 0.5f * (2 * py[i] + (py[i2] - py[i0]) * t + (2 * py[i0] - 5 * py[i] + 4 * py[i2] - py[i3]) * t2
+	           + (3 * py[i] - py[i0] - 3 * py[i2] + py[i3]) * t3);
+}
+
+/* Puts the box of k where its path is now, with the velocity that takes
+ * it to its place dt later, and wakes the blocks it moves into */
+static void placeKinematic(const Kinematic& k, real dt)
+{
+	Obstacle& o = obstacles[k.obstacle];
+	if(o.state != OBSTACLE_KINEMATIC)
+		return;
+	real x0, y0, x1, y1;
+	kinematicCentre(k, kinematic_time, &x0, &y0);
+	kinematicCentre(k, kinematic_time + dt, &x1, &y1);
+	Box b = { x0 - k.hw, x0 + k.hw, y0 - k.hh, y0 + k.hh };
+	moveObstacle(k.obstacle, b);
+	o.vx = dt > 0 ? (x1 - x0) / dt : 0;
+	o.vy = dt > 0 ? (y1 - y0) / dt : 0;
+	if((o.vx == 0 && o.vy == 0) || rigid_world.size() == 0)
+		return;
+	Box reach = { b.xmin + (x1 < x0 ? x1 - x0 : 0), b.xmax + (x1 > x0 ? x1 - x0 : 0),
+	              b.ymin + (y1 < y0 ? y1 - y0 : 0), b.ymax + (y1 > y0 ? y1 - y0 : 0) };
+	rigid_world.query(reach, in_the_way);
+	for(int q = 0; q < (int)in_the_way.size(); q++)
+		rigid_world.wake(in_the_way[q]);
+}
+
+void advanceKinematics(real dt)
+{
+	if(kinematics.empty())
+		return;
+	kinematic_time += dt;
+	for(int k = 0; k < (int)kinematics.size(); k++)
+		placeKinematic(kinematics[k], dt);
+}
+
+void resetKinematics(real dt)
+{
+	kinematic_time = 0;
+	for(int k = 0; k < (int)kinematics.size(); k++)
+		placeKinematic(kinematics[k], dt);
+}
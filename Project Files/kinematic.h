@@ -0,0 +1,53 @@
+#ifndef KINEMATIC_H
+#define KINEMATIC_H
+
+#include <vector>
+
+#include "real.h"
+
+/* Boxes of the level that move along a path of their own, whatever hits
+ * them: platforms swinging back and forth and boxes following keyframes.
+ * Every step each one is put where its path is at the start of the step
+ * and given the velocity that takes it to where the path is at the end,
+ * so within a step it moves in a straight line. The ball is swept against
+ * it in its own frame, where it stands still (simulation.cpp), and the
+ * blocks of rigid_world see its velocity at their contacts, so neither
+ * goes through a fast one. It stays in the obstacle table, in the tree of
+ * moving boxes (obstacles.h). No OpenGL in here. */
+
+/* Kinematic::type */
+#define PATH_OSCILLATE 0   // centre + amplitude * sin(2 pi (time / period + phase))
+#define PATH_SPLINE 1      // Catmull-Rom loop through the keys
+
+struct Kinematic {
+	int obstacle;       // index in obstacles
+	int type;
+	real period;        // seconds per loop
+	real phase;         // share of the period it starts at
+	real hw, hh;        // half size of the box
+	real cx, cy;        // centre of an oscillation
+	real ax, ay;        // its amplitude
+	std::vector<real> key_x, key_y; // centres a spline goes through, equally spaced in time
+};
+
+extern std::vector<Kinematic> kinematics;
+extern double kinematic_time; // seconds the paths have run, double so long games keep their precision
+
+/* Makes box obstacle of the level swing by (ax, ay) around where it is now
+ * once every period seconds. Returns the index of the kinematic. */
+int addOscillation(int obstacle, real ax, real ay, real period, real phase);
+/* Makes box obstacle loop through count centres (x, y) every period seconds */
+int addSplinePath(int obstacle, const real* x, const real* y, int count, real period);
+void clearKinematics();
+
+/* Centre of k at time */
+void kinematicCentre(const Kinematic& k, double time, real* x, real* y);
+
+/* Runs the paths on by dt: every box goes where its path is now, with the
+ * velocity that takes it to its place dt later, and wakes the blocks of
+ * rigid_world in its way */
+void advanceKinematics(real dt);
+/* Puts the paths back at time 0, about to move by dt */
+void resetKinematics(real dt);
+
+#endif
@@ -0,0 +1,528 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#include "obstacles.h"
+#include "aabb_tree.h"
+#include "box_batch.h"
+#include "targets.h"
+#include "rigid_world.h"
+#include "kinematic.h"
+
+using namespace std;
+
+/* Mass per unit area of the blocks of a level file */
+static const real BLOCK_DENSITY = 5.0f;
+
+/* The original level: floor first, then the obstacles, with the bounds the
+ * old sampled collision checks used */
+static const Obstacle default_level[] = {
+	{ { -6.0f,  6.0f, -4.0f, -3.0f  }, { 0.0f, 0.51f, 0.0f } }, // Floor
+	{ { -1.2f, -0.8f, -3.0f, -2.0f  }, { 0.4f, 0.6f,  0.6f } }, // Obs1
+	{ { -2.2f, -1.8f, -3.0f, -2.25f }, { 0.4f, 0.6f,  0.6f } }, // Obs2_1
+	{ {  0.8f,  1.2f, -3.0f, -2.25f }, { 0.4f, 0.6f,  0.6f } }, // Obs2_2
+	{ { -0.2f,  0.2f, -3.0f, -1.5f  }, { 0.4f, 0.6f,  0.6f } }, // Obs3
+};
+
+vector<Obstacle> obstacles(default_level, default_level + sizeof(default_level) / sizeof(default_level[0]));
+real grid_cell = 1.0f;
+int obstacle_version = 0;
+
+/* The boxes of bucket b are grid_boxes[bucket_start[b] .. bucket_start[b+1]),
+ * each bucket padded to a whole block of the BoxBatch kernel */
+static vector<int> bucket_start;
+static BoxBatch grid_boxes;
+static unsigned int bucket_mask = 0;
+static int grid_dirty = 1;
+static vector<unsigned int> query_stamp; // last query that looked at each box
+static unsigned int query_count = 0;
+static AabbTree moving;             // boxes that moved at least once
+static vector<int> moved_since;     // boxes that left their fat box since the last findObstaclePairs()
+static vector<int> tree_hits;
+
+static int cellOf(real x)
+{
+	return (int)floor(x / grid_cell);
+}
+
+static unsigned int cellHash(int cx, int cy)
+{
+	return ((unsigned int)cx * 73856093u ^ (unsigned int)cy * 19349663u) & bucket_mask;
+}
+
+int addObstacle(real xmin, real xmax, real ymin, real ymax, float red, float green, float blue)
+{
+	Obstacle o = { { xmin, xmax, ymin, ymax }, { red, green, blue }, OBSTACLE_STATIC, -1 };
+	obstacles.push_back(o);
+	grid_dirty = 1;
+	obstacle_version++;
+	return (int)obstacles.size() - 1;
+}
+
+/* A block or circle line of a level file, added to rigid_world once the
+ * file is read */
+struct LevelBlock {
+	Box box;
+	float color[3];
+	int shape;      // SHAPE_*
+	float strength; // 0 if it doesn't break
+};
+
+/* A path line of a level file, added once the level is in place */
+struct LevelPath {
+	int type;       // PATH_*
+	int box;
+	float period, phase, ax, ay;
+	vector<real> x, y;
+	int line_no;
+};
+
+/* A joint line of a level file, added once the blocks exist */
+struct LevelJoint {
+	int type;       // JOINT_*
+	int a, b;
+	float p[5];     // points, then the length of a rope
+	int line_no;
+};
+
+int loadLevel(const char* path)
+{
+	FILE* f = fopen(path, "r");
+	if(!f)
+	{
+		fprintf(stderr, "Can't open level `%s'\n", path);
+		return 0;
+	}
+	vector<Obstacle> level;
+	vector<Target> level_targets;
+	vector<LevelBlock> blocks;
+	vector<LevelJoint> level_joints;
+	vector<LevelPath> level_paths;
+	char line[256];
+	int line_no = 0;
+	while(fgets(line, sizeof(line), f))
+	{
+		line_no++;
+		float b[4];
+		float c[3] = { 0.4f, 0.6f, 0.6f };
+		float strength = 0;
+		int points = 5;
+		if(strncmp(line, "block", 5) == 0)
+		{
+			if(sscanf(line + 5, "%f %f %f %f %f %f %f %f", &b[0], &b[1], &b[2], &b[3], &c[0], &c[1], &c[2], &strength) < 4)
+			{
+				fprintf(stderr, "%s:%d: expected \"block xmin xmax ymin ymax [r g b [strength]]\"\n", path, line_no);
+				fclose(f);
+				return 0;
+			}
+			LevelBlock k = { { b[0], b[1], b[2], b[3] }, { c[0], c[1], c[2] }, SHAPE_BOX, strength };
+			blocks.push_back(k);
+			continue;
+		}
+		if(strncmp(line, "circle", 6) == 0)
+		{
+			if(sscanf(line + 6, "%f %f %f %f %f %f %f", &b[0], &b[1], &b[2], &c[0], &c[1], &c[2], &strength) < 3)
+			{
+				fprintf(stderr, "%s:%d: expected \"circle x y radius [r g b [strength]]\"\n", path, line_no);
+				fclose(f);
+				return 0;
+			}
+			LevelBlock k = { { b[0] - b[2], b[0] + b[2], b[1] - b[2], b[1] + b[2] }, { c[0], c[1], c[2] }, SHAPE_CIRCLE, strength };
+			blocks.push_back(k);
+			continue;
+		}
+		if(strncmp(line, "hinge", 5) == 0 || strncmp(line, "rod", 3) == 0 || strncmp(line, "rope", 4) == 0)
+		{
+			LevelJoint j = { JOINT_REVOLUTE, -1, -1, { 0, 0, 0, 0, 0 }, line_no };
+			int n;
+			if(line[0] == 'h')
+				n = sscanf(line + 5, "%d %d %f %f", &j.a, &j.b, &j.p[0], &j.p[1]) - 4;
+			else
+			{
+				j.type = line[2] == 'd' ? JOINT_DISTANCE : JOINT_ROPE;
+				n = sscanf(line + 4, "%d %d %f %f %f %f %f", &j.a, &j.b, &j.p[0], &j.p[1], &j.p[2], &j.p[3], &j.p[4]) - 6;
+			}
+			if(n < 0)
+			{
+				fprintf(stderr, "%s:%d: expected \"hinge a b x y\", \"rod a b ax ay bx by\" or \"rope a b ax ay bx by [length]\"\n", path, line_no);
+				fclose(f);
+				return 0;
+			}
+			level_joints.push_back(j);
+			continue;
+		}
+		if(strncmp(line, "oscillate", 9) == 0)
+		{
+			LevelPath p = { PATH_OSCILLATE, -1, 0, 0, 0, 0, vector<real>(), vector<real>(), line_no };
+			if(sscanf(line + 9, "%d %f %f %f %f", &p.box, &p.ax, &p.ay, &p.period, &p.phase) < 4 || p.period <= 0)
+			{
+				fprintf(stderr, "%s:%d: expected \"oscillate box ax ay period [phase]\"\n", path, line_no);
+				fclose(f);
+				return 0;
+			}
+			level_paths.push_back(p);
+			continue;
+		}
+		if(strncmp(line, "path", 4) == 0)
+		{
+			LevelPath p = { PATH_SPLINE, -1, 0, 0, 0, 0, vector<real>(), vector<real>(), line_no };
+			int used = 0;
+			int ok = sscanf(line + 4, "%d %f%n", &p.box, &p.period, &used) == 2 && p.period > 0;
+			const char* rest = line + 4 + used;
+			float kx, ky;
+			int n;
+			while(ok && sscanf(rest, "%f %f%n", &kx, &ky, &n) == 2)
+			{
+				p.x.push_back(kx);
+				p.y.push_back(ky);
+				rest += n;
+			}
+			if(!ok || p.x.size() < 2)
+			{
+				fprintf(stderr, "%s:%d: expected \"path box period x y x y ...\"\n", path, line_no);
+				fclose(f);
+				return 0;
+			}
+			level_paths.push_back(p);
+			continue;
+		}
+		if(strncmp(line, "target", 6) == 0)
+		{
+			if(sscanf(line + 6, "%f %f %f %f %d", &b[0], &b[1], &b[2], &b[3], &points) < 4)
+			{
+				fprintf(stderr, "%s:%d: expected \"target xmin xmax ymin ymax [points]\"\n", path, line_no);
+				fclose(f);
+				return 0;
+			}
+			Target tg = { { b[0], b[1], b[2], b[3] }, 1, -1, points };
+			level_targets.push_back(tg);
+			continue;
+		}
+		int n = sscanf(line, "%f %f %f %f %f %f %f", &b[0], &b[1], &b[2], &b[3], &c[0], &c[1], &c[2]);
+		if(n <= 0)
+			continue; // blank or comment
+		if(n != 4 && n != 7)
+		{
+			fprintf(stderr, "%s:%d: expected \"xmin xmax ymin ymax [r g b]\"\n", path, line_no);
+			fclose(f);
+			return 0;
+		}
+		Obstacle o = { { b[0], b[1], b[2], b[3] }, { c[0], c[1], c[2] }, OBSTACLE_STATIC, -1 };
+		level.push_back(o);
+	}
+	fclose(f);
+	for(int i = 0; i < (int)level_joints.size(); i++)
+	{
+		const LevelJoint& j = level_joints[i];
+		if(j.a < 0 || j.a >= (int)blocks.size() || j.b < -1 || j.b >= (int)blocks.size() || j.a == j.b)
+		{
+			fprintf(stderr, "%s:%d: no blocks %d and %d to join\n", path, j.line_no, j.a, j.b);
+			return 0;
+		}
+	}
+	for(int i = 0; i < (int)level_paths.size(); i++)
+		if(level_paths[i].box < 0 || level_paths[i].box >= (int)level.size())
+		{
+			fprintf(stderr, "%s:%d: no box %d to move\n", path, level_paths[i].line_no, level_paths[i].box);
+			return 0;
+		}
+	obstacles.swap(level);
+	rigid_world.clear();
+	for(int i = 0; i < (int)blocks.size(); i++)
+	{
+		const Box& b = blocks[i].box;
+		const float* c = blocks[i].color;
+		int k;
+		if(blocks[i].shape == SHAPE_CIRCLE)
+			k = rigid_world.addCircle((b.xmin + b.xmax) / 2, (b.ymin + b.ymax) / 2, (b.xmax - b.xmin) / 2, BLOCK_DENSITY, c[0], c[1], c[2]);
+		else
+			k = rigid_world.addBox((b.xmin + b.xmax) / 2, (b.ymin + b.ymax) / 2, b.xmax - b.xmin, b.ymax - b.ymin, 0, BLOCK_DENSITY, c[0], c[1], c[2]);
+		if(blocks[i].strength > 0)
+			rigid_world.setStrength(k, blocks[i].strength);
+	}
+	for(int i = 0; i < (int)level_joints.size(); i++)
+	{
+		const LevelJoint& j = level_joints[i];
+		if(j.type == JOINT_REVOLUTE)
+			rigid_world.addRevoluteJoint(j.a, j.b, j.p[0], j.p[1]);
+		else if(j.type == JOINT_DISTANCE)
+			rigid_world.addDistanceJoint(j.a, j.b, j.p[0], j.p[1], j.p[2], j.p[3]);
+		else
+			rigid_world.addRopeJoint(j.a, j.b, j.p[0], j.p[1], j.p[2], j.p[3], j.p[4]);
+	}
+	if(!level_targets.empty())
+	{
+		clearTargets();
+		for(int i = 0; i < (int)level_targets.size(); i++)
+			addTarget(level_targets[i].box.xmin, level_targets[i].box.xmax, level_targets[i].box.ymin, level_targets[i].box.ymax, level_targets[i].points);
+	}
+	moving.clear();
+	moved_since.clear();
+	grid_dirty = 1;
+	obstacle_version++;
+	clearKinematics();
+	for(int i = 0; i < (int)level_paths.size(); i++)
+	{
+		const LevelPath& p = level_paths[i];
+		if(p.type == PATH_OSCILLATE)
+			addOscillation(p.box, p.ax, p.ay, p.period, p.phase);
+		else
+			addSplinePath(p.box, &p.x[0], &p.y[0], (int)p.x.size(), p.period);
+	}
+	return 1;
+}
+
+void moveObstacle(int i, const Box& box)
+{
+	Obstacle& o = obstacles[i];
+	if(o.state == OBSTACLE_REMOVED)
+		return;
+	if(o.state == OBSTACLE_STATIC)
+	{
+		// Its grid entries stay behind and are skipped from now on
+		o.state = OBSTACLE_MOVING;
+		o.leaf = moving.insert(box, i);
+		moved_since.push_back(i);
+	}
+	else
+	{
+		real dx = (box.xmin + box.xmax - o.box.xmin - o.box.xmax) / 2;
+		real dy = (box.ymin + box.ymax - o.box.ymin - o.box.ymax) / 2;
+		if(moving.move(o.leaf, box, dx, dy))
+			moved_since.push_back(i);
+	}
+	o.box = box;
+	if(o.state != OBSTACLE_KINEMATIC)
+		obstacle_version++;
+}
+
+void setKinematic(int i)
+{
+	moveObstacle(i, obstacles[i].box);
+	obstacles[i].state = OBSTACLE_KINEMATIC;
+}
+
+void removeObstacle(int i)
+{
+	Obstacle& o = obstacles[i];
+	if(o.state == OBSTACLE_MOVING || o.state == OBSTACLE_KINEMATIC)
+		moving.remove(o.leaf);
+	o.state = OBSTACLE_REMOVED;
+	o.leaf = -1;
+	obstacle_version++;
+}
+
+Box levelBounds()
+{
+	static int version = -1;
+	static Box bounds;
+	if(version == obstacle_version)
+		return bounds;
+	version = obstacle_version;
+	bounds.xmin = bounds.ymin = 1e30f;
+	bounds.xmax = bounds.ymax = -1e30f;
+	for(int i = 0; i < (int)obstacles.size(); i++)
+	{
+		const Box& b = obstacles[i].box;
+		if(obstacles[i].state == OBSTACLE_REMOVED)
+			continue;
+		if(b.xmin < bounds.xmin) bounds.xmin = b.xmin;
+		if(b.xmax > bounds.xmax) bounds.xmax = b.xmax;
+		if(b.ymin < bounds.ymin) bounds.ymin = b.ymin;
+		if(b.ymax > bounds.ymax) bounds.ymax = b.ymax;
+	}
+	return bounds;
+}
+
+void buildObstacleGrid()
+{
+	int n = (int)obstacles.size();
+
+	// Size the table for about one cell entry per bucket
+	long entries = 0;
+	for(int i = 0; i < n; i++)
+	{
+		if(obstacles[i].state != OBSTACLE_STATIC)
+			continue;
+		const Box& b = obstacles[i].box;
+		entries += (long)(cellOf(b.xmax) - cellOf(b.xmin) + 1) * (cellOf(b.ymax) - cellOf(b.ymin) + 1);
+	}
+	unsigned int buckets = 16;
+	while(buckets < entries)
+		buckets *= 2;
+	bucket_mask = buckets - 1;
+
+	// Counting sort of the cell entries by bucket, in box order
+	vector<int> bucket_items(entries);
+	bucket_start.assign(buckets + 1, 0);
+	for(int i = 0; i < n; i++)
+	{
+		if(obstacles[i].state != OBSTACLE_STATIC)
+			continue;
+		const Box& b = obstacles[i].box;
+		for(int cy = cellOf(b.ymin); cy <= cellOf(b.ymax); cy++)
+			for(int cx = cellOf(b.xmin); cx <= cellOf(b.xmax); cx++)
+				bucket_start[cellHash(cx, cy) + 1]++;
+	}
+	for(unsigned int k = 0; k < buckets; k++)
+		bucket_start[k + 1] += bucket_start[k];
+	vector<int> cursor(bucket_start.begin(), bucket_start.end() - 1);
+	for(int i = 0; i < n; i++)
+	{
+		if(obstacles[i].state != OBSTACLE_STATIC)
+			continue;
+		const Box& b = obstacles[i].box;
+		for(int cy = cellOf(b.ymin); cy <= cellOf(b.ymax); cy++)
+			for(int cx = cellOf(b.xmin); cx <= cellOf(b.xmax); cx++)
+				bucket_items[cursor[cellHash(cx, cy)]++] = i;
+	}
+
+	// Copy them into blocks for the kernel
+	grid_boxes.clear();
+	for(unsigned int k = 0; k < buckets; k++)
+	{
+		int first = bucket_start[k], last = bucket_start[k + 1];
+		bucket_start[k] = grid_boxes.size();
+		for(int j = first; j < last; j++)
+			grid_boxes.add(obstacles[bucket_items[j]].box, bucket_items[j]);
+		grid_boxes.pad();
+	}
+	bucket_start[buckets] = grid_boxes.size();
+
+	query_stamp.assign(n, 0);
+	query_count = 0;
+	grid_dirty = 0;
+}
+
+static bool overlaps(const Box& a, const Box& b)
+{
+	return a.xmin <= b.xmax && a.xmax >= b.xmin && a.ymin <= b.ymax && a.ymax >= b.ymin;
+}
+
+/* Static boxes overlapping region, appended to out in no particular order */
+static void queryGrid(const Box& region, vector<int>& out)
+{
+	int cx0 = cellOf(region.xmin), cx1 = cellOf(region.xmax);
+	int cy0 = cellOf(region.ymin), cy1 = cellOf(region.ymax);
+	if((double)(cx1 - cx0 + 1) * (cy1 - cy0 + 1) > bucket_mask + 1)
+	{
+		// Covers more cells than there are buckets, just test every box
+		for(int i = 0; i < (int)obstacles.size(); i++)
+			if(obstacles[i].state == OBSTACLE_STATIC && overlaps(obstacles[i].box, region))
+				out.push_back(i);
+		return;
+	}
+
+	// A box spanning several cells, or sharing a bucket with another
+	// cell, is seen more than once; the stamp reports it only once
+	if(++query_count == 0)
+	{
+		fill(query_stamp.begin(), query_stamp.end(), 0);
+		query_count = 1;
+	}
+	for(int cy = cy0; cy <= cy1; cy++)
+		for(int cx = cx0; cx <= cx1; cx++)
+		{
+			unsigned int k = cellHash(cx, cy);
+			for(int j = bucket_start[k]; j < bucket_start[k + 1]; j++)
+			{
+				int i = grid_boxes.item[j];
+				if(i < 0 || query_stamp[i] == query_count)
+					continue;
+				query_stamp[i] = query_count;
+				if(obstacles[i].state == OBSTACLE_STATIC && overlaps(obstacles[i].box, region))
+					out.push_back(i);
+			}
+		}
+}
+
+int queryObstacles(const Box& region, vector<int>& out)
+{
+	if(grid_dirty)
+		buildObstacleGrid();
+	out.clear();
+	queryGrid(region, out);
+	if(moving.size() > 0)
+	{
+		moving.query(region, tree_hits);
+		for(int k = 0; k < (int)tree_hits.size(); k++)
+			if(overlaps(obstacles[tree_hits[k]].box, region))
+				out.push_back(tree_hits[k]);
+	}
+	// Same order as a scan of the whole table, so ties between boxes
+	// resolve the same way
+	sort(out.begin(), out.end());
+	return (int)out.size();
+}
+
+int sweepObstacles(real x0, real y0, real dx, real dy, real r, vector<int>& out)
+{
+	if(grid_dirty)
+		buildObstacleGrid();
+	out.clear();
+	Box region = { x0 + (dx < 0 ? dx : 0) - r, x0 + (dx > 0 ? dx : 0) + r,
+	               y0 + (dy < 0 ? dy : 0) - r, y0 + (dy > 0 ? dy : 0) + r };
+
+	int cx0 = cellOf(region.xmin), cx1 = cellOf(region.xmax);
+	int cy0 = cellOf(region.ymin), cy1 = cellOf(region.ymax);
+	if((double)(cx1 - cx0 + 1) * (cy1 - cy0 + 1) > bucket_mask + 1)
+		queryGrid(region, out);
+	else
+	{
+		if(++query_count == 0)
+		{
+			fill(query_stamp.begin(), query_stamp.end(), 0);
+			query_count = 1;
+		}
+		for(int cy = cy0; cy <= cy1; cy++)
+			for(int cx = cx0; cx <= cx1; cx++)
+			{
+				unsigned int k = cellHash(cx, cy);
+				int begin = bucket_start[k], end = bucket_start[k + 1];
+				if(begin == end || grid_boxes.sweepCircle(x0, y0, dx, dy, r, begin, end) == 0)
+					continue;
+				for(int j = begin; j < end; j++)
+				{
+					if(!(grid_boxes.hits[(j - begin) >> 5] >> ((j - begin) & 31) & 1))
+						continue;
+					int i = grid_boxes.item[j];
+					if(query_stamp[i] == query_count)
+						continue;
+					query_stamp[i] = query_count;
+					if(obstacles[i].state == OBSTACLE_STATIC)
+						out.push_back(i);
+				}
+			}
+	}
+	if(moving.size() > 0)
+	{
+		moving.query(region, tree_hits);
+		for(int k = 0; k < (int)tree_hits.size(); k++)
+			if(overlaps(obstacles[tree_hits[k]].box, region))
+				out.push_back(tree_hits[k]);
+	}
+	sort(out.begin(), out.end());
+	return (int)out.size();
+}
+
+int findObstaclePairs(vector<pair<int, int> >& pairs)
+{
+	if(grid_dirty)
+		buildObstacleGrid();
+	moving.findPairs(pairs);
+	for(int k = 0; k < (int)moved_since.size(); k++)
+	{
+		int i = moved_since[k];
+		if(obstacles[i].state != OBSTACLE_MOVING && obstacles[i].state != OBSTACLE_KINEMATIC)
+			continue;
+		tree_hits.clear();
+		queryGrid(moving.nodes[obstacles[i].leaf].box, tree_hits);
+		for(int j = 0; j < (int)tree_hits.size(); j++)
+			pairs.push_back(tree_hits[j] < i ? make_pair(tree_hits[j], i) : make_pair(i, tree_hits[j]));
+	}
+	moved_since.clear();
+	sort(pairs.begin(), pairs.end());
+	pairs.erase(unique(pairs.begin(), pairs.end()), pairs.end());
+	return (int)pairs.size();
+}
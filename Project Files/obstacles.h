@@ -0,0 +1,83 @@
+#ifndef OBSTACLES_H
+#define OBSTACLES_H
+
+#include <vector>
+
+#include "collision.h"
+
+/* The level: every solid box the ball can hit, floor included. The physics
+ * collides with these boxes and the game draws the same boxes, so there is
+ * one copy of the geometry. Static boxes are indexed by a uniform grid whose
+ * cells are hashed into buckets, so a query only looks at the boxes sharing
+ * a cell with it whatever the size of the level. A box that moves leaves
+ * the grid for a dynamic AABB tree. No OpenGL in here. */
+
+/* Obstacle::state */
+#define OBSTACLE_STATIC 0
+#define OBSTACLE_MOVING 1
+#define OBSTACLE_REMOVED 2
+#define OBSTACLE_KINEMATIC 3   // moved along a path every step (kinematic.h), in the tree
+
+struct Obstacle {
+	Box box;
+	float color[3];
+	int state;
+	int leaf;      // its leaf in the tree while OBSTACLE_MOVING or OBSTACLE_KINEMATIC
+	real vx, vy;   // velocity of a kinematic box over the current step, 0 for the others
+};
+
+extern std::vector<Obstacle> obstacles;
+extern real grid_cell;     // side of a grid cell, rebuild the grid after changing it
+extern int obstacle_version; // changes whenever a box is added, moved or removed
+
+/* Adds a box to the level and returns its index */
+int addObstacle(real xmin, real xmax, real ymin, real ymax, float red, float green, float blue);
+
+/* Replaces the level with the boxes in a text file, one per line as
+ * "xmin xmax ymin ymax [r g b]", # starts a comment. Lines
+ * "block xmin xmax ymin ymax [r g b [strength]]" and
+ * "circle x y radius [r g b [strength]]" are blocks that can be knocked
+ * over (rigid_world.h), shattered by an impulse of strength if it is given
+ * (fracture.h). Lines "hinge a b x y",
+ * "rod a b ax ay bx by" and "rope a b ax ay bx by [length]" join blocks a
+ * and b, counted from 0 in the order of the file, at those points; b = -1
+ * joins a to the world. Lines "oscillate i ax ay period [phase]" and
+ * "path i period x y x y ..." move box i of the file (counted from 0
+ * among the plain boxes) back and forth by (ax, ay), or through the
+ * centres (x, y) in a loop (kinematic.h). Lines
+ * "target xmin xmax ymin ymax [points]" replace the targets (targets.h),
+ * which stay as they are if the file has none. Returns 0 and keeps the
+ * old level if the file can't be read. */
+int loadLevel(const char* path);
+
+/* Moves box i to a new place; from then on it lives in the tree */
+void moveObstacle(int i, const Box& box);
+/* Makes box i kinematic: it moves into the tree, and moving it again
+ * doesn't change obstacle_version since the game draws kinematic boxes on
+ * their own every frame */
+void setKinematic(int i);
+/* Takes box i out of the level (broken). Indices of the others don't change. */
+void removeObstacle(int i);
+
+/* Box around every box still in the level */
+Box levelBounds();
+
+/* Rebuilds the grid. Queries do it on their own after the level changed. */
+void buildObstacleGrid();
+
+/* Indices of the boxes overlapping region, ascending, in out. Returns how many. */
+int queryObstacles(const Box& region, std::vector<int>& out);
+
+/* Boxes a circle of radius r moving in a straight line from (x0, y0) by
+ * (dx, dy) may touch, ascending, in out. Each grid cell is tested 8 boxes
+ * at a time with BoxBatch::sweepCircle(), so a superset of the boxes
+ * touched (square corners). Returns how many. */
+int sweepObstacles(real x0, real y0, real dx, real dy, real r, std::vector<int>& out);
+
+/* Pairs of boxes (smaller index first, sorted) that may have started to
+ * touch: every moving box that left its fat box since the last call against
+ * the moving and the static ones. Pairs found earlier are not repeated
+ * while both stay inside their fat boxes. */
+int findObstaclePairs(std::vector<std::pair<int, int> >& pairs);
+
+#endif
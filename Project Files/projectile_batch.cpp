@@ -0,0 +1,269 @@
+#include <cmath>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "projectile_batch.h"
+
+/* Arrays are padded to a multiple of this so kernels never need a tail loop */
+static const int LANES = 8;
+
+void ProjectileBatch::resize(int n)
+{
+	int padded = (n + LANES - 1) / LANES * LANES;
+	x.resize(padded, 0.0f);
+	y.resize(padded, 0.0f);
+	vx.resize(padded, 0.0f);
+	vy.resize(padded, 0.0f);
+	uy.resize(padded, 0.0f);
+	t.resize(padded, 0.0f);
+	t_till_now.resize(padded, 0.0f);
+	x_till_collision.resize(padded, 0.0f);
+	y_till_collision.resize(padded, 0.0f);
+	alive.resize(padded, 0.0f);
+}
+
+void ProjectileBatch::reserve(int n)
+{
+	if(n > (int)x.size())
+		resize(n);
+}
+
+void ProjectileBatch::clear()
+{
+	count = 0;
+	x.clear();
+	y.clear();
+	vx.clear();
+	vy.clear();
+	uy.clear();
+	t.clear();
+	t_till_now.clear();
+	x_till_collision.clear();
+	y_till_collision.clear();
+	alive.clear();
+}
+
+int ProjectileBatch::add(float x0, float y0, float vx0, float vy0, float t0)
+{
+	int i = count;
+	if(count + 1 > (int)x.size())
+		resize(count + 1 > 2 * (int)x.size() ? count + 1 : 2 * (int)x.size());
+	count++;
+	restart(i, x0, y0, vx0, vy0, t0);
+	return i;
+}
+
+void ProjectileBatch::restart(int i, float x0, float y0, float vx0, float vy0, float t0)
+{
+	x[i] = x0;
+	y[i] = y0;
+	vx[i] = vx0;
+	vy[i] = vy0;
+	uy[i] = vy0;
+	t[i] = t0;
+	t_till_now[i] = 0;
+	x_till_collision[i] = x0;
+	y_till_collision[i] = y0;
+	alive[i] = 1.0f;
+}
+
+/* One ball at a time, the reference the vector kernels have to match.
+ * A floor contact is the impulse of applyContactImpulse() for the normal
+ * (0, 1); a resting contact also loses mu * g * dt of speed to sliding. */
+int ProjectileBatch::stepScalar(float dt, float g, float e, float mu, float rest_speed)
+{
+	float slide_dv = mu * g * dt;
+	int n = (int)x.size();
+	int live = 0;
+	for(int i = 0; i < n; i++)
+	{
+		float px = x_till_collision[i] + vx[i] * (t[i] - t_till_now[i]);
+		float py = y_till_collision[i] + uy[i] * t[i] - 0.5f * g * t[i] * t[i];
+		float pvy = uy[i] - g * t[i];
+		x[i] = px;
+		y[i] = py;
+		vy[i] = pvy;
+
+		if(alive[i] == 0.0f)
+			continue;
+		if(py <= floor_top && pvy < 0)
+		{
+			float closing = -pvy;
+			int bounce = closing >= rest_speed;
+			float fr = bounce ? mu * (1 + e) * closing : mu * closing + slide_dv;
+			float speed = fabs(vx[i]) - fr;
+			if(speed < 0)
+				speed = 0;
+			vx[i] = vx[i] < 0 ? -speed : speed;
+			x_till_collision[i] = px;
+			y_till_collision[i] = floor_top;
+			t_till_now[i] = 0;
+			uy[i] = bounce ? e * closing : 0.0f;
+			t[i] = dt;
+			if(!bounce && speed == 0)
+			{
+				alive[i] = 0.0f;
+				continue;
+			}
+		}
+		else
+			t[i] += dt;
+		if(px < xmin || px > xmax)
+			alive[i] = 0.0f;
+		else
+			live++;
+	}
+	return live;
+}
+
+#if defined(__AVX2__)
+
+const char* projectileKernelName() { return "avx2"; }
+
+int ProjectileBatch::step(float dt, float g, float e, float mu, float rest_speed)
+{
+	const __m256 vdt = _mm256_set1_ps(dt);
+	const __m256 vg = _mm256_set1_ps(g);
+	const __m256 vhalf_g = _mm256_set1_ps(0.5f * g);
+	const __m256 ve = _mm256_set1_ps(e);
+	const __m256 vmu = _mm256_set1_ps(mu);
+	const __m256 one_e = _mm256_set1_ps(1 + e);
+	const __m256 vrest = _mm256_set1_ps(rest_speed);
+	const __m256 slide_dv = _mm256_set1_ps(mu * g * dt);
+	const __m256 sign = _mm256_set1_ps(-0.0f);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 vfloor = _mm256_set1_ps(floor_top);
+	const __m256 vxmin = _mm256_set1_ps(xmin);
+	const __m256 vxmax = _mm256_set1_ps(xmax);
+
+	int n = (int)x.size();
+	int live = 0;
+	for(int i = 0; i < n; i += 8)
+	{
+		__m256 ti = _mm256_loadu_ps(&t[i]);
+		__m256 uyi = _mm256_loadu_ps(&uy[i]);
+		__m256 vxi = _mm256_loadu_ps(&vx[i]);
+		__m256 xt = _mm256_loadu_ps(&x_till_collision[i]);
+		__m256 yt = _mm256_loadu_ps(&y_till_collision[i]);
+		__m256 t0 = _mm256_loadu_ps(&t_till_now[i]);
+		__m256 al = _mm256_loadu_ps(&alive[i]);
+
+		__m256 px = _mm256_add_ps(xt, _mm256_mul_ps(vxi, _mm256_sub_ps(ti, t0)));
+		__m256 py = _mm256_sub_ps(_mm256_add_ps(yt, _mm256_mul_ps(uyi, ti)), _mm256_mul_ps(_mm256_mul_ps(vhalf_g, ti), ti));
+		__m256 pvy = _mm256_sub_ps(uyi, _mm256_mul_ps(vg, ti));
+		_mm256_storeu_ps(&x[i], px);
+		_mm256_storeu_ps(&y[i], py);
+		_mm256_storeu_ps(&vy[i], pvy);
+
+		__m256 live_mask = _mm256_cmp_ps(al, zero, _CMP_NEQ_OQ);
+		__m256 hit = _mm256_and_ps(live_mask, _mm256_and_ps(_mm256_cmp_ps(py, vfloor, _CMP_LE_OQ), _mm256_cmp_ps(pvy, zero, _CMP_LT_OQ)));
+
+		// Floor impulse, see stepScalar()
+		__m256 closing = _mm256_sub_ps(zero, pvy);
+		__m256 bounce = _mm256_cmp_ps(closing, vrest, _CMP_GE_OQ);
+		__m256 fr = _mm256_blendv_ps(_mm256_add_ps(_mm256_mul_ps(vmu, closing), slide_dv),
+		                             _mm256_mul_ps(_mm256_mul_ps(vmu, one_e), closing), bounce);
+		__m256 speed = _mm256_max_ps(_mm256_sub_ps(_mm256_andnot_ps(sign, vxi), fr), zero);
+		__m256 new_vx = _mm256_or_ps(speed, _mm256_and_ps(sign, vxi));
+		__m256 rest = _mm256_and_ps(hit, _mm256_andnot_ps(bounce, _mm256_cmp_ps(speed, zero, _CMP_EQ_OQ)));
+
+		_mm256_storeu_ps(&vx[i], _mm256_blendv_ps(vxi, new_vx, hit));
+		_mm256_storeu_ps(&x_till_collision[i], _mm256_blendv_ps(xt, px, hit));
+		_mm256_storeu_ps(&y_till_collision[i], _mm256_blendv_ps(yt, vfloor, hit));
+		_mm256_storeu_ps(&t_till_now[i], _mm256_blendv_ps(t0, zero, hit));
+		_mm256_storeu_ps(&uy[i], _mm256_blendv_ps(uyi, _mm256_and_ps(bounce, _mm256_mul_ps(ve, closing)), hit));
+		__m256 advanced = _mm256_add_ps(ti, _mm256_and_ps(live_mask, vdt));
+		_mm256_storeu_ps(&t[i], _mm256_blendv_ps(advanced, vdt, hit));
+
+		__m256 out = _mm256_or_ps(rest, _mm256_or_ps(_mm256_cmp_ps(px, vxmin, _CMP_LT_OQ), _mm256_cmp_ps(px, vxmax, _CMP_GT_OQ)));
+		__m256 still = _mm256_andnot_ps(out, live_mask);
+		_mm256_storeu_ps(&alive[i], _mm256_blendv_ps(al, zero, _mm256_and_ps(live_mask, out)));
+		live += __builtin_popcount(_mm256_movemask_ps(still));
+	}
+	return live;
+}
+
+#elif defined(__SSE2__)
+
+const char* projectileKernelName() { return "sse"; }
+
+static inline __m128 select4(__m128 a, __m128 b, __m128 mask)
+{
+	return _mm_or_ps(_mm_andnot_ps(mask, a), _mm_and_ps(mask, b));
+}
+
+int ProjectileBatch::step(float dt, float g, float e, float mu, float rest_speed)
+{
+	const __m128 vdt = _mm_set1_ps(dt);
+	const __m128 vg = _mm_set1_ps(g);
+	const __m128 vhalf_g = _mm_set1_ps(0.5f * g);
+	const __m128 ve = _mm_set1_ps(e);
+	const __m128 vmu = _mm_set1_ps(mu);
+	const __m128 one_e = _mm_set1_ps(1 + e);
+	const __m128 vrest = _mm_set1_ps(rest_speed);
+	const __m128 slide_dv = _mm_set1_ps(mu * g * dt);
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 vfloor = _mm_set1_ps(floor_top);
+	const __m128 vxmin = _mm_set1_ps(xmin);
+	const __m128 vxmax = _mm_set1_ps(xmax);
+
+	int n = (int)x.size();
+	int live = 0;
+	for(int i = 0; i < n; i += 4)
+	{
+		__m128 ti = _mm_loadu_ps(&t[i]);
+		__m128 uyi = _mm_loadu_ps(&uy[i]);
+		__m128 vxi = _mm_loadu_ps(&vx[i]);
+		__m128 xt = _mm_loadu_ps(&x_till_collision[i]);
+		__m128 yt = _mm_loadu_ps(&y_till_collision[i]);
+		__m128 t0 = _mm_loadu_ps(&t_till_now[i]);
+		__m128 al = _mm_loadu_ps(&alive[i]);
+
+		__m128 px = _mm_add_ps(xt, _mm_mul_ps(vxi, _mm_sub_ps(ti, t0)));
+		__m128 py = _mm_sub_ps(_mm_add_ps(yt, _mm_mul_ps(uyi, ti)), _mm_mul_ps(_mm_mul_ps(vhalf_g, ti), ti));
+		__m128 pvy = _mm_sub_ps(uyi, _mm_mul_ps(vg, ti));
+		_mm_storeu_ps(&x[i], px);
+		_mm_storeu_ps(&y[i], py);
+		_mm_storeu_ps(&vy[i], pvy);
+
+		__m128 live_mask = _mm_cmpneq_ps(al, zero);
+		__m128 hit = _mm_and_ps(live_mask, _mm_and_ps(_mm_cmple_ps(py, vfloor), _mm_cmplt_ps(pvy, zero)));
+
+		// Floor impulse, see stepScalar()
+		__m128 closing = _mm_sub_ps(zero, pvy);
+		__m128 bounce = _mm_cmpge_ps(closing, vrest);
+		__m128 fr = select4(_mm_add_ps(_mm_mul_ps(vmu, closing), slide_dv),
+		                    _mm_mul_ps(_mm_mul_ps(vmu, one_e), closing), bounce);
+		__m128 speed = _mm_max_ps(_mm_sub_ps(_mm_andnot_ps(sign, vxi), fr), zero);
+		__m128 new_vx = _mm_or_ps(speed, _mm_and_ps(sign, vxi));
+		__m128 rest = _mm_and_ps(hit, _mm_andnot_ps(bounce, _mm_cmpeq_ps(speed, zero)));
+
+		_mm_storeu_ps(&vx[i], select4(vxi, new_vx, hit));
+		_mm_storeu_ps(&x_till_collision[i], select4(xt, px, hit));
+		_mm_storeu_ps(&y_till_collision[i], select4(yt, vfloor, hit));
+		_mm_storeu_ps(&t_till_now[i], select4(t0, zero, hit));
+		_mm_storeu_ps(&uy[i], select4(uyi, _mm_and_ps(bounce, _mm_mul_ps(ve, closing)), hit));
+		__m128 advanced = _mm_add_ps(ti, _mm_and_ps(live_mask, vdt));
+		_mm_storeu_ps(&t[i], select4(advanced, vdt, hit));
+
+		__m128 out = _mm_or_ps(rest, _mm_or_ps(_mm_cmplt_ps(px, vxmin), _mm_cmpgt_ps(px, vxmax)));
+		__m128 still = _mm_andnot_ps(out, live_mask);
+		_mm_storeu_ps(&alive[i], select4(al, zero, _mm_and_ps(live_mask, out)));
+		live += __builtin_popcount(_mm_movemask_ps(still));
+	}
+	return live;
+}
+
+#else
+
+const char* projectileKernelName() { return "scalar"; }
+
+int ProjectileBatch::step(float dt, float g, float e, float mu, float rest_speed)
+{
+	return stepScalar(dt, g, e, mu, rest_speed);
+}
+
+#endif
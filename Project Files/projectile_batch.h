@@ -0,0 +1,59 @@
+#ifndef PROJECTILE_BATCH_H
+#define PROJECTILE_BATCH_H
+
+#include <cmath>
+#include <vector>
+
+/* Many cannon balls at once, stored as one array per field so the step
+ * kernel can work on 8 (AVX2) or 4 (SSE) balls per instruction.
+ * The motion follows the same closed form as updateBallPosition(): every
+ * ball flies from its last contact point (x_till_collision, y_till_collision)
+ * with velocity (vx, uy) and bounces on a flat floor at floor_top with
+ * restitution e and friction mu. The rest of the level is up to the caller,
+ * which sweeps the balls against it and restarts the ones that hit
+ * something. Balls that leave [xmin, xmax] or come to rest on the floor are
+ * marked dead and stop advancing. */
+class ProjectileBatch {
+public:
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> vx;
+	std::vector<float> vy;
+	std::vector<float> uy;      // vertical speed at the last contact
+	std::vector<float> t;
+	std::vector<float> t_till_now;
+	std::vector<float> x_till_collision;
+	std::vector<float> y_till_collision;
+	std::vector<float> alive;   // 1.0f while moving, 0.0f once out of the play area or at rest
+
+	float floor_top;            // height of a ball centre resting on the floor, -INFINITY for none
+	float xmin, xmax;           // play area
+
+	int size() const { return count; }
+	void reserve(int n);
+	void clear();
+	/* Adds a ball that left (x0, y0) with velocity (vx0, vy0) t0 seconds
+	 * ago, so the next step() puts it where it is at t0. Returns its index. */
+	int add(float x0, float y0, float vx0, float vy0, float t0 = 0);
+	/* Ball i starts again like add() does, alive, after a contact the
+	 * caller worked out itself */
+	void restart(int i, float x0, float y0, float vx0, float vy0, float t0);
+	/* Advances every ball by dt of simulated time. Floor contacts slower
+	 * than rest_speed don't bounce and slide with friction instead. Returns
+	 * the number of balls still alive. */
+	int step(float dt, float g, float e, float mu, float rest_speed);
+	/* Plain loop version of step(); --bench-batch compares the two */
+	int stepScalar(float dt, float g, float e, float mu, float rest_speed);
+
+private:
+	int count;
+	void resize(int n);
+
+public:
+	ProjectileBatch() : floor_top(-INFINITY), xmin(-INFINITY), xmax(INFINITY), count(0) {}
+};
+
+/* Name of the kernel step() was compiled with: "avx2", "sse" or "scalar" */
+const char* projectileKernelName();
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef REAL_H
+#define REAL_H
+
+/* Scalar type of the simulation core. float by default; build with
+ * -DSIM_DOUBLE for the double precision reference. The collision and
+ * integration code is templated and compiled for both, so a float build
+ * can still check itself against double: --headless --check-double runs
+ * every shot through the sweep and the flight in both. */
+#ifdef SIM_DOUBLE
+typedef double real;
+#else
+typedef float real;
+#endif
+
+#endif
@@ -0,0 +1,1360 @@
+#include <cmath>
+#include <algorithm>
+
+#include "rigid_world.h"
+#include "obstacles.h"
+#include "job_pool.h"
+
+using namespace std;
+
+RigidWorld rigid_world;
+
+/* Edges of a box for the contact ids, counted from the +x face anticlockwise
+ * the way Box2D Lite does */
+#define NO_EDGE 0
+#define EDGE1 1
+#define EDGE2 2
+#define EDGE3 3
+#define EDGE4 4
+
+/* What the narrow phase needs of a body or of a level box */
+struct ShapeView {
+	real x, y;
+	real c, s;
+	real hx, hy;
+	int shape;
+};
+
+/* Point of an edge being clipped, with the edges that made it */
+struct ClipVertex {
+	real x, y;
+	unsigned char in1, out1, in2, out2;
+};
+
+static int featureId(const ClipVertex& v)
+{
+	return v.in1 | v.out1 << 8 | v.in2 << 16 | v.out2 << 24;
+}
+
+static ShapeView bodyView(const RigidBody& b)
+{
+	ShapeView v = { b.x, b.y, b.c, b.s, b.hx, b.hy, b.shape };
+	return v;
+}
+
+static ShapeView obstacleView(int i)
+{
+	const Box& b = obstacles[i].box;
+	ShapeView v = { (b.xmin + b.xmax) / 2, (b.ymin + b.ymax) / 2, 1, 0, (b.xmax - b.xmin) / 2, (b.ymax - b.ymin) / 2, SHAPE_BOX };
+	return v;
+}
+
+/* Keeps the part of the segment in on the inner side of the line
+ * n . p = offset. Returns the number of points left in out. */
+static int clipSegment(ClipVertex out[2], const ClipVertex in[2], real nx, real ny, real offset, unsigned char clip_edge)
+{
+	int n = 0;
+	real d0 = nx * in[0].x + ny * in[0].y - offset;
+	real d1 = nx * in[1].x + ny * in[1].y - offset;
+	if(d0 <= 0) out[n++] = in[0];
+	if(d1 <= 0) out[n++] = in[1];
+	if(d0 * d1 < 0)
+	{
+		real f = d0 / (d0 - d1);
+		if(d0 > 0)
+		{
+			out[n] = in[0];
+			out[n].in1 = clip_edge;
+			out[n].in2 = NO_EDGE;
+		}
+		else
+		{
+			out[n] = in[1];
+			out[n].out1 = clip_edge;
+			out[n].out2 = NO_EDGE;
+		}
+		out[n].x = in[0].x + f * (in[1].x - in[0].x);
+		out[n].y = in[0].y + f * (in[1].y - in[0].y);
+		n++;
+	}
+	return n;
+}
+
+/* Edge of box b facing most against the reference normal (nx, ny), in world
+ * coordinates */
+static void incidentEdge(ClipVertex e[2], const ShapeView& b, real nx, real ny)
+{
+	// The normal in the frame of b, turned to face it
+	real lx = -(b.c * nx + b.s * ny);
+	real ly = -(-b.s * nx + b.c * ny);
+	real px[2], py[2];
+	if(fabs(lx) > fabs(ly))
+	{
+		if(lx > 0)
+		{
+			px[0] = b.hx; py[0] = -b.hy; e[0].in2 = EDGE3; e[0].out2 = EDGE4;
+			px[1] = b.hx; py[1] = b.hy;  e[1].in2 = EDGE4; e[1].out2 = EDGE1;
+		}
+		else
+		{
+			px[0] = -b.hx; py[0] = b.hy;  e[0].in2 = EDGE1; e[0].out2 = EDGE2;
+			px[1] = -b.hx; py[1] = -b.hy; e[1].in2 = EDGE2; e[1].out2 = EDGE3;
+		}
+	}
+	else
+	{
+		if(ly > 0)
+		{
+			px[0] = b.hx; py[0] = b.hy;  e[0].in2 = EDGE4; e[0].out2 = EDGE1;
+			px[1] = -b.hx; py[1] = b.hy; e[1].in2 = EDGE1; e[1].out2 = EDGE2;
+		}
+		else
+		{
+			px[0] = -b.hx; py[0] = -b.hy; e[0].in2 = EDGE2; e[0].out2 = EDGE3;
+			px[1] = b.hx; py[1] = -b.hy;  e[1].in2 = EDGE3; e[1].out2 = EDGE4;
+		}
+	}
+	for(int k = 0; k < 2; k++)
+	{
+		e[k].in1 = NO_EDGE;
+		e[k].out1 = NO_EDGE;
+		e[k].x = b.x + b.c * px[k] - b.s * py[k];
+		e[k].y = b.y + b.s * px[k] + b.c * py[k];
+	}
+}
+
+/* Separating axis test between two oriented boxes. The reference face is
+ * the axis of least overlap, preferring a's faces and x over y unless
+ * another is clearly better, so the choice doesn't flicker between steps.
+ * The incident edge of the other box is clipped to the sides of the
+ * reference face and the points behind it are the contacts. */
+static int collideBoxes(const ShapeView& A, const ShapeView& B, Manifold* m)
+{
+	real dpx = B.x - A.x, dpy = B.y - A.y;
+	real dax = A.c * dpx + A.s * dpy, day = -A.s * dpx + A.c * dpy;
+	real dbx = B.c * dpx + B.s * dpy, dby = -B.s * dpx + B.c * dpy;
+	// Axes of b in the frame of a
+	real c11 = fabs(A.c * B.c + A.s * B.s), c12 = fabs(A.s * B.c - A.c * B.s);
+	real c21 = fabs(A.c * B.s - A.s * B.c), c22 = fabs(A.s * B.s + A.c * B.c);
+
+	real face_ax = fabs(dax) - A.hx - (c11 * B.hx + c12 * B.hy);
+	real face_ay = fabs(day) - A.hy - (c21 * B.hx + c22 * B.hy);
+	if(face_ax > 0 || face_ay > 0)
+		return 0;
+	real face_bx = fabs(dbx) - (c11 * A.hx + c21 * A.hy) - B.hx;
+	real face_by = fabs(dby) - (c12 * A.hx + c22 * A.hy) - B.hy;
+	if(face_bx > 0 || face_by > 0)
+		return 0;
+
+	const real relative_tol = 0.95f, absolute_tol = 0.01f;
+	int axis = 0;
+	real separation = face_ax;
+	real nx = dax > 0 ? A.c : -A.c, ny = dax > 0 ? A.s : -A.s;
+	if(face_ay > relative_tol * separation + absolute_tol * A.hy)
+	{
+		axis = 1;
+		separation = face_ay;
+		nx = day > 0 ? -A.s : A.s;
+		ny = day > 0 ? A.c : -A.c;
+	}
+	if(face_bx > relative_tol * separation + absolute_tol * B.hx)
+	{
+		axis = 2;
+		separation = face_bx;
+		nx = dbx > 0 ? B.c : -B.c;
+		ny = dbx > 0 ? B.s : -B.s;
+	}
+	if(face_by > relative_tol * separation + absolute_tol * B.hy)
+	{
+		axis = 3;
+		separation = face_by;
+		nx = dby > 0 ? -B.s : B.s;
+		ny = dby > 0 ? B.c : -B.c;
+	}
+
+	// Reference face and its two sides
+	const ShapeView& ref = axis < 2 ? A : B;
+	const ShapeView& inc = axis < 2 ? B : A;
+	real fnx = axis < 2 ? nx : -nx, fny = axis < 2 ? ny : -ny;
+	real snx, sny, h_front, h_side;
+	unsigned char neg_edge, pos_edge;
+	if(axis == 0 || axis == 2)
+	{
+		snx = -ref.s; sny = ref.c;
+		h_front = ref.hx; h_side = ref.hy;
+		neg_edge = EDGE3; pos_edge = EDGE1;
+	}
+	else
+	{
+		snx = ref.c; sny = ref.s;
+		h_front = ref.hy; h_side = ref.hx;
+		neg_edge = EDGE2; pos_edge = EDGE4;
+	}
+	real front = ref.x * fnx + ref.y * fny + h_front;
+	real side = ref.x * snx + ref.y * sny;
+
+	ClipVertex e[2], clip1[2], clip2[2];
+	incidentEdge(e, inc, fnx, fny);
+	if(clipSegment(clip1, e, -snx, -sny, -side + h_side, neg_edge) < 2)
+		return 0;
+	if(clipSegment(clip2, clip1, snx, sny, side + h_side, pos_edge) < 2)
+		return 0;
+
+	m->nx = nx;
+	m->ny = ny;
+	int n = 0;
+	for(int k = 0; k < 2; k++)
+	{
+		real sep = fnx * clip2[k].x + fny * clip2[k].y - front;
+		if(sep > 0)
+			continue;
+		ContactPoint& p = m->points[n++];
+		p.separation = sep;
+		// On the reference face
+		p.x = clip2[k].x - sep * fnx;
+		p.y = clip2[k].y - sep * fny;
+		if(axis >= 2)
+		{
+			// Same edges seen from a
+			ClipVertex f = clip2[k];
+			swap(f.in1, f.in2);
+			swap(f.out1, f.out2);
+			p.id = featureId(f);
+		}
+		else
+			p.id = featureId(clip2[k]);
+	}
+	return n;
+}
+
+/* Box A against circle B, normal from the box to the circle */
+static int collideBoxCircle(const ShapeView& A, const ShapeView& B, real* nx, real* ny, ContactPoint* p)
+{
+	real dx = B.x - A.x, dy = B.y - A.y;
+	real lx = A.c * dx + A.s * dy, ly = -A.s * dx + A.c * dy;
+	real qx = lx < -A.hx ? -A.hx : (lx > A.hx ? A.hx : lx);
+	real qy = ly < -A.hy ? -A.hy : (ly > A.hy ? A.hy : ly);
+	real lnx, lny, sep;
+	if(qx == lx && qy == ly)
+	{
+		// Centre inside the box: out through the closest face
+		real gx = A.hx - fabs(lx), gy = A.hy - fabs(ly);
+		if(gx < gy)
+		{
+			lnx = lx < 0 ? -1 : 1; lny = 0;
+			qx = lnx * A.hx;
+			sep = -gx - B.hx;
+		}
+		else
+		{
+			lnx = 0; lny = ly < 0 ? -1 : 1;
+			qy = lny * A.hy;
+			sep = -gy - B.hx;
+		}
+	}
+	else
+	{
+		real ex = lx - qx, ey = ly - qy;
+		real dist = sqrt(ex * ex + ey * ey);
+		if(dist > B.hx)
+			return 0;
+		lnx = ex / dist;
+		lny = ey / dist;
+		sep = dist - B.hx;
+	}
+	*nx = A.c * lnx - A.s * lny;
+	*ny = A.s * lnx + A.c * lny;
+	p->x = A.x + A.c * qx - A.s * qy;
+	p->y = A.y + A.s * qx + A.c * qy;
+	p->separation = sep;
+	p->id = 0;
+	return 1;
+}
+
+static int collideCircles(const ShapeView& A, const ShapeView& B, real* nx, real* ny, ContactPoint* p)
+{
+	real dx = B.x - A.x, dy = B.y - A.y;
+	real dist = sqrt(dx * dx + dy * dy);
+	if(dist > A.hx + B.hx)
+		return 0;
+	*nx = dist > 0 ? dx / dist : 0;
+	*ny = dist > 0 ? dy / dist : 1;
+	p->x = A.x + *nx * A.hx;
+	p->y = A.y + *ny * A.hx;
+	p->separation = dist - A.hx - B.hx;
+	p->id = 0;
+	return 1;
+}
+
+/* Contact points of A and B into m, normal from A to B */
+static int collide(const ShapeView& A, const ShapeView& B, Manifold* m)
+{
+	if(A.shape == SHAPE_BOX && B.shape == SHAPE_BOX)
+		return collideBoxes(A, B, m);
+	if(A.shape == SHAPE_BOX)
+		return collideBoxCircle(A, B, &m->nx, &m->ny, &m->points[0]);
+	if(B.shape == SHAPE_BOX)
+	{
+		int n = collideBoxCircle(B, A, &m->nx, &m->ny, &m->points[0]);
+		m->nx = -m->nx;
+		m->ny = -m->ny;
+		return n;
+	}
+	return collideCircles(A, B, &m->nx, &m->ny, &m->points[0]);
+}
+
+static bool pairLess(const Manifold& m, int a, int b)
+{
+	return m.a < a || (m.a == a && m.b < b);
+}
+
+static bool manifoldLess(const Manifold& m, const Manifold& o)
+{
+	return pairLess(m, o.a, o.b);
+}
+
+static int findRoot(vector<int>& parent, int i)
+{
+	while(parent[i] != i)
+	{
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+RigidWorld::RigidWorld() : gravity(4.0f), iterations(10), bias_factor(0.2f), slop(0.005f), level_friction(0.5f),
+	sleep_linear(0.01f), sleep_angular(0.035f), time_to_sleep(0.5f), debris_capacity(128), debris_floor(-10), debris_next(0), breakable(0), step_dt(0),
+	joints_coloured(0), mark_stamp(0)
+{
+}
+
+int RigidWorld::add(const RigidBody& b)
+{
+	bodies.push_back(b);
+	int i = (int)bodies.size() - 1;
+	place(i, b);
+	initial.push_back(bodies[i]);
+	return i;
+}
+
+/* Puts b into the world as body i, awake */
+void RigidWorld::place(int i, const RigidBody& b)
+{
+	bodies[i] = b;
+	bodies[i].island = -1;
+	bodies[i].sleep_time = 0;
+	bodies[i].leaf = tree.insert(bounds(i), i);
+	if(b.inv_mass > 0)
+		awake.push_back(i);
+}
+
+RigidBody RigidWorld::boxBody(real x, real y, real w, real h, real angle, real density, const float color[3])
+{
+	RigidBody b = RigidBody();
+	b.x = x;
+	b.y = y;
+	b.angle = angle;
+	b.c = cos(angle);
+	b.s = sin(angle);
+	b.hx = w / 2;
+	b.hy = h / 2;
+	b.shape = SHAPE_BOX;
+	real mass = density * w * h;
+	b.inv_mass = mass > 0 ? 1 / mass : 0;
+	b.inv_inertia = mass > 0 ? 12 / (mass * (w * w + h * h)) : 0;
+	b.friction = 0.5f;
+	b.color[0] = color[0];
+	b.color[1] = color[1];
+	b.color[2] = color[2];
+	b.pattern = -1;
+	b.cell = -1;
+	b.entity = -1;
+	return b;
+}
+
+int RigidWorld::addBox(real x, real y, real w, real h, real angle, real density, float red, float green, float blue)
+{
+	float color[3] = { red, green, blue };
+	return add(boxBody(x, y, w, h, angle, density, color));
+}
+
+int RigidWorld::addCircle(real x, real y, real radius, real density, float red, float green, float blue)
+{
+	RigidBody b = RigidBody();
+	b.x = x;
+	b.y = y;
+	b.c = 1;
+	b.hx = radius;
+	b.hy = radius;
+	b.shape = SHAPE_CIRCLE;
+	real mass = density * (real)M_PI * radius * radius;
+	b.inv_mass = mass > 0 ? 1 / mass : 0;
+	b.inv_inertia = mass > 0 ? 2 / (mass * radius * radius) : 0;
+	b.friction = 0.5f;
+	b.color[0] = red;
+	b.color[1] = green;
+	b.color[2] = blue;
+	b.pattern = -1;
+	b.cell = -1;
+	b.entity = -1;
+	return add(b);
+}
+
+void RigidWorld::setStrength(int i, real strength)
+{
+	bodies[i].flags |= BODY_BREAKABLE;
+	bodies[i].strength = strength;
+	initial[i].flags |= BODY_BREAKABLE;
+	initial[i].strength = strength;
+	breakable++;
+}
+
+/* The bodies whose box overlaps it are woken as well as its island: a
+ * fixed body joins no island, but what rests on it must fall */
+void RigidWorld::remove(int i)
+{
+	if(bodies[i].flags & BODY_REMOVED)
+		return;
+	wake(i);
+	tree.query(bounds(i), found);
+	for(int k = 0; k < (int)found.size(); k++)
+		wake(found[k]);
+	RigidBody& b = bodies[i];
+	tree.remove(b.leaf);
+	b.leaf = -1;
+	b.flags |= BODY_REMOVED;
+	b.vx = b.vy = b.w = 0;
+	awake.erase(std::remove(awake.begin(), awake.end(), i), awake.end());
+	int n = 0;
+	for(int k = 0; k < (int)joints.size(); k++)
+		if(joints[k].a != i && joints[k].b != i)
+			joints[n++] = joints[k];
+	if(n < (int)joints.size())
+	{
+		joints.resize(n);
+		joints_coloured = 0;
+	}
+}
+
+/* Slots are bodies like any other, out of the world, so restart() leaves
+ * them out */
+void RigidWorld::reserveDebris()
+{
+	static const float black[3] = { 0, 0, 0 };
+	RigidBody slot = boxBody(0, 0, 0, 0, 0, 0, black);
+	slot.flags = BODY_DEBRIS | BODY_REMOVED;
+	slot.leaf = -1;
+	slot.island = -1;
+	while((int)debris.size() < debris_capacity)
+	{
+		bodies.push_back(slot);
+		initial.push_back(slot);
+		debris.push_back((int)bodies.size() - 1);
+	}
+}
+
+/* Reusing a slot costs a tree remove and insert */
+int RigidWorld::addDebris(real x, real y, real w, real h, real angle, real vx, real vy, real spin, real density, const float color[3])
+{
+	if(debris.empty())
+		return -1;
+	RigidBody b = boxBody(x, y, w, h, angle, density, color);
+	b.flags = BODY_DEBRIS;
+	b.vx = vx;
+	b.vy = vy;
+	b.w = spin;
+	if(debris_next >= (int)debris.size())
+		debris_next = 0;
+	int i = debris[debris_next++];
+	// The oldest piece, if it is still there
+	remove(i);
+	place(i, b);
+	return i;
+}
+
+/* Anchors are kept in the frames of the bodies. Joining wakes both, so
+ * joined bodies are always awake or asleep together. */
+int RigidWorld::addJoint(int type, int a, int b, real ax, real ay, real bx, real by, real length)
+{
+	Joint j = Joint();
+	j.type = type;
+	j.a = a;
+	j.b = b < 0 ? -1 : b;
+	const RigidBody& A = bodies[a];
+	j.lax = A.c * (ax - A.x) + A.s * (ay - A.y);
+	j.lay = -A.s * (ax - A.x) + A.c * (ay - A.y);
+	j.lbx = bx;
+	j.lby = by;
+	if(b >= 0)
+	{
+		const RigidBody& B = bodies[b];
+		j.lbx = B.c * (bx - B.x) + B.s * (by - B.y);
+		j.lby = -B.s * (bx - B.x) + B.c * (by - B.y);
+		wake(b);
+	}
+	wake(a);
+	j.length = length;
+	j.color[0] = j.color[1] = -1;
+	j.slot[0] = j.slot[1] = -1;
+	joints.push_back(j);
+	initial_joints.push_back(j);
+	joints_coloured = 0;
+	return (int)joints.size() - 1;
+}
+
+int RigidWorld::addDistanceJoint(int a, int b, real ax, real ay, real bx, real by)
+{
+	return addJoint(JOINT_DISTANCE, a, b, ax, ay, bx, by, sqrt((bx - ax) * (bx - ax) + (by - ay) * (by - ay)));
+}
+
+int RigidWorld::addRopeJoint(int a, int b, real ax, real ay, real bx, real by, real length)
+{
+	if(length <= 0)
+		length = sqrt((bx - ax) * (bx - ax) + (by - ay) * (by - ay));
+	return addJoint(JOINT_ROPE, a, b, ax, ay, bx, by, length);
+}
+
+int RigidWorld::addRevoluteJoint(int a, int b, real x, real y)
+{
+	return addJoint(JOINT_REVOLUTE, a, b, x, y, x, y, 0);
+}
+
+void RigidWorld::clear()
+{
+	bodies.clear();
+	initial.clear();
+	manifolds.clear();
+	joints.clear();
+	initial_joints.clear();
+	broken.clear();
+	debris.clear();
+	debris_next = 0;
+	breakable = 0;
+	joined.clear();
+	joints_coloured = 0;
+	woken.clear();
+	awake.clear();
+	sleeping.clear();
+	islands.clear();
+	solver.clear();
+	tree.clear();
+}
+
+void RigidWorld::restart()
+{
+	bodies = initial;
+	joints = initial_joints;
+	joints_coloured = 0;
+	broken.clear();
+	debris_next = 0;
+	manifolds.clear();
+	woken.clear();
+	awake.clear();
+	sleeping.clear();
+	islands.clear();
+	tree.clear();
+	for(int i = 0; i < (int)bodies.size(); i++)
+	{
+		if(bodies[i].flags & BODY_REMOVED)
+			continue;
+		bodies[i].leaf = tree.insert(bounds(i), i);
+		if(bodies[i].inv_mass > 0)
+			awake.push_back(i);
+	}
+}
+
+void RigidWorld::wake(int i)
+{
+	int s = bodies[i].island;
+	if(s < 0)
+		return;
+	SleepingIsland& isl = sleeping[s];
+	for(int k = 0; k < (int)isl.bodies.size(); k++)
+	{
+		RigidBody& b = bodies[isl.bodies[k]];
+		b.island = -1;
+		b.sleep_time = 0;
+		awake.push_back(isl.bodies[k]);
+	}
+	woken.insert(woken.end(), isl.manifolds.begin(), isl.manifolds.end());
+	// The last island takes its place
+	int last = (int)sleeping.size() - 1;
+	if(s != last)
+	{
+		isl.bodies.swap(sleeping[last].bodies);
+		isl.manifolds.swap(sleeping[last].manifolds);
+		for(int k = 0; k < (int)isl.bodies.size(); k++)
+			bodies[isl.bodies[k]].island = s;
+	}
+	sleeping.pop_back();
+}
+
+Box RigidWorld::bounds(int i) const
+{
+	const RigidBody& b = bodies[i];
+	real ex = fabs(b.c) * b.hx + fabs(b.s) * b.hy;
+	real ey = fabs(b.s) * b.hx + fabs(b.c) * b.hy;
+	Box box = { b.x - ex, b.x + ex, b.y - ey, b.y + ey };
+	return box;
+}
+
+int RigidWorld::query(const Box& region, vector<int>& out)
+{
+	tree.query(region, out);
+	int n = 0;
+	for(int k = 0; k < (int)out.size(); k++)
+	{
+		Box b = bounds(out[k]);
+		if(b.xmin <= region.xmax && b.xmax >= region.xmin && b.ymin <= region.ymax && b.ymax >= region.ymin)
+			out[n++] = out[k];
+	}
+	out.resize(n);
+	sort(out.begin(), out.end());
+	return n;
+}
+
+/* One query for the bodies whose box meets the box of the blast; the
+ * batch leaves out the ones whose centre is too far */
+int RigidWorld::radialImpulse(real x, real y, real radius, real peak, vector<int>& shattered)
+{
+	shattered.clear();
+	if(radius <= 0)
+		return 0;
+	Box region = { x - radius, x + radius, y - radius, y + radius };
+	query(region, found);
+	blast.clear();
+	for(int k = 0; k < (int)found.size(); k++)
+	{
+		const RigidBody& b = bodies[found[k]];
+		if(b.inv_mass > 0 && !(b.flags & BODY_REMOVED))
+			blast.add(found[k], b.x - x, b.y - y, b.inv_mass);
+	}
+	blast.radial(radius, peak);
+	int pushed = 0;
+	for(int k = 0; k < blast.size(); k++)
+	{
+		if(blast.impulse[k] <= 0)
+			continue;
+		int i = blast.body[k];
+		wake(i);
+		RigidBody& b = bodies[i];
+		b.vx += blast.dvx[k];
+		b.vy += blast.dvy[k];
+		b.sleep_time = 0;
+		if((b.flags & BODY_BREAKABLE) && blast.impulse[k] >= b.strength)
+			shattered.push_back(i);
+		pushed++;
+	}
+	return pushed;
+}
+
+int RigidWorld::contactCount() const
+{
+	int n = 0;
+	for(int k = 0; k < (int)manifolds.size(); k++)
+		n += manifolds[k].count;
+	for(int s = 0; s < (int)sleeping.size(); s++)
+		for(int k = 0; k < (int)sleeping[s].manifolds.size(); k++)
+			n += sleeping[s].manifolds[k].count;
+	for(int k = 0; k < (int)woken.size(); k++)
+		n += woken[k].count;
+	return n;
+}
+
+/* Finds every pair an awake body touches with the tree (bodies) and the
+ * grid (level), builds the new manifolds in pair order and carries the
+ * impulses of the points found again over from the last step. Both arrays
+ * are sorted, so the matching is one merge. A sleeping body that is really
+ * touched wakes with its island, whose bodies then look for contacts too. */
+void RigidWorld::updateContacts()
+{
+	if((int)mark.size() != (int)bodies.size())
+		mark.assign(bodies.size(), 0);
+	mark_stamp++;
+	candidates.clear();
+	for(int q = 0; q < (int)awake.size(); q++)
+	{
+		int i = awake[q];
+		mark[i] = mark_stamp;
+		Box b = bounds(i);
+		tree.query(b, found);
+		for(int k = 0; k < (int)found.size(); k++)
+		{
+			int j = found[k];
+			// Each pair once, from the first of the two to look
+			if(j == i || mark[j] == mark_stamp)
+				continue;
+			if(bodies[j].island >= 0)
+			{
+				Manifold m;
+				if(!collide(bodyView(bodies[i]), bodyView(bodies[j]), &m))
+					continue;
+				wake(j);
+			}
+			candidates.push_back(i < j ? make_pair(i, j) : make_pair(j, i));
+		}
+		queryObstacles(b, found);
+		for(int k = 0; k < (int)found.size(); k++)
+			candidates.push_back(make_pair(i, -1 - found[k]));
+	}
+	sort(candidates.begin(), candidates.end());
+	if(!joints_coloured)
+		colorJoints();
+	if(!joined.empty())
+	{
+		// Both sorted: one merge drops the joined pairs
+		int n = 0;
+		for(int k = 0, q = 0; k < (int)candidates.size(); k++)
+		{
+			while(q < (int)joined.size() && joined[q] < candidates[k])
+				q++;
+			if(q < (int)joined.size() && joined[q] == candidates[k])
+				continue;
+			candidates[n++] = candidates[k];
+		}
+		candidates.resize(n);
+	}
+
+	previous.swap(manifolds);
+	if(!woken.empty())
+	{
+		sort(woken.begin(), woken.end(), manifoldLess);
+		manifolds.resize(previous.size() + woken.size());
+		merge(previous.begin(), previous.end(), woken.begin(), woken.end(), manifolds.begin(), manifoldLess);
+		previous.swap(manifolds);
+		woken.clear();
+	}
+	manifolds.clear();
+	int old = 0;
+	for(int k = 0; k < (int)candidates.size(); k++)
+	{
+		int a = candidates[k].first, b = candidates[k].second;
+		Manifold m;
+		m.a = a;
+		m.b = b;
+		ShapeView va = bodyView(bodies[a]);
+		ShapeView vb = b >= 0 ? bodyView(bodies[b]) : obstacleView(-1 - b);
+		m.count = collide(va, vb, &m);
+		if(m.count == 0)
+			continue;
+		real fb = b >= 0 ? bodies[b].friction : level_friction;
+		m.friction = sqrt(bodies[a].friction * fb);
+
+		while(old < (int)previous.size() && pairLess(previous[old], a, b))
+			old++;
+		const Manifold* last = old < (int)previous.size() && previous[old].a == a && previous[old].b == b ? &previous[old] : 0;
+		for(int i = 0; i < m.count; i++)
+		{
+			ContactPoint& p = m.points[i];
+			p.pn = 0;
+			p.pt = 0;
+			if(!last)
+				continue;
+			for(int j = 0; j < last->count; j++)
+				if(last->points[j].id == p.id)
+				{
+					p.pn = last->points[j].pn;
+					p.pt = last->points[j].pt;
+					break;
+				}
+		}
+		manifolds.push_back(m);
+	}
+}
+
+/* Groups the awake bodies joined by contacts into islands (union-find),
+ * numbered in the order of awake, with their bodies and contacts as
+ * ranges of island_bodies and island_contacts. Fixed bodies and the level
+ * join nothing: a stack on the floor is its own island. */
+void RigidWorld::buildIslands()
+{
+	parent.resize(bodies.size());
+	island_of.resize(bodies.size());
+	for(int q = 0; q < (int)awake.size(); q++)
+	{
+		parent[awake[q]] = awake[q];
+		island_of[awake[q]] = -1;
+	}
+	for(int k = 0; k < (int)manifolds.size(); k++)
+	{
+		const Manifold& m = manifolds[k];
+		if(m.b < 0 || bodies[m.a].inv_mass == 0 || bodies[m.b].inv_mass == 0)
+			continue;
+		int ra = findRoot(parent, m.a), rb = findRoot(parent, m.b);
+		if(ra != rb)
+			parent[max(ra, rb)] = min(ra, rb);
+	}
+	for(int k = 0; k < (int)joints.size(); k++)
+	{
+		const Joint& j = joints[k];
+		if(j.b < 0 || !isAwake(j.a) || !isAwake(j.b))
+			continue;
+		int ra = findRoot(parent, j.a), rb = findRoot(parent, j.b);
+		if(ra != rb)
+			parent[max(ra, rb)] = min(ra, rb);
+	}
+
+	islands.clear();
+	for(int q = 0; q < (int)awake.size(); q++)
+	{
+		int r = findRoot(parent, awake[q]);
+		if(island_of[r] < 0)
+		{
+			Island isl = { 0, 0, 0, 0, 0, 0, 0, 0 };
+			island_of[r] = (int)islands.size();
+			islands.push_back(isl);
+		}
+		island_of[awake[q]] = island_of[r];
+		islands[island_of[r]].body_count++;
+	}
+	contact_island.resize(manifolds.size());
+	for(int k = 0; k < (int)manifolds.size(); k++)
+	{
+		const Manifold& m = manifolds[k];
+		contact_island[k] = island_of[bodies[m.a].inv_mass > 0 ? m.a : m.b];
+		islands[contact_island[k]].contact_count++;
+	}
+
+	// Ranges from the counts, then filled in order
+	int bodies_before = 0, contacts_before = 0;
+	for(int k = 0; k < (int)islands.size(); k++)
+	{
+		islands[k].first_body = bodies_before;
+		islands[k].first_contact = contacts_before;
+		bodies_before += islands[k].body_count;
+		contacts_before += islands[k].contact_count;
+		islands[k].body_count = 0;
+		islands[k].contact_count = 0;
+	}
+	island_bodies.resize(awake.size());
+	island_contacts.resize(manifolds.size());
+	for(int q = 0; q < (int)awake.size(); q++)
+	{
+		Island& isl = islands[island_of[awake[q]]];
+		island_bodies[isl.first_body + isl.body_count++] = awake[q];
+	}
+	for(int k = 0; k < (int)manifolds.size(); k++)
+	{
+		Island& isl = islands[contact_island[k]];
+		island_contacts[isl.first_contact + isl.contact_count++] = k;
+	}
+	layoutJoints();
+}
+
+/* Island of the awake bodies j moves, -1 if it moves none */
+int RigidWorld::jointIsland(const Joint& j) const
+{
+	if(isAwake(j.a))
+		return island_of[j.a];
+	if(j.b >= 0 && isAwake(j.b))
+		return island_of[j.b];
+	return -1;
+}
+
+/* Greedy colouring of the joint rows: each row takes the first colour
+ * no other row moving one of its bodies has. Rows of one colour can then
+ * be solved side by side. Also lists the joined pairs. */
+void RigidWorld::colorJoints()
+{
+	colors_used.assign(bodies.size(), 0);
+	joined.clear();
+	for(int k = 0; k < (int)joints.size(); k++)
+	{
+		Joint& j = joints[k];
+		if(j.b >= 0)
+			joined.push_back(j.a < j.b ? make_pair(j.a, j.b) : make_pair(j.b, j.a));
+		unsigned int* used_a = bodies[j.a].inv_mass > 0 ? &colors_used[j.a] : 0;
+		unsigned int* used_b = j.b >= 0 && bodies[j.b].inv_mass > 0 ? &colors_used[j.b] : 0;
+		int count = j.type == JOINT_REVOLUTE ? 2 : 1;
+		for(int r = 0; r < 2; r++)
+		{
+			j.color[r] = -1;
+			if(r >= count)
+				continue;
+			unsigned int used = (used_a ? *used_a : 0) | (used_b ? *used_b : 0);
+			int c = 0;
+			while(c < JOINT_COLORS && (used >> c & 1))
+				c++;
+			j.color[r] = c;
+			if(c == JOINT_COLORS)
+				continue;
+			if(used_a)
+				*used_a |= 1u << c;
+			if(used_b)
+				*used_b |= 1u << c;
+		}
+	}
+	sort(joined.begin(), joined.end());
+	joined.erase(unique(joined.begin(), joined.end()), joined.end());
+	joints_coloured = 1;
+}
+
+/* Joints of each awake island into island_joints, and their rows into
+ * rows: per island, colour after colour, each colour padded to whole
+ * groups, and a group alone for every row that found no colour */
+void RigidWorld::layoutJoints()
+{
+	if(!joints_coloured)
+		colorJoints();
+	for(int k = 0; k < (int)islands.size(); k++)
+		islands[k].joint_count = 0;
+	int total = 0;
+	for(int q = 0; q < (int)joints.size(); q++)
+	{
+		int k = jointIsland(joints[q]);
+		if(k < 0)
+			continue;
+		islands[k].joint_count++;
+		total++;
+	}
+	int before = 0;
+	for(int k = 0; k < (int)islands.size(); k++)
+	{
+		islands[k].first_joint = before;
+		before += islands[k].joint_count;
+		islands[k].joint_count = 0;
+	}
+	island_joints.resize(total);
+	for(int q = 0; q < (int)joints.size(); q++)
+	{
+		int k = jointIsland(joints[q]);
+		if(k >= 0)
+			island_joints[islands[k].first_joint + islands[k].joint_count++] = q;
+	}
+
+	int row = 0;
+	for(int k = 0; k < (int)islands.size(); k++)
+	{
+		Island& isl = islands[k];
+		int start[JOINT_COLORS + 1] = { 0 };
+		for(int q = isl.first_joint; q < isl.first_joint + isl.joint_count; q++)
+			for(int r = 0; r < 2; r++)
+				if(joints[island_joints[q]].color[r] >= 0)
+					start[joints[island_joints[q]].color[r]]++;
+		isl.first_row = row;
+		for(int c = 0; c <= JOINT_COLORS; c++)
+		{
+			int count = start[c];
+			start[c] = row;
+			row += c < JOINT_COLORS ? (count + CONSTRAINT_LANES - 1) / CONSTRAINT_LANES * CONSTRAINT_LANES : count * CONSTRAINT_LANES;
+		}
+		isl.row_count = row - isl.first_row;
+		for(int q = isl.first_joint; q < isl.first_joint + isl.joint_count; q++)
+		{
+			Joint& j = joints[island_joints[q]];
+			for(int r = 0; r < 2; r++)
+			{
+				j.slot[r] = -1;
+				if(j.color[r] < 0)
+					continue;
+				j.slot[r] = start[j.color[r]];
+				start[j.color[r]] += j.color[r] < JOINT_COLORS ? 1 : CONSTRAINT_LANES;
+			}
+		}
+	}
+	rows.resize(row);
+}
+
+/* Copies the velocities of the island into solver, then works out the
+ * masses along the normal and the tangent of every point, the velocity that
+ * pushes overlaps apart, and applies the impulses of the last step again */
+void RigidWorld::preStep(int k, real inv_dt)
+{
+	const Island& isl = islands[k];
+	int fixed = (int)bodies.size() + k;
+	SolverBody zero = { 0, 0, 0, 0, 0 };
+	solver[fixed] = zero;
+	for(int q = isl.first_body; q < isl.first_body + isl.body_count; q++)
+	{
+		int i = island_bodies[q];
+		SolverBody& sb = solver[i];
+		sb.vx = bodies[i].vx;
+		sb.vy = bodies[i].vy;
+		sb.w = bodies[i].w;
+		sb.inv_mass = bodies[i].inv_mass;
+		sb.inv_inertia = bodies[i].inv_inertia;
+	}
+
+	for(int q = isl.first_contact; q < isl.first_contact + isl.contact_count; q++)
+	{
+		Manifold& m = manifolds[island_contacts[q]];
+		const RigidBody& body_a = bodies[m.a];
+		m.sa = body_a.inv_mass > 0 ? m.a : fixed;
+		m.sb = m.b >= 0 && bodies[m.b].inv_mass > 0 ? m.b : fixed;
+		SolverBody& A = solver[m.sa];
+		SolverBody& B = solver[m.sb];
+		real ax = body_a.x, ay = body_a.y;
+		real bx = m.b >= 0 ? bodies[m.b].x : (obstacles[-1 - m.b].box.xmin + obstacles[-1 - m.b].box.xmax) / 2;
+		real by = m.b >= 0 ? bodies[m.b].y : (obstacles[-1 - m.b].box.ymin + obstacles[-1 - m.b].box.ymax) / 2;
+		real tx = m.ny, ty = -m.nx;
+		// A kinematic box is a fixed row too; its velocity goes in the
+		// targets of the rows instead
+		real kvx = m.b < 0 ? obstacles[-1 - m.b].vx : 0, kvy = m.b < 0 ? obstacles[-1 - m.b].vy : 0;
+		for(int i = 0; i < m.count; i++)
+		{
+			ContactPoint& p = m.points[i];
+			p.rax = p.x - ax;
+			p.ray = p.y - ay;
+			p.rbx = p.x - bx;
+			p.rby = p.y - by;
+			real rna = p.rax * m.nx + p.ray * m.ny, rnb = p.rbx * m.nx + p.rby * m.ny;
+			real k_n = A.inv_mass + B.inv_mass
+			         + A.inv_inertia * (p.rax * p.rax + p.ray * p.ray - rna * rna)
+			         + B.inv_inertia * (p.rbx * p.rbx + p.rby * p.rby - rnb * rnb);
+			p.mass_n = 1 / k_n;
+			real rta = p.rax * tx + p.ray * ty, rtb = p.rbx * tx + p.rby * ty;
+			real k_t = A.inv_mass + B.inv_mass
+			         + A.inv_inertia * (p.rax * p.rax + p.ray * p.ray - rta * rta)
+			         + B.inv_inertia * (p.rbx * p.rbx + p.rby * p.rby - rtb * rtb);
+			p.mass_t = 1 / k_t;
+			real overlap = -p.separation - slop;
+			p.bias = overlap > 0 ? bias_factor * inv_dt * overlap : 0;
+			p.bias -= kvx * m.nx + kvy * m.ny;
+			p.surface = kvx * tx + kvy * ty;
+
+			real px = p.pn * m.nx + p.pt * tx, py = p.pn * m.ny + p.pt * ty;
+			A.vx -= A.inv_mass * px;
+			A.vy -= A.inv_mass * py;
+			A.w -= A.inv_inertia * (p.rax * py - p.ray * px);
+			B.vx += B.inv_mass * px;
+			B.vy += B.inv_mass * py;
+			B.w += B.inv_inertia * (p.rbx * py - p.rby * px);
+		}
+	}
+}
+
+/* Fills the rows of the joints of island k from where their anchors are
+ * now: a rod or rope acts along the line between the anchors, a hinge along
+ * x and y. Overlong rods and ropes and parted hinges get a bias pulling them
+ * back; a slack rope lets its ends come apart as far as it has slack left
+ * within the step. The impulses of the last step are applied again. */
+void RigidWorld::prepareJoints(int k, real inv_dt)
+{
+	const Island& isl = islands[k];
+	int fixed = (int)bodies.size() + k;
+	for(int i = isl.first_row; i < isl.first_row + isl.row_count; i++)
+		rows.clearRow(i, fixed);
+	for(int q = isl.first_joint; q < isl.first_joint + isl.joint_count; q++)
+	{
+		Joint& j = joints[island_joints[q]];
+		const RigidBody& body_a = bodies[j.a];
+		int sa = body_a.inv_mass > 0 ? j.a : fixed;
+		int sb = j.b >= 0 && bodies[j.b].inv_mass > 0 ? j.b : fixed;
+		real rax = body_a.c * j.lax - body_a.s * j.lay, ray = body_a.s * j.lax + body_a.c * j.lay;
+		real rbx = 0, rby = 0, pbx = j.lbx, pby = j.lby;
+		if(j.b >= 0)
+		{
+			const RigidBody& body_b = bodies[j.b];
+			rbx = body_b.c * j.lbx - body_b.s * j.lby;
+			rby = body_b.s * j.lbx + body_b.c * j.lby;
+			pbx = body_b.x + rbx;
+			pby = body_b.y + rby;
+		}
+		real dx = pbx - (body_a.x + rax), dy = pby - (body_a.y + ray);
+		real len = sqrt(dx * dx + dy * dy);
+		SolverBody& A = solver[sa];
+		SolverBody& B = solver[sb];
+		for(int r = 0; r < 2; r++)
+		{
+			int i = j.slot[r];
+			if(i < 0)
+				continue;
+			real nx, ny, error;
+			if(j.type == JOINT_REVOLUTE)
+			{
+				nx = r == 0 ? 1 : 0;
+				ny = r == 0 ? 0 : 1;
+				error = r == 0 ? dx : dy;
+			}
+			else
+			{
+				nx = len > 0 ? dx / len : 1;
+				ny = len > 0 ? dy / len : 0;
+				error = len - j.length;
+			}
+			real bias = -bias_factor * inv_dt * error;
+			real lo = -1e30f, hi = 1e30f;
+			if(j.type == JOINT_ROPE)
+			{
+				hi = 0; // only pulls
+				if(error < 0)
+				{
+					bias = -error * inv_dt;
+					j.impulse[r] = 0;
+				}
+			}
+			real rna = rax * ny - ray * nx, rnb = rbx * ny - rby * nx;
+			real k_n = A.inv_mass + B.inv_mass + A.inv_inertia * rna * rna + B.inv_inertia * rnb * rnb;
+			rows.a[i] = sa;
+			rows.b[i] = sb;
+			rows.nx[i] = nx;
+			rows.ny[i] = ny;
+			rows.rax[i] = rax;
+			rows.ray[i] = ray;
+			rows.rbx[i] = rbx;
+			rows.rby[i] = rby;
+			rows.mass[i] = k_n > 0 ? 1 / k_n : 0;
+			rows.bias[i] = bias;
+			rows.lo[i] = lo;
+			rows.hi[i] = hi;
+			rows.impulse[i] = j.impulse[r];
+
+			real px = j.impulse[r] * nx, py = j.impulse[r] * ny;
+			A.vx -= A.inv_mass * px;
+			A.vy -= A.inv_mass * py;
+			A.w -= A.inv_inertia * (rax * py - ray * px);
+			B.vx += B.inv_mass * px;
+			B.vy += B.inv_mass * py;
+			B.w += B.inv_inertia * (rbx * py - rby * px);
+		}
+	}
+}
+
+/* One sweep over every contact point of the island: normal impulse kept
+ * pushing (>= 0), friction within friction * normal impulse, both clamped
+ * on the totals so earlier sweeps can be undone */
+void RigidWorld::solveVelocities(const Island& isl)
+{
+	for(int q = isl.first_contact; q < isl.first_contact + isl.contact_count; q++)
+	{
+		Manifold& m = manifolds[island_contacts[q]];
+		SolverBody& A = solver[m.sa];
+		SolverBody& B = solver[m.sb];
+		real tx = m.ny, ty = -m.nx;
+		for(int i = 0; i < m.count; i++)
+		{
+			ContactPoint& p = m.points[i];
+			real dvx = B.vx - B.w * p.rby - A.vx + A.w * p.ray;
+			real dvy = B.vy + B.w * p.rbx - A.vy - A.w * p.rax;
+			real vn = dvx * m.nx + dvy * m.ny;
+			real pn = p.pn + p.mass_n * (p.bias - vn);
+			if(pn < 0)
+				pn = 0;
+			real dp = pn - p.pn;
+			p.pn = pn;
+			real px = dp * m.nx, py = dp * m.ny;
+			A.vx -= A.inv_mass * px;
+			A.vy -= A.inv_mass * py;
+			A.w -= A.inv_inertia * (p.rax * py - p.ray * px);
+			B.vx += B.inv_mass * px;
+			B.vy += B.inv_mass * py;
+			B.w += B.inv_inertia * (p.rbx * py - p.rby * px);
+
+			dvx = B.vx - B.w * p.rby - A.vx + A.w * p.ray;
+			dvy = B.vy + B.w * p.rbx - A.vy - A.w * p.rax;
+			real vt = dvx * tx + dvy * ty + p.surface;
+			real max_t = m.friction * p.pn;
+			real pt = p.pt - p.mass_t * vt;
+			pt = pt < -max_t ? -max_t : (pt > max_t ? max_t : pt);
+			dp = pt - p.pt;
+			p.pt = pt;
+			px = dp * tx;
+			py = dp * ty;
+			A.vx -= A.inv_mass * px;
+			A.vy -= A.inv_mass * py;
+			A.w -= A.inv_inertia * (p.rax * py - p.ray * px);
+			B.vx += B.inv_mass * px;
+			B.vy += B.inv_mass * py;
+			B.w += B.inv_inertia * (p.rbx * py - p.rby * px);
+		}
+	}
+}
+
+/* Copies the velocities of the island back from solver and moves its
+ * bodies. The tree is left to step(), which is not run in parallel. */
+void RigidWorld::integrate(const Island& isl, real dt)
+{
+	for(int q = isl.first_body; q < isl.first_body + isl.body_count; q++)
+	{
+		int i = island_bodies[q];
+		RigidBody& b = bodies[i];
+		b.vx = solver[i].vx;
+		b.vy = solver[i].vy;
+		b.w = solver[i].w;
+		b.x += b.vx * dt;
+		b.y += b.vy * dt;
+		b.angle += b.w * dt;
+		b.c = cos(b.angle);
+		b.s = sin(b.angle);
+	}
+}
+
+void RigidWorld::islandJob(void* world, int k)
+{
+	((RigidWorld*)world)->solveIsland(k);
+}
+
+void RigidWorld::solveIsland(int k)
+{
+	const Island& isl = islands[k];
+	real dt = step_dt;
+	for(int q = isl.first_body; q < isl.first_body + isl.body_count; q++)
+		bodies[island_bodies[q]].vy -= gravity * dt;
+	preStep(k, 1 / dt);
+	prepareJoints(k, 1 / dt);
+	for(int it = 0; it < iterations; it++)
+	{
+		rows.solve(&solver[0], isl.first_row, isl.first_row + isl.row_count);
+		solveVelocities(isl);
+	}
+	for(int q = isl.first_joint; q < isl.first_joint + isl.joint_count; q++)
+	{
+		Joint& j = joints[island_joints[q]];
+		for(int r = 0; r < 2; r++)
+			if(j.slot[r] >= 0)
+				j.impulse[r] = rows.impulse[j.slot[r]];
+	}
+	integrate(isl, dt);
+}
+
+/* Counts how long every body of each island has been nearly still and puts
+ * the islands still for time_to_sleep to sleep, with their contacts. The
+ * others are the awake bodies of the next step. */
+void RigidWorld::sleepIslands(real dt)
+{
+	awake.clear();
+	int slept = 0;
+	for(int k = 0; k < (int)islands.size(); k++)
+	{
+		const Island& isl = islands[k];
+		real still = time_to_sleep;
+		for(int q = isl.first_body; q < isl.first_body + isl.body_count; q++)
+		{
+			RigidBody& b = bodies[island_bodies[q]];
+			if(b.vx * b.vx + b.vy * b.vy > sleep_linear * sleep_linear || b.w * b.w > sleep_angular * sleep_angular)
+				b.sleep_time = 0;
+			else
+				b.sleep_time += dt;
+			if(b.sleep_time < still)
+				still = b.sleep_time;
+		}
+		if(still < time_to_sleep)
+		{
+			awake.insert(awake.end(), island_bodies.begin() + isl.first_body, island_bodies.begin() + isl.first_body + isl.body_count);
+			continue;
+		}
+		sleeping.push_back(SleepingIsland());
+		SleepingIsland& s = sleeping.back();
+		for(int q = isl.first_body; q < isl.first_body + isl.body_count; q++)
+		{
+			RigidBody& b = bodies[island_bodies[q]];
+			b.vx = b.vy = b.w = 0;
+			b.island = (int)sleeping.size() - 1;
+			s.bodies.push_back(island_bodies[q]);
+		}
+		for(int q = isl.first_contact; q < isl.first_contact + isl.contact_count; q++)
+		{
+			Manifold& m = manifolds[island_contacts[q]];
+			s.manifolds.push_back(m);
+			m.count = 0; // dropped below
+			slept++;
+		}
+	}
+	if(slept == 0)
+		return;
+	int n = 0;
+	for(int k = 0; k < (int)manifolds.size(); k++)
+		if(manifolds[k].count > 0)
+			manifolds[n++] = manifolds[k];
+	manifolds.resize(n);
+}
+
+/* Lists in broken the breakable bodies whose contacts of this step took
+ * more normal impulse than their strength. A block resting under a stack
+ * takes only the weight above it times dt. */
+void RigidWorld::findBroken()
+{
+	if(breakable == 0)
+		return;
+	for(int k = 0; k < (int)manifolds.size(); k++)
+	{
+		const Manifold& m = manifolds[k];
+		real pn = 0;
+		for(int i = 0; i < m.count; i++)
+			pn += m.points[i].pn;
+		if((bodies[m.a].flags & BODY_BREAKABLE) && pn >= bodies[m.a].strength)
+			broken.push_back(m.a);
+		if(m.b >= 0 && (bodies[m.b].flags & BODY_BREAKABLE) && pn >= bodies[m.b].strength)
+			broken.push_back(m.b);
+	}
+	sort(broken.begin(), broken.end());
+	broken.erase(unique(broken.begin(), broken.end()), broken.end());
+}
+
+void RigidWorld::step(real dt)
+{
+	broken.clear();
+	if(awake.empty() || dt <= 0)
+		return;
+	updateContacts();
+	buildIslands();
+	solver.resize(bodies.size() + islands.size());
+	step_dt = dt;
+	job_pool.run((int)islands.size(), islandJob, this);
+	for(int q = 0; q < (int)island_bodies.size(); q++)
+	{
+		const RigidBody& b = bodies[island_bodies[q]];
+		tree.move(b.leaf, bounds(island_bodies[q]), b.vx * dt, b.vy * dt);
+	}
+	findBroken();
+	sleepIslands(dt);
+	// Debris that fell off the level would fall for ever
+	for(int q = (int)awake.size() - 1; q >= 0; q--)
+		if((bodies[awake[q]].flags & BODY_DEBRIS) && bodies[awake[q]].y < debris_floor)
+			remove(awake[q]);
+}
+
+int RigidWorld::collideCircle(real x, real y, real r, real m, real e, real mu, real dt, real* vx, real* vy, real* nx, real* ny, real* speed)
+{
+	Box region = { x - r, x + r, y - r, y + r };
+	query(region, found);
+	ShapeView circle = { x, y, 1, 0, r, r, SHAPE_CIRCLE };
+	int best = -1;
+	real best_j = 0;
+	for(int k = 0; k < (int)found.size(); k++)
+	{
+		RigidBody& b = bodies[found[k]];
+		if(b.flags & BODY_DEBRIS)
+			continue;
+		Manifold c;
+		if(!collide(bodyView(b), circle, &c))
+			continue;
+		const ContactPoint& p = c.points[0];
+		real rx = p.x - b.x, ry = p.y - b.y;
+		// Velocity of the circle relative to the point of the body
+		real dvx = *vx - (b.vx - b.w * ry), dvy = *vy - (b.vy + b.w * rx);
+		real vn = dvx * c.nx + dvy * c.ny;
+		real overlap = -p.separation - slop;
+		real target = vn < 0 ? -e * vn : 0;
+		if(overlap > 0 && bias_factor * overlap / dt > target)
+			target = bias_factor * overlap / dt;
+		if(vn >= target)
+			continue;
+		wake(found[k]);
+		real rn = rx * c.nx + ry * c.ny;
+		real k_n = 1 / m + b.inv_mass + b.inv_inertia * (rx * rx + ry * ry - rn * rn);
+		real j = (target - vn) / k_n;
+		real tx = c.ny, ty = -c.nx;
+		real rt = rx * tx + ry * ty;
+		real k_t = 1 / m + b.inv_mass + b.inv_inertia * (rx * rx + ry * ry - rt * rt);
+		real jt = -(dvx * tx + dvy * ty) / k_t;
+		jt = jt < -mu * j ? -mu * j : (jt > mu * j ? mu * j : jt);
+
+		real px = j * c.nx + jt * tx, py = j * c.ny + jt * ty;
+		*vx += px / m;
+		*vy += py / m;
+		b.vx -= b.inv_mass * px;
+		b.vy -= b.inv_mass * py;
+		b.w -= b.inv_inertia * (rx * py - ry * px);
+		if(j > best_j)
+		{
+			best_j = j;
+			best = found[k];
+			*nx = c.nx;
+			*ny = c.ny;
+			*speed = vn < 0 ? -vn : 0;
+		}
+	}
+	return best;
+}
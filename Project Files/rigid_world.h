@@ -0,0 +1,275 @@
+#ifndef RIGID_WORLD_H
+#define RIGID_WORLD_H
+
+#include <vector>
+
+#include "collision.h"
+#include "aabb_tree.h"
+#include "constraint_batch.h"
+#include "impulse_batch.h"
+
+/* Blocks that can be knocked over: oriented boxes and circles with mass,
+ * resting on each other and on the static level (obstacles.h). Contacts
+ * are found with SAT and clipping, at most two points per pair, and
+ * resolved with sequential impulses (Box2D Lite). Contacts are kept from
+ * one step to the next in one flat array sorted by pair, and the impulses
+ * found last step are applied first (warm starting), which is what lets
+ * tall stacks stand.
+ *
+ * Bodies touching each other form islands, solved one at a time. An island
+ * whose bodies all stayed nearly still for time_to_sleep goes to sleep: its
+ * bodies stop moving, its contacts are put aside with their impulses, and
+ * it costs nothing until an awake body or the ball touches it, which wakes
+ * the whole island.
+ *
+ * Joints tie two bodies, or a body and a point of the world, into planks,
+ * ropes and hinges. Each is one or two rows of a ConstraintBatch, coloured
+ * so that rows sharing a moving body never land in the same group of 8,
+ * and solved with the contacts in every iteration. Joined bodies don't
+ * collide with each other and are in the same island. Islands share no
+ * moving body, so they are solved in parallel on job_pool (job_pool.h);
+ * each writes only its own bodies, contacts and solver rows, and
+ * everything shared (the tree, sleeping) is updated afterwards in island
+ * order, so the result doesn't depend on the number of threads.
+ *
+ * Breakable blocks that take a harder hit than their strength are listed in
+ * broken after the step; fracture.h shatters them into debris, bodies taken
+ * from a fixed pool that reuses the oldest pieces once it is full.
+ *
+ * A blast (radialImpulse) finds the bodies it reaches with one query of
+ * the tree and works out all their pushes at once in an ImpulseBatch. No
+ * OpenGL in here. */
+
+/* RigidBody::shape */
+#define SHAPE_BOX 0
+#define SHAPE_CIRCLE 1
+
+/* RigidBody::flags */
+#define BODY_BREAKABLE 1   // shatters when hit harder than its strength (fracture.h)
+#define BODY_DEBRIS 2      // a piece of a shattered block, from the debris pool
+#define BODY_REMOVED 4     // out of the world: not moved, touched or drawn
+
+/* Joint::type */
+#define JOINT_DISTANCE 0   // anchors kept length apart, a rod or plank
+#define JOINT_ROPE 1       // anchors kept at most length apart
+#define JOINT_REVOLUTE 2   // anchors kept together, a hinge
+
+/* Joint rows coloured past this many colours get a group of their own */
+#define JOINT_COLORS 32
+
+struct RigidBody {
+	real x, y;        // centre
+	real angle;       // radians
+	real c, s;        // cos and sin of angle
+	real vx, vy, w;
+	real hx, hy;      // half extents; hx is the radius of a circle
+	int shape;
+	real inv_mass;    // 0 for a body that never moves
+	real inv_inertia;
+	real friction;
+	float color[3];
+	int leaf;         // in the world's tree
+	int island;       // in the world's sleeping islands, -1 while awake
+	real sleep_time;  // how long it has been nearly still
+	int flags;        // BODY_*
+	real strength;    // impulse that shatters a breakable body
+	int pattern, cell; // fracture pattern and cell a piece of debris is drawn as
+	int entity;       // slot of a piece of debris in entities (entities.h), -1 if none
+};
+
+struct ContactPoint {
+	real x, y;        // where the bodies touch
+	real separation;  // negative when they overlap
+	real pn, pt;      // accumulated normal and friction impulses
+	real mass_n, mass_t;
+	real bias;        // velocity pushing overlapping bodies apart
+	real surface;     // velocity of a kinematic level box along the tangent
+	real rax, ray;    // from the centre of a to the point
+	real rbx, rby;
+	int id;           // edges that made the point, to find it again next step
+};
+
+/* The part of a body the solver works on, packed so the contact loops run
+ * over a small array. Fixed bodies and the level use a zero row of their
+ * island. */
+struct SolverBody {
+	real vx, vy, w;
+	real inv_mass, inv_inertia;
+};
+
+/* Contacts between a and b. b < 0 is the level box obstacles[-1 - b]. */
+struct Manifold {
+	int a, b;
+	real nx, ny;      // normal from a to b
+	real friction;
+	int count;
+	int sa, sb;       // rows of a and b in the solver, set before solving
+	ContactPoint points[2];
+};
+
+struct Joint {
+	int type;
+	int a, b;          // bodies; b < 0 holds a to a point of the world
+	real lax, lay;     // anchor on a, in the frame of a
+	real lbx, lby;     // anchor on b in the frame of b, or the point of the world
+	real length;       // of a rod or rope
+	real impulse[2];   // accumulated, kept for warm starting: along the joint, or x and y of a hinge
+	int color[2];      // colour of each row, -1 for a row the type doesn't use
+	int slot[2];       // rows in the constraint batch during a step
+};
+
+/* Bodies, contacts, joints and joint rows of one island of the last step,
+ * as ranges of the world's island_bodies, island_contacts, island_joints
+ * and rows */
+struct Island {
+	int first_body, body_count;
+	int first_contact, contact_count;
+	int first_joint, joint_count;
+	int first_row, row_count;
+};
+
+/* An island put to sleep, with the contacts it had so they start from
+ * the same impulses when it wakes */
+struct SleepingIsland {
+	std::vector<int> bodies;
+	std::vector<Manifold> manifolds;
+};
+
+class RigidWorld {
+public:
+	std::vector<RigidBody> bodies;
+	std::vector<Manifold> manifolds;  // of the awake bodies, sorted by (a, b)
+	std::vector<Joint> joints;
+	std::vector<int> broken; // breakable bodies hit harder than their strength in the last step
+	real gravity;        // downwards
+	int iterations;      // velocity iterations per step
+	real bias_factor;    // share of the overlap removed per step
+	real slop;           // overlap left alone, keeps resting contacts steady
+	real level_friction; // friction of the level boxes
+	real sleep_linear;   // speed below which a body counts as still
+	real sleep_angular;  // same for turning, radians per second
+	real time_to_sleep;  // seconds an island must be still to sleep
+	int debris_capacity; // pieces of debris alive at once
+	real debris_floor;   // debris falling below it is taken away
+
+	int size() const { return (int)bodies.size(); }
+	/* Bodies of the level, leaving out the slots of the debris pool */
+	int levelBodies() const { return (int)bodies.size() - (int)debris.size(); }
+	/* Box of w by h centred at (x, y), turned by angle, density per unit
+	 * area. Density 0 makes a body that never moves. Returns its index. */
+	int addBox(real x, real y, real w, real h, real angle, real density, float red, float green, float blue);
+	int addCircle(real x, real y, real radius, real density, float red, float green, float blue);
+	/* Joints from the point (ax, ay) of body a to the point (bx, by) of
+	 * body b, or of the world if b is -1. A rope of length <= 0 gets the
+	 * distance between the points. Return the index of the joint. */
+	int addDistanceJoint(int a, int b, real ax, real ay, real bx, real by);
+	int addRopeJoint(int a, int b, real ax, real ay, real bx, real by, real length);
+	/* Hinge between a and b (or the world) at the point (x, y) */
+	int addRevoluteJoint(int a, int b, real x, real y);
+	/* Makes body i breakable by an impulse of strength */
+	void setStrength(int i, real strength);
+	/* Takes body i out of the world, waking the bodies it touched, and drops
+	 * its joints. Its index stays taken. */
+	void remove(int i);
+	/* Makes the debris_capacity slots of the debris pool after the bodies
+	 * already there, taken away, so addDebris() never allocates. Call it
+	 * once the level is built; slots already made are kept. */
+	void reserveDebris();
+	/* Box of debris like addBox, moving at (vx, vy) and turning at spin, in
+	 * the next slot of the pool, taking the oldest piece away if it is
+	 * still there. -1 if the pool has no slots. */
+	int addDebris(real x, real y, real w, real h, real angle, real vx, real vy, real spin, real density, const float color[3]);
+	void clear();
+	/* Puts every body back where it was added, at rest and awake, and takes
+	 * the debris away */
+	void restart();
+	/* Wakes the island of body i if it is asleep */
+	void wake(int i);
+	int isAwake(int i) const { return bodies[i].inv_mass > 0 && bodies[i].island < 0 && !(bodies[i].flags & BODY_REMOVED); }
+	int awakeCount() const { return (int)awake.size(); }
+	int sleepingIslands() const { return (int)sleeping.size(); }
+	/* Islands solved by the last step */
+	int islandCount() const { return (int)islands.size(); }
+
+	/* Advances every awake body by dt. Does nothing when all are asleep. */
+	void step(real dt);
+
+	/* Box around body i */
+	Box bounds(int i) const;
+	/* Bodies whose box overlaps region, ascending, in out. Returns how many. */
+	int query(const Box& region, std::vector<int>& out);
+
+	/* Circle of radius r and mass m at (x, y), moving at (*vx, *vy), against
+	 * the bodies it overlaps: each contact closing (or overlapping more than
+	 * slop) gets an impulse with restitution e and friction mu on both the
+	 * circle and the body, waking it. Debris is left alone. The circle
+	 * itself is not moved. Returns the body of the strongest contact, -1
+	 * if none; its normal (from the body to the circle) in (*nx, *ny) and
+	 * the closing speed in *speed. */
+	int collideCircle(real x, real y, real r, real m, real e, real mu, real dt, real* vx, real* vy, real* nx, real* ny, real* speed);
+
+	/* Blast of radius at (x, y): every moving body whose centre is closer
+	 * is woken and pushed away from (x, y), by peak at the centre falling
+	 * off to nothing at radius. Breakable bodies pushed harder than their
+	 * strength go in shattered, ascending, for the caller to break.
+	 * Returns the bodies pushed. */
+	int radialImpulse(real x, real y, real radius, real peak, std::vector<int>& shattered);
+
+	/* Number of contact points, asleep or not */
+	int contactCount() const;
+
+private:
+	AabbTree tree;
+	std::vector<RigidBody> initial;
+	std::vector<Joint> initial_joints;
+	std::vector<int> debris;          // slots of the debris pool, in bodies
+	int debris_next;                  // oldest slot, reused next once the pool is full
+	int breakable;                    // breakable bodies ever added
+	std::vector<Manifold> previous;
+	std::vector<Manifold> woken;     // contacts of the islands woken since the last step
+	std::vector<std::pair<int, int> > candidates;
+	std::vector<int> found;
+	ImpulseBatch blast;               // bodies reached by the last radialImpulse()
+	std::vector<SolverBody> solver;  // one per body, then one per island for the level and fixed bodies
+	real step_dt;                    // of the step being solved
+	std::vector<int> awake;          // bodies that move, by island
+	std::vector<Island> islands;     // awake islands of the last step
+	std::vector<int> island_bodies;
+	std::vector<int> island_contacts; // in manifolds
+	std::vector<int> island_joints;   // in joints
+	ConstraintBatch rows;             // of the joints of the awake islands, island by island
+	std::vector<unsigned int> colors_used; // per body, bit c set if a row of colour c moves it
+	std::vector<std::pair<int, int> > joined; // pairs of joined bodies, sorted
+	int joints_coloured;              // 0 after joints changed
+	std::vector<SleepingIsland> sleeping;
+	std::vector<int> mark;           // per body, == mark_stamp once it looked for contacts
+	int mark_stamp;
+	std::vector<int> parent;         // per body, union-find of the islands
+	std::vector<int> island_of;      // per body, in islands
+	std::vector<int> contact_island; // per manifold, in islands
+
+	int add(const RigidBody& b);
+	void place(int i, const RigidBody& b);
+	static RigidBody boxBody(real x, real y, real w, real h, real angle, real density, const float color[3]);
+	void findBroken();
+	int addJoint(int type, int a, int b, real ax, real ay, real bx, real by, real length);
+	void colorJoints();
+	int jointIsland(const Joint& j) const;
+	void layoutJoints();
+	void prepareJoints(int k, real inv_dt);
+	void updateContacts();
+	void buildIslands();
+	static void islandJob(void* world, int k);
+	void solveIsland(int k);
+	void preStep(int k, real inv_dt);
+	void solveVelocities(const Island& isl);
+	void integrate(const Island& isl, real dt);
+	void sleepIslands(real dt);
+
+public:
+	RigidWorld();
+};
+
+extern RigidWorld rigid_world;
+
+#endif
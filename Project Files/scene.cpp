@@ -0,0 +1,77 @@
+#include "scene.h"
+#include "simulation.h"
+
+using namespace std;
+
+Scene scene;
+
+int Scene::archetype(unsigned int mask)
+{
+	for(int a = 0; a < (int)archetypes.size(); a++)
+		if(archetypes[a].mask == mask)
+			return a;
+	Archetype a = Archetype();
+	a.mask = mask;
+	archetypes.push_back(a);
+	return (int)archetypes.size() - 1;
+}
+
+/* Only the columns of the components in the mask grow */
+SceneObject Scene::add(unsigned int mask)
+{
+	SceneObject o;
+	o.archetype = archetype(mask);
+	Archetype& a = archetypes[o.archetype];
+	o.row = a.count++;
+	if(mask & COMPONENT_TRANSFORM)
+	{
+		a.x.push_back(0);
+		a.y.push_back(0);
+		a.angle.push_back(0);
+		a.scale.push_back(1);
+	}
+	if(mask & COMPONENT_MESH)
+	{
+		a.mesh.push_back(-1);
+		a.layer.push_back(0);
+		a.visible.push_back(1);
+	}
+	if(mask & COMPONENT_AIM)
+		a.aim.push_back(0);
+	return o;
+}
+
+void Scene::clear()
+{
+	for(int k = 0; k < (int)archetypes.size(); k++)
+	{
+		unsigned int mask = archetypes[k].mask;
+		archetypes[k] = Archetype();
+		archetypes[k].mask = mask;
+	}
+}
+
+void updateScene(float alpha, int ball_flying)
+{
+	float bx = prev_x_cannonball + alpha * (x_cannonball - prev_x_cannonball);
+	float by = prev_y_cannonball + alpha * (y_cannonball - prev_y_cannonball);
+	for(int k = 0; k < (int)scene.archetypes.size(); k++)
+	{
+		Archetype& a = scene.archetypes[k];
+		if(!(a.mask & COMPONENT_TRANSFORM))
+			continue;
+		if(a.mask & COMPONENT_AIM)
+			for(int i = 0; i < a.count; i++)
+				a.angle[i] = (float)thita + a.aim[i];
+		if(a.mask & COMPONENT_BALL)
+			for(int i = 0; i < a.count; i++)
+			{
+				a.x[i] = bx;
+				a.y[i] = by;
+				a.scale[i] = (float)ball_radius;
+			}
+		if((a.mask & COMPONENT_BALL) && (a.mask & COMPONENT_MESH))
+			for(int i = 0; i < a.count; i++)
+				a.visible[i] = ball_flying;
+	}
+}
@@ -0,0 +1,63 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <vector>
+
+/* What the window draws, as data: a scene for rendering only. An object is
+ * a row of the archetype holding exactly its set of components, and each
+ * component is a column of that archetype, so a system walks the columns
+ * it needs from the first row to the last. The cannon, the ball and the
+ * layers of the level are rows game.cpp adds at startup; a second cannon
+ * would be one more row, not one more draw function.
+ *
+ * There are no collider or gameplay components. The physics and the
+ * collision tests walk their own tables (obstacles.h, rigid_world.h,
+ * targets.h, entities.h), which the scene draws as one mesh each on a row
+ * at the origin, and a box of the level is added there, not here. No
+ * OpenGL in here: a mesh is an index into the mesh table of game.cpp. */
+
+/* Bits of Archetype::mask */
+#define COMPONENT_TRANSFORM 1   // x, y, angle, scale
+#define COMPONENT_MESH 2        // mesh, layer, visible
+#define COMPONENT_AIM 4         // turned with the cannon
+#define COMPONENT_BALL 8        // where the ball is, ball_radius big, shown while it flies
+
+struct Archetype {
+	unsigned int mask;
+	int count;                             // rows
+	std::vector<float> x, y;               // COMPONENT_TRANSFORM
+	std::vector<float> angle;              // degrees anticlockwise
+	std::vector<float> scale;
+	std::vector<int> mesh;                 // COMPONENT_MESH: index in the meshes of game.cpp
+	std::vector<int> layer;                // drawn after every lower layer
+	std::vector<char> visible;
+	std::vector<float> aim;                // COMPONENT_AIM: degrees added to the cannon angle
+};
+
+/* Row of an object */
+struct SceneObject {
+	int archetype;
+	int row;
+};
+
+class Scene {
+public:
+	std::vector<Archetype> archetypes;
+
+	/* Index of the archetype of mask, made the first time */
+	int archetype(unsigned int mask);
+	/* New row in the archetype of mask: at the origin, unturned, scale 1,
+	 * visible, mesh -1 in layer 0 */
+	SceneObject add(unsigned int mask);
+	/* Removes every object, keeping the archetypes */
+	void clear();
+};
+
+extern Scene scene;
+
+/* Turns COMPONENT_AIM rows to the cannon angle and puts COMPONENT_BALL
+ * rows alpha of the way from where the ball was a step ago to where it
+ * is, hidden unless ball_flying */
+void updateScene(float alpha, int ball_flying);
+
+#endif
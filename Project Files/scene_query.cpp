@@ -0,0 +1,129 @@
+#include <cmath>
+
+#include "scene_query.h"
+#include "obstacles.h"
+
+using namespace std;
+
+static vector<int> candidates;
+
+/* Fraction of the segment at which it enters b through a face, or -1 if it
+ * misses b or starts inside it. (*nx, *ny) is the normal of that face. */
+static real segmentBox(const Box& b, real x0, real y0, real dx, real dy, real* nx, real* ny)
+{
+	real enter = -1e30f, leave = 1e30f;
+	real enx = 0, eny = 0;
+	if(dx == 0)
+	{
+		if(x0 < b.xmin || x0 > b.xmax)
+			return -1;
+	}
+	else
+	{
+		real ta = (b.xmin - x0) / dx, tb = (b.xmax - x0) / dx;
+		real n = -1;
+		if(ta > tb) { real tmp = ta; ta = tb; tb = tmp; n = 1; }
+		if(ta > enter) { enter = ta; enx = n; eny = 0; }
+		if(tb < leave) leave = tb;
+	}
+	if(dy == 0)
+	{
+		if(y0 < b.ymin || y0 > b.ymax)
+			return -1;
+	}
+	else
+	{
+		real ta = (b.ymin - y0) / dy, tb = (b.ymax - y0) / dy;
+		real n = -1;
+		if(ta > tb) { real tmp = ta; ta = tb; tb = tmp; n = 1; }
+		if(ta > enter) { enter = ta; enx = 0; eny = n; }
+		if(tb < leave) leave = tb;
+	}
+	if(enter > leave || enter < 0 || enter > 1)
+		return -1;
+	*nx = enx;
+	*ny = eny;
+	return enter;
+}
+
+int raycast(real x0, real y0, real dx, real dy, QueryHit* hit)
+{
+	hit->body = -1;
+	sweepObstacles(x0, y0, dx, dy, (real)1e-3f, candidates);
+	for(int k = 0; k < (int)candidates.size(); k++)
+	{
+		real nx, ny;
+		real t = segmentBox(obstacles[candidates[k]].box, x0, y0, dx, dy, &nx, &ny);
+		if(t >= 0 && (hit->body < 0 || t < hit->t))
+		{
+			hit->body = candidates[k];
+			hit->t = t;
+			hit->nx = nx;
+			hit->ny = ny;
+		}
+	}
+	if(hit->body < 0)
+		return 0;
+	hit->x = x0 + dx * hit->t;
+	hit->y = y0 + dy * hit->t;
+	return 1;
+}
+
+/* The path is cut into pieces short enough that the parabola stays close
+ * to the chord (sag at most half a grid cell) and the chord crosses only a
+ * few cells; each piece is one sweepObstacles() call and exact contacts
+ * with what it returns. */
+int castCircle(const BallPath& p, real radius, real t0, real t1, QueryHit* hit)
+{
+	hit->body = -1;
+	Box level = levelBounds();
+	real h_sag = p.g > 0 ? sqrt(4 * grid_cell / p.g) : 1e30f;
+	real ta = t0;
+	while(ta < t1)
+	{
+		real xa, ya, vxa, vya;
+		pathPosition(p, ta, &xa, &ya);
+		pathVelocity(p, ta, &vxa, &vya);
+		// Below every box and falling, or beside them all and moving away
+		if((ya + radius < level.ymin && vya <= 0) || (xa - radius > level.xmax && vxa >= 0) || (xa + radius < level.xmin && vxa <= 0))
+			return 0;
+
+		real speed = fabs(vxa) + fabs(vya) + 1e-6f;
+		real h = 2 * grid_cell / speed;
+		if(h > h_sag)
+			h = h_sag;
+		real tb = ta + h < t1 ? ta + h : t1;
+
+		real xb, yb;
+		pathPosition(p, tb, &xb, &yb);
+		real sag = fabs(p.g) * (tb - ta) * (tb - ta) / 8;
+		sweepObstacles(xa, ya, xb - xa, yb - ya, radius + sag + 1e-3f, candidates);
+		for(int k = 0; k < (int)candidates.size(); k++)
+		{
+			real nx, ny;
+			real t = impactCircleBox(p, radius, ta, tb, obstacles[candidates[k]].box, &nx, &ny);
+			if(t >= 0 && (hit->body < 0 || t < hit->t))
+			{
+				hit->body = candidates[k];
+				hit->t = t;
+				hit->nx = nx;
+				hit->ny = ny;
+			}
+		}
+		if(hit->body >= 0)
+		{
+			pathPosition(p, hit->t, &hit->x, &hit->y);
+			hit->x -= radius * hit->nx;
+			hit->y -= radius * hit->ny;
+			return 1;
+		}
+		ta = tb;
+	}
+	return 0;
+}
+
+int queryPoint(real x, real y, vector<int>& out)
+{
+	Box b = { x, x, y, y };
+	return queryObstacles(b, out);
+}
@@ -0,0 +1,33 @@
+#ifndef SCENE_QUERY_H
+#define SCENE_QUERY_H
+
+#include <vector>
+
+#include "collision.h"
+
+/* Questions about the level that don't run the simulation: what a ray or a
+ * ball moving along a parabola hits first, what is at a point. They go
+ * through the same grid and tree as the ball physics (obstacles.h), so each
+ * one only looks at the boxes along the way. AABB queries are
+ * queryObstacles(). */
+
+struct QueryHit {
+	int body;      // index in obstacles, -1 if nothing was hit
+	real t;        // fraction of the ray, or time along the path
+	real x, y;     // point on the surface that was hit
+	real nx, ny;   // outward normal of the surface there
+};
+
+/* First box the segment from (x0, y0) to (x0 + dx, y0 + dy) enters.
+ * Boxes the segment starts inside are ignored. Returns 1 on a hit. */
+int raycast(real x0, real y0, real dx, real dy, QueryHit* hit);
+
+/* First box a circle of the given radius moving along p touches over
+ * [t0, t1], while moving towards it, the same contact the ball physics
+ * would find. Returns 1 on a hit. */
+int castCircle(const BallPath& p, real radius, real t0, real t1, QueryHit* hit);
+
+/* Boxes containing (x, y), ascending, in out. Returns how many. */
+int queryPoint(real x, real y, std::vector<int>& out);
+
+#endif
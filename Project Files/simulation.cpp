@@ -0,0 +1,1949 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include "simulation.h"
+#include "projectile_batch.h"
+#include "box_batch.h"
+#include "collision.h"
+#include "integrator.h"
+#include "detmath.h"
+#include "obstacles.h"
+#include "events.h"
+#include "targets.h"
+#include "rigid_world.h"
+#include "job_pool.h"
+#include "constraint_batch.h"
+#include "impulse_batch.h"
+#include "fracture.h"
+#include "kinematic.h"
+#include "entities.h"
+
+using namespace std;
+
+real u = 4.0;
+real g = 4.0;
+real thita = 45;
+real thita_ball = 45;
+int ball_in_play = 0;
+int fl = 0;
+real t = 0;
+real x_cannonball;
+real y_cannonball;
+real e = 0.6;
+real v = u;
+real ux;
+real uy;
+real vx = ux;
+real vy;
+real x_till_collision = -3.0f;
+real y_till_collision = -2.75f;
+real t_till_now = 0;
+int log_collisions = 1;
+real ball_radius = 0.15f;
+real ball_mass = 1.0f;
+real prev_x_cannonball;
+real prev_y_cannonball;
+real physics_hz = 240;
+real time_scale = 0.6f; // the old loop did t += 0.01 per frame at 60 fps
+real sim_dt = 0.0025f;
+int flight_integrator = FLIGHT_CLOSED_FORM;
+FlightParams flight_params = defaultFlightParams(g);
+real integrator_tol = 1e-4f;
+real mu = 0.3f;
+real rest_speed = 0.25f;
+int ball_asleep = 0;
+real sleep_energy = 0.02f;
+real sleep_time = 0.1f;
+static real rest_timer = 0;  // time the ball has been below sleep_energy
+static int rest_contact = 0;  // it touched something during that time
+int deterministic = 0;
+static real rk45_h = 0.0025f; // step suggested by the last RK45 step
+static real shot_time = 0;    // simulated time since the shot was fired
+static int riding = 0;        // the ball touched a moving kinematic box in this step
+static int touching = -1;     // box the ball slid or rested on in the last step, -1 if none
+static int touching_now = -1; // the same for this step
+int split_birds = 2;
+real split_spread = 12;
+real split_size = 0.7f;
+int entity_capacity = 512;
+static int ball_split = 0;    // the ball already split in this shot
+static int auto_split = 0;    // simulateShot() splits the ball at the top of its flight
+real blast_radius = 1.0f;
+real blast_impulse = 3.0f;
+static int auto_bomb = 0;     // simulateShot() blows the ball up at the first thing it touches
+
+/* Results of ballContact() */
+#define CONTACT_BOUNCE 0
+#define CONTACT_SLIDE 1
+#define CONTACT_REST 2
+
+/* Adds an event at time t of the current step to sim_events */
+static void pushEvent(int type, int body, real t, real x, real y, real nx, real ny, real speed)
+{
+	SimEvent ev = { type, body, shot_time + t, x, y, nx, ny, speed };
+	sim_events.push(ev);
+}
+
+/* Response of the ball moving at (*bvx, *bvy) when it touches box body at
+ * (x, y), time t of the step, on a surface with outward normal (nx, ny).
+ * Fast contacts bounce with restitution e and friction mu. Contacts slower
+ * than rest_speed don't bounce; when the surface can hold the ball against
+ * gravity (inside the friction cone) it slides along it, losing mu * g per
+ * second of the slide_time left in the step, until friction stops it.
+ * Every bounce is an EVENT_CONTACT; sliding or resting on a box is one
+ * when it begins, not every step it goes on. */
+static int ballContact(real* bvx, real* bvy, real nx, real ny, real slide_time, int body, real t, real x, real y)
+{
+	real closing = -(*bvx * nx + *bvy * ny);
+	if(closing >= rest_speed)
+	{
+		pushEvent(EVENT_CONTACT, body, t, x, y, nx, ny, closing);
+		applyContactImpulse(bvx, bvy, nx, ny, e, mu);
+		return CONTACT_BOUNCE;
+	}
+	if(body != touching && body != touching_now)
+		pushEvent(EVENT_CONTACT, body, t, x, y, nx, ny, closing);
+	touching_now = body;
+	applyContactImpulse(bvx, bvy, nx, ny, (real)0, mu);
+	if(ny <= 0 || fabs(nx) > mu * ny)
+		return CONTACT_BOUNCE;
+	if(applySlidingFriction(bvx, bvy, nx, ny, mu * g * ny * slide_time) > 0)
+		return CONTACT_SLIDE;
+	*bvx = 0;
+	*bvy = 0;
+	return CONTACT_REST;
+}
+
+/* ballContact() against box body, which may be a kinematic box moving at
+ * (vx, vy): the response is worked out on the velocity relative to it, and
+ * a ball it would stop rides it instead, sliding along with it. A riding
+ * ball is put back on the surface, or it would sink into the box by what
+ * it fell between two contacts. */
+static int boxContact(real* bvx, real* bvy, real nx, real ny, real slide_time, int body, real t, real* x, real* y)
+{
+	const Obstacle& o = obstacles[body];
+	if(o.vx == 0 && o.vy == 0)
+		return ballContact(bvx, bvy, nx, ny, slide_time, body, t, *x, *y);
+	real rvx = *bvx - o.vx, rvy = *bvy - o.vy;
+	int contact = ballContact(&rvx, &rvy, nx, ny, slide_time, body, t, *x, *y);
+	*bvx = rvx + o.vx;
+	*bvy = rvy + o.vy;
+	riding = 1;
+	if(contact != CONTACT_REST)
+		return contact;
+	Box now = { o.box.xmin + o.vx * t, o.box.xmax + o.vx * t, o.box.ymin + o.vy * t, o.box.ymax + o.vy * t };
+	real gap = boxDistance(now, *x, *y, &nx, &ny) - ball_radius;
+	if(gap < 0)
+	{
+		*x -= nx * gap;
+		*y -= ny * gap;
+	}
+	return CONTACT_SLIDE;
+}
+
+/* Boxes returned by the last queryObstacles() */
+static vector<int> nearby;
+
+/* The birds of splits, one ball each (Entity::lane), flown all at once by
+ * the ProjectileBatch kernel. The level is swept in advanceProjectile(),
+ * floor included, so the flock has no floor of its own. */
+static ProjectileBatch flock;
+
+/* Current flight of the ball as a BallPath */
+static BallPath currentPath()
+{
+	BallPath p;
+	p.x0 = x_till_collision;
+	p.y0 = y_till_collision;
+	p.vx = vx;
+	p.tx = t_till_now;
+	p.uy = uy;
+	p.g = g;
+	return p;
+}
+
+/* Fills nearby with every box a ball of radius moving along path over
+ * [t0, t1] can touch. The ball never gets further than g (t1 - t0)^2 / 8
+ * from the chord of its path, so a circle that much bigger moving along
+ * the chord touches all of them. */
+static void queryPath(const BallPath& path, real radius, real t0, real t1)
+{
+	real xa, ya, xb, yb;
+	pathPosition(path, t0, &xa, &ya);
+	pathPosition(path, t1, &xb, &yb);
+	real sag = fabs(path.g) * (t1 - t0) * (t1 - t0) / 8;
+	sweepObstacles(xa, ya, xb - xa, yb - ya, radius + sag + 1e-3f, nearby);
+}
+
+/* Earliest contact of a ball of radius moving along path with any solid
+ * box over [t0, t1], or -1. (*nx, *ny) is the normal at the contact and *body the
+ * box. s0 is the time of the step at t0, which says where the kinematic
+ * boxes are: each is swept in its own frame, where it stands still and the
+ * ball moves along the path minus the box's velocity. */
+static real sweepBall(const BallPath& path, real radius, real t0, real t1, real s0, real* nx, real* ny, int* body)
+{
+	real t_hit = -1;
+	queryPath(path, radius, t0, t1);
+	for(int k = 0; k < (int)nearby.size(); k++)
+	{
+		if(obstacles[nearby[k]].state == OBSTACLE_KINEMATIC)
+			continue;
+		real bnx, bny;
+		real h = sweepCircleBox(path, radius, t0, t1, obstacles[nearby[k]].box, &bnx, &bny);
+		if(h >= 0 && (t_hit < 0 || h < t_hit))
+		{
+			t_hit = h;
+			*nx = bnx;
+			*ny = bny;
+			*body = nearby[k];
+		}
+	}
+	for(int k = 0; k < (int)kinematics.size(); k++)
+	{
+		const Obstacle& o = obstacles[kinematics[k].obstacle];
+		if(o.state != OBSTACLE_KINEMATIC)
+			continue;
+		// Where the ball is seen from the box, which is at o.box at the
+		// start of the step
+		BallPath rel = path;
+		rel.x0 -= o.vx * (s0 - t0 + path.tx);
+		rel.vx -= o.vx;
+		rel.y0 -= o.vy * (s0 - t0);
+		rel.uy -= o.vy;
+		Box reach = pathBounds(rel, t0, t1, radius + 1e-3f);
+		if(reach.xmax < o.box.xmin || reach.xmin > o.box.xmax || reach.ymax < o.box.ymin || reach.ymin > o.box.ymax)
+			continue;
+		real bnx, bny;
+		real h = sweepCircleBox(rel, radius, t0, t1, o.box, &bnx, &bny);
+		if(h >= 0 && (t_hit < 0 || h < t_hit))
+		{
+			t_hit = h;
+			*nx = bnx;
+			*ny = bny;
+			*body = kinematics[k].obstacle;
+		}
+	}
+	return t_hit;
+}
+
+/* A ball of radius and mass at (x, y) moving at (*bvx, *bvy) against the
+ * blocks of rigid_world, at the end of a step: the blocks it overlaps get
+ * pushed and the ball bounces off them. A breakable block hit harder than
+ * its strength shatters instead and the ball goes on through it, slowed by
+ * the impulse it took. Returns 1 if it touched one. */
+static int hitBodies(real x, real y, real radius, real mass, real* bvx, real* bvy)
+{
+	if(rigid_world.size() == 0)
+		return 0;
+	real nx, ny, speed;
+	real vx0 = *bvx, vy0 = *bvy;
+	int body = rigid_world.collideCircle(x, y, radius, mass, e, mu, sim_dt, bvx, bvy, &nx, &ny, &speed);
+	if(body < 0)
+		return 0;
+	pushEvent(EVENT_BODY, body, sim_dt, x, y, nx, ny, speed);
+	const RigidBody& b = rigid_world.bodies[body];
+	if((b.flags & BODY_BREAKABLE) && mass * speed >= b.strength)
+	{
+		*bvx = vx0 + nx * b.strength / mass;
+		*bvy = vy0 + ny * b.strength / mass;
+		pushEvent(EVENT_BREAK, body, sim_dt, x, y, nx, ny, speed);
+		shatterBody(body, vx0, vy0);
+	}
+	return 1;
+}
+
+/* Breaks the targets hit since cursor into debris, carried on by what hit
+ * them, moving at (bvx, bvy) */
+static void shatterTargets(unsigned int cursor, real bvx, real bvy)
+{
+	static const float black[3] = { 0, 0, 0 };
+	SimEvent ev;
+	while(sim_events.read(&cursor, &ev))
+		if(ev.type == EVENT_TARGET)
+			shatterBox(targets[ev.body].box, bvx, bvy, black);
+}
+
+/* Launch velocity of a shot at speed and angle (degrees). The deterministic
+ * mode uses detmath so the result does not depend on the libm. */
+static void launchVelocity(real speed, real angle, real* lvx, real* lvy)
+{
+	if(deterministic)
+	{
+		real s, c;
+		detSinCosDeg(angle, &s, &c);
+		*lvx = speed * c;
+		*lvy = speed * s;
+		return;
+	}
+	*lvx = speed * cos((real)((angle)*M_PI/180.0f));
+	*lvy = speed * sin((real)((angle)*M_PI/180.0f));
+}
+
+/* Physics steps per real second. Each step advances t by sim_dt. */
+void setPhysicsRate(real hz)
+{
+	physics_hz = hz;
+	sim_dt = time_scale / hz;
+}
+
+/* Launch components, computed once at startup like the original main() did */
+void initBall()
+{
+	launchVelocity(u, thita_ball, &ux, &uy);
+	vx = ux;
+}
+
+/* Put the ball back in the cannon */
+void resetBall()
+{
+	ball_in_play = 0;
+	t = 0;
+	t_till_now = 0;
+	shot_time = 0;
+	vx = ux;
+	x_till_collision = -3.0f;
+	y_till_collision = -2.75f;
+	ball_asleep = 0;
+	rest_timer = 0;
+	rest_contact = 0;
+	touching = touching_now = -1;
+	ball_split = 0;
+	u = 4.0f;
+}
+
+/* Same as pressing space */
+void fireBall()
+{
+	thita_ball = thita;
+	ball_asleep = 0;
+	rest_timer = 0;
+	rest_contact = 0;
+	touching = touching_now = -1;
+	ball_split = 0;
+	shot_time = 0;
+	ball_in_play = 1;
+	fl = 1;
+}
+
+/* Closed form position of the ball for the current value of t. With an
+ * integrator the position is state instead and only the launch happens here. */
+void updateBallPosition()
+{
+	if(flight_integrator != FLIGHT_CLOSED_FORM)
+	{
+		if(fl == 1)
+		{
+			launchVelocity(u, thita_ball, &vx, &vy);
+			rk45_h = sim_dt;
+			fl = 0;
+			x_cannonball = x_till_collision;
+			y_cannonball = y_till_collision;
+		}
+		else if(!ball_in_play)
+		{
+			x_cannonball = x_till_collision;
+			y_cannonball = y_till_collision;
+		}
+		prev_x_cannonball = x_cannonball;
+		prev_y_cannonball = y_cannonball;
+		return;
+	}
+
+	if(fl == 1)
+	{
+		launchVelocity(u, thita_ball, &vx, &uy);
+		fl =0;
+	}
+	prev_x_cannonball = x_cannonball;
+	prev_y_cannonball = y_cannonball;
+	x_cannonball = x_till_collision + vx * (t-t_till_now);
+	y_cannonball = y_till_collision + uy*(t) - 0.5f*g*(t)*(t);
+
+	vy = uy - g*t;
+	v = sqrt(pow(vx,2)+pow(vy,2));
+}
+
+/* Shortest time the ball moving at (bvx, bvy) could take to reach any
+ * solid box, from the gap to each box and the speed towards it. Only
+ * boxes it could reach within one step are looked at; 1e30 if none. */
+static real timeToContact(real x, real y, real bvx, real bvy)
+{
+	real best = 1e30f;
+	real reach = ball_radius + sqrt(bvx*bvx + bvy*bvy) * sim_dt;
+	Box region = { x - reach, x + reach, y - reach, y + reach };
+	queryObstacles(region, nearby);
+	for(int k = 0; k < (int)nearby.size(); k++)
+	{
+		if(obstacles[nearby[k]].state == OBSTACLE_KINEMATIC)
+			continue;
+		real nx, ny;
+		real gap = boxDistance(obstacles[nearby[k]].box, x, y, &nx, &ny) - ball_radius;
+		real closing = -(bvx * nx + bvy * ny);
+		if(closing <= 0)
+			continue;
+		if(gap < 0)
+			gap = 0;
+		if(gap / closing < best)
+			best = gap / closing;
+	}
+	// Kinematic boxes close in at the speed relative to them
+	for(int k = 0; k < (int)kinematics.size(); k++)
+	{
+		const Obstacle& o = obstacles[kinematics[k].obstacle];
+		if(o.state != OBSTACLE_KINEMATIC)
+			continue;
+		real nx, ny;
+		real gap = boxDistance(o.box, x, y, &nx, &ny) - ball_radius;
+		real closing = -((bvx - o.vx) * nx + (bvy - o.vy) * ny);
+		if(closing <= 0)
+			continue;
+		if(gap < 0)
+			gap = 0;
+		if(gap / closing < best)
+			best = gap / closing;
+	}
+	return best;
+}
+
+/* Called at the end of every physics step with the ball velocity and
+ * whether it touched anything in the step. Puts the ball to sleep once its
+ * kinetic energy stayed below sleep_energy for sleep_time seconds with at
+ * least one contact in that time, which tells a ball lying or rocking on a
+ * surface apart from one at the top of a lob. */
+static int checkRest(real bvx, real bvy, int touched)
+{
+	if(ball_asleep)
+		return 1;
+	// A ball riding a moving box is carried along, not at rest
+	if(0.5f * (bvx*bvx + bvy*bvy) >= sleep_energy || riding)
+	{
+		rest_timer = 0;
+		rest_contact = 0;
+		return 0;
+	}
+	rest_timer += sim_dt;
+	if(touched)
+		rest_contact = 1;
+	if(rest_contact && rest_timer >= sleep_time)
+		ball_asleep = 1;
+	return ball_asleep;
+}
+
+/* End of advanceBall(), once (x_cannonball, y_cannonball) is where the
+ * ball is at the end of the step */
+static int endStep()
+{
+	if(x_cannonball < -4.5f || x_cannonball > 4.5f)
+	{
+		pushEvent(EVENT_OUT, -1, sim_dt, x_cannonball, y_cannonball, 0, 0, 0);
+		resetBall();
+		return BALL_RESET;
+	}
+	if(ball_asleep)
+	{
+		pushEvent(EVENT_REST, -1, sim_dt, x_cannonball, y_cannonball, 0, 0, 0);
+		shot_time += sim_dt;
+		return BALL_RESTING;
+	}
+	shot_time += sim_dt;
+	return BALL_FLYING;
+}
+
+/* advanceBall() for the integrated flight models. The step is cut into
+ * sub steps no longer than the time the ball needs to reach the closest
+ * box it is moving towards, so free flight takes whole steps and the
+ * integrator only slows down near obstacles. Every sub step is swept
+ * against the boxes along a path through both of its ends: the parabola
+ * itself without drag, else one bent by whatever acceleration brings the
+ * start to the integrated end. A contact before the end is integrated
+ * again up to the contact. */
+static int advanceBallIntegrated()
+{
+	unsigned int step_events = sim_events.end();
+	BodyState s = { x_cannonball, y_cannonball, vx, vy };
+	real remaining = sim_dt;
+	for(int sub = 0; sub < 64 && remaining > 0; sub++)
+	{
+		real h = remaining;
+		real contact = timeToContact(s.x, s.y, s.vx, s.vy);
+		if(contact < h)
+			h = contact > sim_dt / 16 ? contact : sim_dt / 16;
+		if(flight_integrator == INTEGRATOR_RK45 && rk45_h < h)
+			h = rk45_h;
+		if(h > remaining)
+			h = remaining;
+
+		BodyState start = s;
+		real h_next;
+		h = integrateStep(flight_integrator, flight_params, t, s, h, integrator_tol, &h_next);
+		if(flight_integrator == INTEGRATOR_RK45)
+			rk45_h = h_next;
+
+		BallPath p = { start.x, start.y, start.vx, 0, start.vy, flight_params.g };
+		if(flight_params.drag != 0 && h > 0)
+		{
+			// Drag and wind bend the path away from the parabola; this one
+			// ends where the integrator did
+			p.vx = (s.x - start.x) / h;
+			p.g = 2 * (start.vy * h - (s.y - start.y)) / (h * h);
+		}
+		real hit_nx, hit_ny;
+		int hit_box;
+		real t_hit = sweepBall(p, ball_radius, 0, h, sim_dt - remaining, &hit_nx, &hit_ny, &hit_box);
+		if(t_hit >= 0 && flight_params.drag != 0)
+		{
+			s = start;
+			real reached = integrateStep(flight_integrator, flight_params, t, s, t_hit, integrator_tol, &h_next);
+			if(reached < t_hit)
+			{
+				// RK45 wouldn't go that far in one step, the next sub step
+				// sweeps again from where it got
+				h = reached;
+				t_hit = -1;
+			}
+			else
+				pathPosition(p, t_hit, &s.x, &s.y);
+		}
+		else if(t_hit >= 0)
+		{
+			pathPosition(p, t_hit, &s.x, &s.y);
+			pathVelocity(p, t_hit, &s.vx, &s.vy);
+		}
+		if(t_hit >= 0)
+		{
+			h = t_hit;
+			int contact = boxContact(&s.vx, &s.vy, hit_nx, hit_ny, remaining - h, hit_box, sim_dt - remaining + h, &s.x, &s.y);
+			if(contact == CONTACT_SLIDE)
+			{
+				// Gravity alone would bring it back within the step, so
+				// slide along the surface for the rest of it
+				s.x += s.vx * (remaining - h);
+				s.y += s.vy * (remaining - h);
+				h = remaining;
+			}
+			else if(contact == CONTACT_REST)
+			{
+				ball_asleep = 1;
+				h = remaining;
+			}
+		}
+		t += h;
+		remaining -= h;
+	}
+
+	if(!ball_asleep)
+		hitBodies(s.x, s.y, ball_radius, ball_mass, &s.vx, &s.vy);
+	if(checkRest(s.vx, s.vy, touching_now >= 0 || sim_events.end() != step_events))
+	{
+		s.vx = 0;
+		s.vy = 0;
+	}
+	x_cannonball = s.x;
+	y_cannonball = s.y;
+	vx = s.vx;
+	vy = s.vy;
+	v = sqrt(vx*vx + vy*vy);
+	return endStep();
+}
+
+/* Whether a kinematic box can reach the ball at (x, y) within the step */
+static int kinematicNear(real x, real y)
+{
+	for(int k = 0; k < (int)kinematics.size(); k++)
+	{
+		const Obstacle& o = obstacles[kinematics[k].obstacle];
+		if(o.state != OBSTACLE_KINEMATIC || (o.vx == 0 && o.vy == 0))
+			continue;
+		real nx, ny;
+		real gap = boxDistance(o.box, x, y, &nx, &ny) - ball_radius;
+		if(gap <= sqrt(o.vx*o.vx + o.vy*o.vy) * sim_dt + 1e-3f)
+			return 1;
+	}
+	return 0;
+}
+
+/* Target, collision checks and time advance for one physics step. Must be
+ * called after updateBallPosition(), whose position is the one tested
+ * against the targets. Returns BALL_FLYING while the ball should be drawn,
+ * BALL_RESTING once it came to rest on a surface and BALL_RESET when it
+ * left the play area and went back to the cannon. Every contact in the step
+ * starts a new parabola from the contact point with the velocity after the
+ * response, and the rest of the step continues along it. */
+int advanceBall()
+{
+	if(ball_asleep && kinematicNear(x_cannonball, y_cannonball))
+	{
+		ball_asleep = 0;
+		rest_timer = 0;
+		rest_contact = 0;
+	}
+	if(ball_asleep)
+		return BALL_RESTING;
+	if(!ball_in_play)
+		return BALL_IDLE;
+	riding = 0;
+	touching = touching_now;
+	touching_now = -1;
+	unsigned int hits = sim_events.end();
+	if(hitTargets(x_cannonball, y_cannonball, shot_time))
+		shatterTargets(hits, vx, flight_integrator == FLIGHT_CLOSED_FORM ? uy - g*t : vy);
+	if(flight_integrator != FLIGHT_CLOSED_FORM)
+		return advanceBallIntegrated();
+
+	unsigned int step_events = sim_events.end();
+	real t_end = t + sim_dt;
+	for(int contacts = 0; contacts < 16; contacts++)
+	{
+		BallPath path = currentPath();
+		real nx, ny;
+		int hit_box;
+		real t_hit = sweepBall(path, ball_radius, t, t_end, sim_dt - (t_end - t), &nx, &ny, &hit_box);
+		if(t_hit < 0)
+			break;
+
+		real x_hit, y_hit, bvx, bvy;
+		pathPosition(path, t_hit, &x_hit, &y_hit);
+		pathVelocity(path, t_hit, &bvx, &bvy);
+		int contact = boxContact(&bvx, &bvy, nx, ny, t_end - t_hit, hit_box, sim_dt - (t_end - t_hit), &x_hit, &y_hit);
+		if(contact == CONTACT_SLIDE)
+		{
+			x_hit += bvx * (t_end - t_hit);
+			y_hit += bvy * (t_end - t_hit);
+			t_hit = t_end;
+		}
+		x_till_collision = x_hit;
+		y_till_collision = y_hit;
+		t_till_now = 0;
+		vx = bvx;
+		uy = bvy;
+		t_end -= t_hit;
+		t = 0;
+		if(contact == CONTACT_REST)
+		{
+			ball_asleep = 1;
+			x_cannonball = x_hit;
+			y_cannonball = y_hit;
+			t_end = 0;
+			break;
+		}
+	}
+	t = t_end;
+
+	if(!ball_asleep && rigid_world.size() > 0)
+	{
+		real x_end = x_till_collision + vx * (t - t_till_now);
+		real y_end = y_till_collision + uy*t - 0.5f*g*t*t;
+		real bvx = vx, bvy = uy - g*t;
+		if(hitBodies(x_end, y_end, ball_radius, ball_mass, &bvx, &bvy))
+		{
+			// New parabola from where it is now
+			x_till_collision = x_end;
+			y_till_collision = y_end;
+			t_till_now = 0;
+			t = 0;
+			vx = bvx;
+			uy = bvy;
+		}
+	}
+	if(!ball_asleep && checkRest(vx, uy - g*t, touching_now >= 0 || sim_events.end() != step_events))
+	{
+		// Freeze it where it is at the end of the step
+		x_cannonball = x_till_collision + vx * (t - t_till_now);
+		y_cannonball = y_till_collision + uy*t - 0.5f*g*t*t;
+		x_till_collision = x_cannonball;
+		y_till_collision = y_cannonball;
+		t_till_now = 0;
+		t = 0;
+		vx = 0;
+		uy = 0;
+	}
+	return endStep();
+}
+
+/* Moves the blocks of rigid_world by one physics step, shatters the
+ * breakable ones that hit something too hard and moves the kinematic boxes
+ * on to the next step. Called after advanceBall(), also while the ball is
+ * in the cannon. */
+void advanceBodies()
+{
+	rigid_world.gravity = g;
+	rigid_world.step(sim_dt);
+	for(int k = 0; k < (int)rigid_world.broken.size(); k++)
+	{
+		int i = rigid_world.broken[k];
+		pushEvent(EVENT_BREAK, i, 0, rigid_world.bodies[i].x, rigid_world.bodies[i].y, 0, 0, 0);
+		shatterBody(i, 0, 0);
+	}
+	advanceKinematics(sim_dt);
+}
+
+/* Where the ball is at the end of the last step and how fast it moves */
+static void ballState(real* x, real* y, real* bvx, real* bvy)
+{
+	if(flight_integrator != FLIGHT_CLOSED_FORM)
+	{
+		*x = x_cannonball;
+		*y = y_cannonball;
+		*bvx = vx;
+		*bvy = vy;
+		return;
+	}
+	*x = x_till_collision + vx * (t - t_till_now);
+	*y = y_till_collision + uy*t - 0.5f*g*t*t;
+	*bvx = vx;
+	*bvy = uy - g*t;
+}
+
+int splitBall()
+{
+	if(!ball_in_play || ball_asleep || ball_split)
+		return 0;
+	ball_split = 1;
+	real x, y, bvx, bvy;
+	ballState(&x, &y, &bvx, &bvy);
+	int made = 0;
+	for(int k = 1; k <= split_birds; k++)
+	{
+		// Alternately above and below the ball, further out every pair
+		real angle = split_spread * ((k + 1) / 2) * (k % 2 ? 1 : -1);
+		real sn, cs;
+		if(deterministic)
+			detSinCosDeg(angle, &sn, &cs);
+		else
+		{
+			sn = sin((real)(angle*M_PI/180.0f));
+			cs = cos((real)(angle*M_PI/180.0f));
+		}
+		Entity* bird = entities.get(entities.create(ENTITY_PROJECTILE));
+		if(!bird)
+			break;
+		bird->x = x;
+		bird->y = y;
+		bird->vx = cs * bvx - sn * bvy;
+		bird->vy = sn * bvx + cs * bvy;
+		bird->radius = ball_radius * split_size;
+		bird->mass = ball_mass * split_size * split_size; // black, like the ball
+		bird->lane = flock.add(bird->x, bird->y, bird->vx, bird->vy, sim_dt);
+		made++;
+	}
+	pushEvent(EVENT_SPLIT, made, 0, x, y, 0, 0, 0);
+	return made;
+}
+
+int explode(real x, real y, real radius, real impulse)
+{
+	static const float orange[3] = { 1.0f, 0.8f, 0.2f };
+	static vector<int> shattered;
+	int pushed = rigid_world.radialImpulse(x, y, radius, impulse, shattered);
+	pushEvent(EVENT_BLAST, pushed, 0, x, y, 0, 0, 0);
+	for(int k = 0; k < (int)shattered.size(); k++)
+	{
+		const RigidBody& b = rigid_world.bodies[shattered[k]];
+		real bvx = b.vx, bvy = b.vy;
+		pushEvent(EVENT_BREAK, shattered[k], 0, b.x, b.y, 0, 0, 0);
+		shatterBody(shattered[k], bvx, bvy);
+	}
+	unsigned int hits = sim_events.end();
+	if(blastTargets(x, y, radius, shot_time))
+		shatterTargets(hits, 0, 0);
+	addEffect(x, y, radius / 2, 0.5f, orange);
+	return pushed;
+}
+
+int explodeBall()
+{
+	if(!ball_in_play || ball_asleep)
+		return -1;
+	real x, y, bvx, bvy;
+	ballState(&x, &y, &bvx, &bvy);
+	int pushed = explode(x, y, blast_radius, blast_impulse);
+	resetBall();
+	return pushed;
+}
+
+/* 1 if the ball touched the level, a block or a target since cursor */
+static int ballTouched(unsigned int cursor)
+{
+	SimEvent ev;
+	while(sim_events.read(&cursor, &ev))
+		if(ev.type == EVENT_CONTACT || ev.type == EVENT_BODY || ev.type == EVENT_TARGET)
+			return 1;
+	return 0;
+}
+
+/* One step of a bird of a split. advanceEntities() has already flown every
+ * bird along its parabola with the flock kernel; where nothing of the level
+ * is near that step, the bird just takes its place in the flock. Otherwise
+ * the parabola is swept against the level like the ball's, bouncing off
+ * what it hits with e and mu (relative to a kinematic box), and its ball
+ * in the flock starts again from where that leaves it. Then the targets
+ * and blocks at the end of the step. Returns 0 once it is gone: out of the
+ * play area, or still on a surface for sleep_time. */
+static int advanceProjectile(Entity& p)
+{
+	real left = sim_dt;
+	int touched = 0;
+	BallPath free_path = { p.x, p.y, p.vx, 0, p.vy, g };
+	queryPath(free_path, p.radius, 0, sim_dt);
+	int exact = !nearby.empty() || !kinematics.empty();
+	if(!exact)
+	{
+		p.x = flock.x[p.lane];
+		p.y = flock.y[p.lane];
+		p.vx = flock.vx[p.lane];
+		p.vy = flock.vy[p.lane];
+		left = 0;
+	}
+	for(int contacts = 0; contacts < 16 && left > 0; contacts++)
+	{
+		BallPath path = { p.x, p.y, p.vx, 0, p.vy, g };
+		real nx, ny;
+		int box;
+		real h = sweepBall(path, p.radius, 0, left, sim_dt - left, &nx, &ny, &box);
+		real end = h < 0 ? left : h;
+		pathPosition(path, end, &p.x, &p.y);
+		pathVelocity(path, end, &p.vx, &p.vy);
+		left -= end;
+		if(h < 0)
+			break;
+		touched = 1;
+		const Obstacle& o = obstacles[box];
+		real rvx = p.vx - o.vx, rvy = p.vy - o.vy;
+		real closing = -(rvx * nx + rvy * ny);
+		applyContactImpulse(&rvx, &rvy, nx, ny, closing >= rest_speed ? e : (real)0, mu);
+		p.vx = rvx + o.vx;
+		p.vy = rvy + o.vy;
+	}
+	if(p.x < -4.5f || p.x > 4.5f || p.y < rigid_world.debris_floor)
+		return 0;
+
+	unsigned int hits = sim_events.end();
+	if(hitTargets(p.x, p.y, shot_time))
+		shatterTargets(hits, p.vx, p.vy);
+	if(hitBodies(p.x, p.y, p.radius, p.mass, &p.vx, &p.vy))
+		touched = exact = 1;
+	if(exact)
+		flock.restart(p.lane, p.x, p.y, p.vx, p.vy, sim_dt);
+	if(0.5f * (p.vx*p.vx + p.vy*p.vy) >= sleep_energy || !touched)
+		p.still = 0;
+	else
+		p.still += sim_dt;
+	return p.still < sleep_time;
+}
+
+int advanceEntities()
+{
+	static const float grey[3] = { 0.5f, 0.5f, 0.5f };
+	int flying = 0;
+	if(flock.size() > 0)
+		flock.step(sim_dt, g, e, mu, rest_speed);
+	for(int i = 0; i < entities.capacity(); i++)
+	{
+		if(!entities.alive(i))
+			continue;
+		Entity& en = entities.items[i];
+		en.age += sim_dt;
+		if(en.kind == ENTITY_PROJECTILE)
+		{
+			if(advanceProjectile(en))
+			{
+				flying++;
+				continue;
+			}
+			real x = en.x, y = en.y, r = en.radius;
+			flock.alive[en.lane] = 0.0f;
+			entities.destroy(entities.handle(i));
+			addEffect(x, y, 2 * r, 0.3f, grey);
+		}
+		else if(en.kind == ENTITY_DEBRIS)
+		{
+			// The body went away with restart() or a new level, or the
+			// pool gave its slot to a newer piece
+			if(en.body >= rigid_world.size() || rigid_world.bodies[en.body].entity != i ||
+			   (rigid_world.bodies[en.body].flags & BODY_REMOVED))
+				entities.destroy(entities.handle(i));
+			else if(en.life > 0 && en.age >= en.life)
+			{
+				rigid_world.remove(en.body);
+				entities.destroy(entities.handle(i));
+			}
+		}
+		else if(en.age >= en.life)
+			entities.destroy(entities.handle(i));
+	}
+	// Every ball of the flock is dead, start filling it from 0 again
+	if(!flying)
+		flock.clear();
+	return flying;
+}
+
+/* FNV-1a over the bytes of f */
+static unsigned int hashFloat(unsigned int h, real f)
+{
+	unsigned char bytes[sizeof(real)];
+	memcpy(bytes, &f, sizeof(real));
+	for(unsigned int i = 0; i < sizeof(real); i++)
+		h = (h ^ bytes[i]) * 16777619u;
+	return h;
+}
+
+/* Resolves one shot exactly like the game loop would, minus the drawing.
+ * max_steps plays the role of the 10 second timeout in main(). The shot
+ * ends early once the ball comes to rest. */
+ShotResult simulateShot(real speed, real angle, int max_steps)
+{
+	ShotResult r;
+	r.u = speed;
+	r.thita = angle;
+	r.target1_step = -1;
+	r.target2_step = -1;
+	r.out_of_bounds = 0;
+	r.trace_hash = 2166136261u;
+
+	resetBall();
+	resetTargets();
+	rigid_world.restart();
+	resetKinematics(sim_dt);
+	entities.clear();
+	flock.clear();
+	u = speed;
+	thita = angle;
+	fireBall();
+	unsigned int cursor = sim_events.end();
+
+	int step;
+	int ball_done = 0;
+	for(step = 0; step < max_steps; step++)
+	{
+		updateBallPosition();
+		r.trace_hash = hashFloat(hashFloat(r.trace_hash, x_cannonball), y_cannonball);
+		unsigned int step_events = sim_events.end();
+		int state = advanceBall();
+		if(auto_bomb && state == BALL_FLYING && ballTouched(step_events))
+		{
+			real x, y, bvx, bvy;
+			ballState(&x, &y, &bvx, &bvy);
+			explodeBall();
+			r.x_end = x;
+			r.y_end = y;
+			ball_done = 1;
+			state = BALL_IDLE;
+		}
+		if(auto_split && state == BALL_FLYING)
+		{
+			real x, y, bvx, bvy;
+			ballState(&x, &y, &bvx, &bvy);
+			if(bvy <= 0)
+				splitBall();
+		}
+		int flying = advanceEntities();
+		advanceBodies();
+		SimEvent ev;
+		while(cursor != sim_events.end() && sim_events.read(&cursor, &ev))
+		{
+			if(ev.type != EVENT_TARGET)
+				continue;
+			if(ev.body == 0)
+				r.target1_step = step;
+			else if(ev.body == 1)
+				r.target2_step = step;
+		}
+		if((state == BALL_RESET || state == BALL_RESTING) && !ball_done)
+		{
+			r.out_of_bounds = state == BALL_RESET;
+			r.x_end = x_cannonball;
+			r.y_end = y_cannonball;
+			ball_done = 1;
+		}
+		// Once nothing moves any more, no need to wait for the timeout. The
+		// birds of a split keep the shot going after the ball is done.
+		if(ball_done && !flying)
+		{
+			step++;
+			break;
+		}
+	}
+	r.steps = step;
+	if(!ball_done)
+	{
+		r.x_end = x_cannonball;
+		r.y_end = y_cannonball;
+	}
+
+	resetBall();
+	return r;
+}
+
+/* Handles the physics options shared by the game and --headless:
+ *   --hz N            physics steps per second
+ *   --integrator X    euler, rk4 or rk45 instead of the closed-form parabola
+ *   --drag K          quadratic air drag coefficient
+ *   --wind WX         steady horizontal wind
+ *   --gust A          amplitude of gusts on top of the wind
+ *   --sleep-energy E  kinetic energy per unit mass below which the ball
+ *                     can go to sleep
+ *   --sleep-time T    seconds it has to stay below that, touching something
+ *   --threads N       threads solving the blocks, one per core by default
+ *   --debris N        pieces of shattered blocks alive at once, 0 for none
+ *   --entities N      slots of the entity pool (entities.h); every piece of
+ *                     debris takes one, so it needs at least --debris plus
+ *                     the birds of a split and the puffs
+ *   --split N         splits the ball into N more birds at the top of its
+ *                     flight in simulateShot(), the game splits on D
+ *   --bomb            blows the ball up at the first thing it touches in
+ *                     simulateShot(), the game blows it up on E
+ *   --blast R J       radius and push at the centre of the blast
+ *   --deterministic   bit-reproducible results, see the deterministic flag */
+void parseSimulationArgs(int argc, char** argv)
+{
+	for(int i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--deterministic") == 0)
+		{
+			deterministic = 1;
+			flight_params.strict_math = 1;
+			continue;
+		}
+		if(strcmp(argv[i], "--bomb") == 0)
+		{
+			auto_bomb = 1;
+			continue;
+		}
+		if(i + 1 >= argc)
+			break;
+		if(strcmp(argv[i], "--hz") == 0)
+			setPhysicsRate(atof(argv[++i]));
+		else if(strcmp(argv[i], "--integrator") == 0)
+		{
+			flight_integrator = integratorFromName(argv[++i]);
+			if(flight_integrator < 0)
+			{
+				fprintf(stderr, "Unknown integrator `%s', using the closed form\n", argv[i]);
+				flight_integrator = FLIGHT_CLOSED_FORM;
+			}
+		}
+		else if(strcmp(argv[i], "--drag") == 0)
+			flight_params.drag = atof(argv[++i]);
+		else if(strcmp(argv[i], "--wind") == 0)
+			flight_params.wind_x = atof(argv[++i]);
+		else if(strcmp(argv[i], "--gust") == 0)
+			flight_params.gust = atof(argv[++i]);
+		else if(strcmp(argv[i], "--sleep-energy") == 0)
+			sleep_energy = atof(argv[++i]);
+		else if(strcmp(argv[i], "--sleep-time") == 0)
+			sleep_time = atof(argv[++i]);
+		else if(strcmp(argv[i], "--threads") == 0)
+			job_pool.resize(atoi(argv[++i]));
+		else if(strcmp(argv[i], "--debris") == 0)
+			rigid_world.debris_capacity = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--entities") == 0)
+			entity_capacity = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--split") == 0)
+		{
+			split_birds = atoi(argv[++i]);
+			auto_split = 1;
+		}
+		else if(strcmp(argv[i], "--blast") == 0 && i + 2 < argc)
+		{
+			blast_radius = atof(argv[++i]);
+			blast_impulse = atof(argv[++i]);
+		}
+		else if(strcmp(argv[i], "--level") == 0)
+			loadLevel(argv[++i]);
+		else if(strcmp(argv[i], "--grid-cell") == 0)
+		{
+			grid_cell = atof(argv[++i]);
+			buildObstacleGrid();
+		}
+
+	}
+	if(flight_integrator == FLIGHT_CLOSED_FORM && (flight_params.drag != 0 || flight_params.gust != 0))
+	{
+		// Drag and wind need an integrator
+		flight_integrator = INTEGRATOR_RK45;
+	}
+	prepareFracture();
+	if(entity_capacity < rigid_world.debris_capacity + split_birds)
+		fprintf(stderr, "--entities %d is less than %d pieces of debris and %d birds, some will be left out\n",
+		        entity_capacity, rigid_world.debris_capacity, split_birds);
+	entities.reserve(entity_capacity);
+	flock.reserve(entity_capacity);
+	flock.xmin = -4.5f;
+	flock.xmax = 4.5f;
+}
+
+/* Time a ball sliding at speed with deceleration a takes to cover dist */
+static real slideTime(real speed, real a, real dist)
+{
+	real left = speed * speed - 2 * a * dist;
+	return (speed - sqrt(left > 0 ? left : 0)) / a;
+}
+
+/* Resolves one shot event by event instead of step by step: each flight
+ * segment is a parabola, the next contact with the floor or an obstacle is
+ * found in closed form, the same response as ballContact() is applied and
+ * the next segment starts there. Once the ball slides on top of a box the
+ * segments are straight lines with constant friction deceleration instead,
+ * ending where it stops or falls asleep, falls off the edge or runs into a
+ * side. Cost is proportional to the number of bounces. */
+SolvedShot solveShot(real speed, real angle, real max_time)
+{
+	const int max_bounces = 256;
+
+	SolvedShot r;
+	r.u = speed;
+	r.thita = angle;
+	r.bounces = 0;
+	r.target1_t = -1;
+	r.target2_t = -1;
+	r.out_of_bounds = 0;
+	real* target_t[2] = { &r.target1_t, &r.target2_t };
+	int scored = targets.size() < 2 ? (int)targets.size() : 2;
+
+	BallPath p;
+	p.x0 = -3.0f;
+	p.y0 = -2.75f;
+	launchVelocity(speed, angle, &p.vx, &p.uy); // same launch as updateBallPosition()
+	p.tx = 0;
+	p.g = g;
+
+	real elapsed = 0;   // time of the start of this segment since the shot
+	int support = -1;    // box the ball slides on once it stopped bouncing
+	while(1)
+	{
+		real h, x_hit, y_hit;
+		if(r.bounces >= max_bounces)
+		{
+			// Wedged somewhere, call it at rest
+			r.x_end = p.x0;
+			r.y_end = p.y0;
+			r.t_end = elapsed;
+			return r;
+		}
+
+		if(support >= 0)
+		{
+			real a = mu * g;
+			real dir = p.vx > 0 ? 1.0f : -1.0f;
+			real v0 = fabs(p.vx);
+			real t_left = max_time - elapsed;
+			// checkRest() puts it to sleep sleep_time after it got slow enough
+			real v_sleep = sqrt(2 * sleep_energy);
+			real t_sleep = (v0 > v_sleep ? (v0 - v_sleep) / a : 0) + sleep_time;
+			if(t_sleep < t_left)
+				t_left = t_sleep;
+			real reach = v0 / a < t_left ? v0 * v0 / (2 * a) : v0 * t_left - 0.5f * a * t_left * t_left;
+
+			// Along a unit speed line, time is distance
+			BallPath line = { p.x0, p.y0, dir, 0, 0, 0 };
+			int event = 0; // 0 stopped, 1 off the edge, 2 out of the play area, 3 contact
+			real d = dir > 0 ? obstacles[support].box.xmax - p.x0 : p.x0 - obstacles[support].box.xmin;
+			if(d < reach) { reach = d > 0 ? d : 0; event = 1; }
+			d = dir > 0 ? 4.5f - p.x0 : p.x0 + 4.5f;
+			if(d < reach) { reach = d; event = 2; }
+			real hit_nx = 0, hit_ny = 0;
+			queryObstacles(pathBounds(line, (real)0, reach, ball_radius), nearby);
+			for(int k = 0; k < (int)nearby.size(); k++)
+			{
+				real nx, ny;
+				if(nearby[k] == support)
+					continue;
+				h = impactCircleBox(line, ball_radius, (real)0, reach, obstacles[nearby[k]].box, &nx, &ny);
+				if(h >= 0 && h < reach) { reach = h; event = 3; hit_nx = nx; hit_ny = ny; }
+			}
+
+			for(int k = 0; k < scored; k++)
+			{
+				if(*target_t[k] >= 0)
+					continue;
+				h = firstTimeInBox(line, (real)0, reach, targets[k].box);
+				if(h >= 0) *target_t[k] = elapsed + slideTime(v0, a, h);
+			}
+
+			real v1 = v0 * v0 - 2 * a * reach;
+			v1 = v1 > 0 ? sqrt(v1) : 0;
+			elapsed += slideTime(v0, a, reach);
+			p.x0 += dir * reach;
+			p.vx = dir * v1;
+			if(event == 0 || event == 2)
+			{
+				r.out_of_bounds = event == 2;
+				r.t_end = elapsed;
+				r.x_end = p.x0;
+				r.y_end = p.y0;
+				return r;
+			}
+			if(event == 1)
+			{
+				// Start falling from the edge with no vertical speed
+				support = -1;
+				p.g = g;
+				continue;
+			}
+
+			r.bounces++;
+			real bvx = p.vx, bvy = 0;
+			real closing = -(bvx * hit_nx + bvy * hit_ny);
+			applyContactImpulse(&bvx, &bvy, hit_nx, hit_ny, closing >= rest_speed ? e : 0, mu);
+			p.vx = bvx;
+			if(bvy > 0)
+			{
+				support = -1;
+				p.uy = bvy;
+				p.g = g;
+			}
+			else if(bvx == 0)
+			{
+				// Stopped against the side
+				r.t_end = elapsed;
+				r.x_end = p.x0;
+				r.y_end = p.y0;
+				return r;
+			}
+			continue;
+		}
+
+		real t_limit = max_time - elapsed;
+		int leaving = 0;
+
+		// Leaving the play area ends the shot
+		real edge = p.vx > 0 ? 4.5f : -4.5f;
+		h = p.vx != 0 ? (edge - p.x0) / p.vx : -1;
+		if(h >= 0 && h < t_limit) { t_limit = h; leaving = 1; }
+
+		real t_hit = -1, hit_nx = 0, hit_ny = 0;
+		int hit_box = -1;
+		queryObstacles(pathBounds(p, (real)0, t_limit, ball_radius), nearby);
+		for(int k = 0; k < (int)nearby.size(); k++)
+		{
+			real nx, ny;
+			h = impactCircleBox(p, ball_radius, (real)0, t_hit >= 0 ? t_hit : t_limit, obstacles[nearby[k]].box, &nx, &ny);
+			if(h >= 0 && (t_hit < 0 || h < t_hit))
+			{
+				t_hit = h;
+				hit_nx = nx;
+				hit_ny = ny;
+				hit_box = nearby[k];
+			}
+		}
+		real seg_end = t_hit >= 0 ? t_hit : t_limit;
+
+		for(int k = 0; k < scored; k++)
+		{
+			if(*target_t[k] >= 0)
+				continue;
+			h = firstTimeInBox(p, (real)0, seg_end, targets[k].box);
+			if(h >= 0) *target_t[k] = elapsed + h;
+		}
+
+		pathPosition(p, seg_end, &x_hit, &y_hit);
+		elapsed += seg_end;
+		if(t_hit < 0)
+		{
+			r.out_of_bounds = leaving;
+			r.t_end = elapsed;
+			r.x_end = x_hit;
+			r.y_end = y_hit;
+			return r;
+		}
+		r.bounces++;
+
+		real bvx, bvy;
+		pathVelocity(p, t_hit, &bvx, &bvy);
+		real closing = -(bvx * hit_nx + bvy * hit_ny);
+		applyContactImpulse(&bvx, &bvy, hit_nx, hit_ny, closing >= rest_speed ? e : 0, mu);
+		p.x0 = x_hit;
+		p.y0 = y_hit;
+		p.vx = bvx;
+		p.uy = bvy;
+		p.g = g;
+		const Box& box = obstacles[hit_box].box;
+		if(closing < rest_speed && hit_ny == 1 && x_hit >= box.xmin && x_hit <= box.xmax)
+		{
+			// Too slow to bounce again, slide along the top
+			support = hit_box;
+			p.uy = 0;
+			p.g = 0;
+			if(p.vx == 0)
+			{
+				r.t_end = elapsed;
+				r.x_end = x_hit;
+				r.y_end = y_hit;
+				return r;
+			}
+		}
+		else if(bvx * bvx + bvy * bvy < 2 * sleep_energy)
+		{
+			// Left the contact too slow to ever get above sleep_energy
+			// again, so checkRest() ends the shot sleep_time later. Stop at
+			// the next contact if that comes first.
+			real t_end = max_time - elapsed;
+			if(sleep_time < t_end)
+				t_end = sleep_time;
+			queryObstacles(pathBounds(p, (real)0, t_end, ball_radius), nearby);
+			for(int k = 0; k < (int)nearby.size(); k++)
+			{
+				real nx, ny;
+				h = impactCircleBox(p, ball_radius, (real)0, t_end, obstacles[nearby[k]].box, &nx, &ny);
+				if(h >= 0 && h < t_end)
+					t_end = h;
+			}
+			pathPosition(p, t_end, &r.x_end, &r.y_end);
+			r.t_end = elapsed + t_end;
+			return r;
+		}
+	}
+}
+
+/* What a shot hits first, found with castCircle() instead of running it:
+ * the first contact solveShot() would resolve. Returns 0 if the ball
+ * leaves the play area or max_time passes before it touches anything. */
+int firstHit(real speed, real angle, real max_time, QueryHit* hit)
+{
+	BallPath p;
+	p.x0 = -3.0f;
+	p.y0 = -2.75f;
+	launchVelocity(speed, angle, &p.vx, &p.uy);
+	p.tx = 0;
+	p.g = g;
+
+	real t_limit = max_time;
+	real edge = p.vx > 0 ? 4.5f : -4.5f;
+	real h = p.vx != 0 ? (edge - p.x0) / p.vx : -1;
+	if(h >= 0 && h < t_limit)
+		t_limit = h;
+	return castCircle(p, ball_radius, (real)0, t_limit, hit);
+}
+
+/* Fires n balls from the cannon over a grid of speeds and angles and steps
+ * them together in a ProjectileBatch until they all left the play area or
+ * stopped, bouncing on the lowest box of the level. Then steps the same
+ * balls with the kernel and with the plain loop and reports the largest
+ * difference in where they are. */
+static void benchBatch(int n, int max_steps)
+{
+	ProjectileBatch batch;
+	batch.reserve(n);
+	real floor_top = -1e30f;
+	real lowest = 1e30f;
+	for(int i = 0; i < (int)obstacles.size(); i++)
+		if(obstacles[i].state != OBSTACLE_REMOVED && obstacles[i].box.ymin < lowest)
+		{
+			lowest = obstacles[i].box.ymin;
+			floor_top = obstacles[i].box.ymax + ball_radius;
+		}
+	batch.floor_top = floor_top;
+	batch.xmin = -4.5f;
+	batch.xmax = 4.5f;
+	for(int i = 0; i < n; i++)
+	{
+		real speed = 2.0f + 6.0f * (i % 97) / 96.0f;
+		real angle = 10.0f + 70.0f * ((i / 97) % 71) / 70.0f;
+		real lvx, lvy;
+		launchVelocity(speed, angle, &lvx, &lvy);
+		batch.add(-3.0f, -2.75f, lvx, lvy);
+	}
+	ProjectileBatch kernel = batch, plain = batch;
+
+	clock_t start = clock();
+	int steps = 0;
+	int live = n;
+	while(live > 0 && steps < max_steps)
+	{
+		live = batch.step(sim_dt, g, e, mu, rest_speed);
+		steps++;
+	}
+	double elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	float error = 0;
+	for(int s = 0; s < steps; s++)
+	{
+		kernel.step(sim_dt, g, e, mu, rest_speed);
+		plain.stepScalar(sim_dt, g, e, mu, rest_speed);
+		for(int i = 0; i < n; i++)
+		{
+			float d = fabs(kernel.x[i] - plain.x[i]) + fabs(kernel.y[i] - plain.y[i]);
+			if(d > error)
+				error = d;
+		}
+	}
+	fprintf(stderr, "%s kernel: %d balls, %d steps in %.3f s (%.1f M ball steps/s), %d still moving, max kernel error %g\n",
+	        projectileKernelName(), n, steps, elapsed, (double)n * steps / elapsed / 1e6, live, (double)error);
+}
+
+/* Adds n small boxes to the level, moves them all on a random walk every
+ * step and times the broadphase finding the pairs that may touch. Then
+ * sweeps circles across them with the BoxBatch kernel and with the plain
+ * loop and counts the sweeps whose hits differ. */
+static void benchPairs(int n, int steps)
+{
+	srand(1);
+	int first = (int)obstacles.size();
+	for(int i = 0; i < n; i++)
+	{
+		real x = -4.5f + 9.0f * rand() / RAND_MAX;
+		real y = -3.0f + 6.0f * rand() / RAND_MAX;
+		addObstacle(x, x + 0.05f, y, y + 0.05f, 0.6f, 0.4f, 0.2f);
+	}
+
+	vector<pair<int, int> > pairs;
+	long total = 0;
+	clock_t start = clock();
+	for(int s = 0; s < steps; s++)
+	{
+		for(int i = first; i < first + n; i++)
+		{
+			Box b = obstacles[i].box;
+			real dx = 0.02f * (rand() / (real)RAND_MAX - 0.5f);
+			real dy = 0.02f * (rand() / (real)RAND_MAX - 0.5f);
+			b.xmin += dx; b.xmax += dx;
+			b.ymin += dy; b.ymax += dy;
+			moveObstacle(i, b);
+		}
+		total += findObstaclePairs(pairs);
+	}
+	double elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	BoxBatch boxes;
+	for(int i = first; i < first + n; i++)
+		boxes.add(obstacles[i].box, i);
+	boxes.pad();
+	const int sweeps = 1000;
+	int differ = 0;
+	for(int s = 0; s < sweeps; s++)
+	{
+		float x0 = -4.5f + 9.0f * rand() / RAND_MAX, y0 = -3.0f + 6.0f * rand() / RAND_MAX;
+		float dx = 2.0f * rand() / RAND_MAX - 1.0f, dy = 2.0f * rand() / RAND_MAX - 1.0f;
+		int count = boxes.sweepCircle(x0, y0, dx, dy, 0.15f, 0, boxes.size());
+		vector<unsigned int> hits = boxes.hits;
+		if(boxes.sweepCircleScalar(x0, y0, dx, dy, 0.15f, 0, boxes.size()) != count || boxes.hits != hits)
+			differ++;
+	}
+	fprintf(stderr, "broadphase: %d moving boxes, %d steps in %.3f s (%.3f ms per step), %.1f new pairs per step, %s box kernel, %d of %d sweeps differ from the plain loop\n",
+	        n, steps, elapsed, elapsed * 1000 / steps, (double)total / steps, boxKernelName(), differ, sweeps);
+}
+
+/* Replaces the level with a floor and n blocks standing on it in stacks
+ * pyramids side by side, steps it and times the rigid body solver. A stack
+ * that stands stays where it was built: the drift printed is how far the
+ * blocks moved, most of it settling into the slop of the contacts. Once it
+ * has settled it goes to sleep and the steps after that cost nothing. Each
+ * pyramid is an island of its own, solved in parallel with the others.
+ * Returns 1 if a block drifted more than a quarter of its size or any block
+ * is still awake at the end, 0 if the stacks stood. */
+static int benchStack(int n, int stacks, int steps)
+{
+	const real size = 0.2f;
+	int rows = 0;
+	while(rows * (rows + 1) / 2 * stacks < n)
+		rows++;
+	real width = stacks * (rows + 1) * size;
+
+	for(int i = 0; i < (int)obstacles.size(); i++)
+		removeObstacle(i);
+	addObstacle(-width / 2 - 1, width / 2 + 1, -4.0f, -3.0f, 0.0f, 0.51f, 0.0f);
+	rigid_world.clear();
+	rigid_world.gravity = g;
+
+	for(int p = 0, added = 0; p < stacks; p++)
+	{
+		real centre = -width / 2 + (p + 0.5f) * (rows + 1) * size;
+		for(int row = 0; row < rows; row++)
+			for(int k = 0; k < rows - row && added < n; k++, added++)
+			{
+				real x = centre + (k - (rows - row - 1) / 2.0f) * size;
+				// Rows rest on each other, only the columns have gaps
+				real y = -3.0f + size * 0.49f + row * size * 0.98f;
+				rigid_world.addBox(x, y, size * 0.98f, size * 0.98f, 0, 5, 0.6f, 0.4f, 0.2f);
+			}
+	}
+	vector<RigidBody> start = rigid_world.bodies;
+
+	// Wall time: clock() would add up the threads
+	struct timespec begin, end;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for(int s = 0; s < steps; s++)
+		rigid_world.step(sim_dt);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double elapsed = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) * 1e-9;
+
+	real drift = 0, energy = 0;
+	for(int i = 0; i < rigid_world.size(); i++)
+	{
+		const RigidBody& b = rigid_world.bodies[i];
+		real dx = b.x - start[i].x, dy = b.y - start[i].y;
+		if(sqrt(dx*dx + dy*dy) > drift)
+			drift = sqrt(dx*dx + dy*dy);
+		energy += 0.5f * (b.vx*b.vx + b.vy*b.vy) / b.inv_mass;
+	}
+	fprintf(stderr, "stack: %d blocks in %d rows, %d steps in %.3f s (%.3f ms per step) on %d threads, %d contact points, max drift %.4f, kinetic energy %.6f, %d awake, %d islands asleep\n",
+	        rigid_world.size(), rows, steps, elapsed, elapsed * 1000 / steps, job_pool.threads(), rigid_world.contactCount(), drift, energy,
+	        rigid_world.awakeCount(), rigid_world.sleepingIslands());
+	int stood = drift <= 0.25f * size && rigid_world.awakeCount() == 0;
+	fprintf(stderr, "stack: %s\n", stood ? "ok" : "FAILED");
+	return stood ? 0 : 1;
+}
+
+/* Replaces the level with n planks in bridges of 40 hinged to each other
+ * and at both ends to the world, keeps them awake and times the joint
+ * solver. The error printed is the farthest any hinge came apart. Then
+ * solves rows between pairs of planks with the ConstraintBatch kernel and
+ * with the plain loop and prints the largest difference in velocity. */
+static void benchJoints(int n, int steps)
+{
+	for(int i = 0; i < (int)obstacles.size(); i++)
+		removeObstacle(i);
+	rigid_world.clear();
+	rigid_world.gravity = g;
+	real time_to_sleep = rigid_world.time_to_sleep;
+	rigid_world.time_to_sleep = 1e30f;
+
+	const int planks = 40;
+	const real length = 0.2f;
+	for(int first = 0, bridge = 0; first < n; first += planks, bridge++)
+	{
+		real y = 2.0f - bridge * 0.25f;
+		real x0 = -planks * length / 2;
+		int count = n - first < planks ? n - first : planks;
+		for(int k = 0; k < count; k++)
+		{
+			rigid_world.addBox(x0 + (k + 0.5f) * length, y, length, 0.05f, 0, 5, 0.6f, 0.4f, 0.2f);
+			rigid_world.addRevoluteJoint(first + k, k == 0 ? -1 : first + k - 1, x0 + k * length, y);
+		}
+		rigid_world.addRevoluteJoint(first + count - 1, -1, x0 + count * length, y);
+	}
+
+	struct timespec begin, end;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for(int s = 0; s < steps; s++)
+		rigid_world.step(sim_dt);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double elapsed = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) * 1e-9;
+
+	real error = 0;
+	for(int k = 0; k < (int)rigid_world.joints.size(); k++)
+	{
+		const Joint& j = rigid_world.joints[k];
+		const RigidBody& a = rigid_world.bodies[j.a];
+		real ax = a.x + a.c * j.lax - a.s * j.lay, ay = a.y + a.s * j.lax + a.c * j.lay;
+		real bx = j.lbx, by = j.lby;
+		if(j.b >= 0)
+		{
+			const RigidBody& b = rigid_world.bodies[j.b];
+			bx = b.x + b.c * j.lbx - b.s * j.lby;
+			by = b.y + b.s * j.lbx + b.c * j.lby;
+		}
+		real d = sqrt((bx - ax) * (bx - ax) + (by - ay) * (by - ay));
+		if(d > error)
+			error = d;
+	}
+	rigid_world.time_to_sleep = time_to_sleep;
+
+	// Rows between pairs of planks, with the planks' velocities and random
+	// anchors, directions and targets, swept with the kernel and with the
+	// plain loop on a copy; half of them are ropes
+	srand(1);
+	int rows = rigid_world.size() / 2 / CONSTRAINT_LANES * CONSTRAINT_LANES;
+	vector<SolverBody> solver(2 * rows);
+	ConstraintBatch batch;
+	batch.resize(rows);
+	for(int k = 0; k < 2 * rows; k++)
+	{
+		const RigidBody& b = rigid_world.bodies[k];
+		SolverBody sb = { b.vx, b.vy, b.w, b.inv_mass, b.inv_inertia };
+		solver[k] = sb;
+	}
+	for(int i = 0; i < rows; i++)
+	{
+		const SolverBody& A = solver[2 * i];
+		const SolverBody& B = solver[2 * i + 1];
+		real angle = 2 * (real)M_PI * rand() / RAND_MAX;
+		batch.a[i] = 2 * i;
+		batch.b[i] = 2 * i + 1;
+		batch.nx[i] = cos(angle);
+		batch.ny[i] = sin(angle);
+		batch.rax[i] = 0.1f * (2.0f * rand() / RAND_MAX - 1);
+		batch.ray[i] = 0.02f * (2.0f * rand() / RAND_MAX - 1);
+		batch.rbx[i] = 0.1f * (2.0f * rand() / RAND_MAX - 1);
+		batch.rby[i] = 0.02f * (2.0f * rand() / RAND_MAX - 1);
+		real ra = batch.rax[i] * batch.ny[i] - batch.ray[i] * batch.nx[i];
+		real rb = batch.rbx[i] * batch.ny[i] - batch.rby[i] * batch.nx[i];
+		batch.mass[i] = 1 / (A.inv_mass + B.inv_mass + A.inv_inertia * ra * ra + B.inv_inertia * rb * rb);
+		batch.bias[i] = 2.0f * rand() / RAND_MAX - 1;
+		batch.lo[i] = i % 2 ? 0 : -1e30f;
+		batch.hi[i] = 1e30f;
+		batch.impulse[i] = 0;
+	}
+	vector<SolverBody> plain = solver;
+	ConstraintBatch check = batch;
+	for(int sweep = 0; sweep < 10 && rows > 0; sweep++)
+	{
+		batch.solve(&solver[0], 0, rows);
+		check.solveScalar(&plain[0], 0, rows);
+	}
+	real kernel_error = 0;
+	for(int k = 0; k < 2 * rows; k++)
+	{
+		real d = fabs(solver[k].vx - plain[k].vx) + fabs(solver[k].vy - plain[k].vy) + fabs(solver[k].w - plain[k].w);
+		if(d > kernel_error)
+			kernel_error = d;
+	}
+	fprintf(stderr, "joints: %d planks, %d hinges, %d steps in %.3f s (%.3f ms per step) on %d threads, %s kernel, max hinge error %.5f, max kernel error %g\n",
+	        rigid_world.size(), (int)rigid_world.joints.size(), steps, elapsed, elapsed * 1000 / steps, job_pool.threads(), constraintKernelName(), error, (double)kernel_error);
+}
+
+/* Replaces the blocks with n in a square around the origin, blows up
+ * blasts reaching all of them in its middle and times them. The error
+ * printed is the largest difference between the vector kernel and the
+ * plain loop over the same blocks. */
+static void benchBlast(int n, int blasts)
+{
+	rigid_world.clear();
+	int side = 1;
+	while(side * side < n)
+		side++;
+	const real size = 0.1f;
+	for(int k = 0; k < n; k++)
+		rigid_world.addBox((k % side - side / 2) * size, (k / side - side / 2) * size, size * 0.9f, size * 0.9f, 0, 5, 0.6f, 0.4f, 0.2f);
+	real radius = side * size;
+
+	ImpulseBatch batch;
+	for(int k = 0; k < n; k++)
+		batch.add(k, rigid_world.bodies[k].x - 0.01f, rigid_world.bodies[k].y, rigid_world.bodies[k].inv_mass);
+	batch.radial(radius, 1);
+	vector<real> dvx = batch.dvx, dvy = batch.dvy;
+	batch.radialScalar(radius, 1);
+	real error = 0;
+	for(int k = 0; k < n; k++)
+	{
+		real d = fabs(dvx[k] - batch.dvx[k]) + fabs(dvy[k] - batch.dvy[k]);
+		if(d > error)
+			error = d;
+	}
+
+	vector<int> shattered;
+	int pushed = 0;
+	struct timespec begin, end;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for(int s = 0; s < blasts; s++)
+		pushed = rigid_world.radialImpulse(0.01f * (s % 7), 0, radius, 1, shattered);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double elapsed = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) * 1e-9;
+	fprintf(stderr, "blast: %d blocks, %d pushed per blast, %d blasts in %.3f s (%.1f us per blast), %s kernel, max kernel error %g\n",
+	        n, pushed, blasts, elapsed, elapsed * 1e6 / blasts, impulseKernelName(), (double)error);
+}
+
+/* First static box of the level the ball fired at speed and angle touches
+ * within max_time, worked out in T by sweeping it against every box: the
+ * sweep of the simulation without the grid in front of it. Returns the
+ * time, or -1 with *body -1; (*x, *y) is the centre of the ball then. */
+template<typename T>
+static T sweepShot(T speed, T angle, T max_time, int* body, T* x, T* y)
+{
+	T s, c;
+	detSinCosDeg(angle, &s, &c);
+	BallPathT<T> p = { (T)-3.0, (T)-2.75, speed * c, 0, speed * s, (T)g };
+	T t_hit = -1;
+	*body = -1;
+	for(int i = 0; i < (int)obstacles.size(); i++)
+	{
+		const Obstacle& o = obstacles[i];
+		if(o.state != OBSTACLE_STATIC)
+			continue;
+		BoxT<T> b = { (T)o.box.xmin, (T)o.box.xmax, (T)o.box.ymin, (T)o.box.ymax };
+		T nx, ny;
+		T h = sweepCircleBox(p, (T)ball_radius, (T)0, max_time, b, &nx, &ny);
+		if(h >= 0 && (t_hit < 0 || h < t_hit))
+		{
+			t_hit = h;
+			*body = i;
+		}
+	}
+	*x = *y = 0;
+	if(*body >= 0)
+		pathPosition(p, t_hit, x, y);
+	return t_hit;
+}
+
+/* Where the ball fired at speed and angle is after time, flown in T by
+ * RK4 in whole steps of about sim_dt through the drag and wind of
+ * flight_params, ignoring the level */
+template<typename T>
+static void flyShot(T speed, T angle, T time, T* x, T* y)
+{
+	FlightParamsT<T> fp = defaultFlightParams<T>((T)g);
+	fp.drag = (T)flight_params.drag;
+	fp.wind_x = (T)flight_params.wind_x;
+	fp.wind_y = (T)flight_params.wind_y;
+	fp.gust = (T)flight_params.gust;
+	fp.gust_freq = (T)flight_params.gust_freq;
+	fp.gust_length = (T)flight_params.gust_length;
+	fp.strict_math = 1;
+	T s, c;
+	detSinCosDeg(angle, &s, &c);
+	BodyStateT<T> st = { (T)-3.0, (T)-2.75, speed * c, speed * s };
+	int steps = (int)ceil(time / sim_dt);
+	T h = steps > 0 ? time / steps : 0, h_next;
+	for(int k = 0; k < steps; k++)
+		integrateStep(INTEGRATOR_RK4, fp, k * h, st, h, (T)integrator_tol, &h_next);
+	*x = st.x;
+	*y = st.y;
+}
+
+/* One line of --check-double: the first box the shot hits and when, in
+ * float and in double, how far apart the two contacts are and how far
+ * apart the two flights are by then */
+static void checkDouble(float speed, float angle, real max_time, int* other_box, double* hit_error, double* flight_error)
+{
+	int body_f, body_d;
+	float xf, yf;
+	double xd, yd;
+	float tf = sweepShot<float>(speed, angle, (float)max_time, &body_f, &xf, &yf);
+	double td = sweepShot<double>(speed, angle, (double)max_time, &body_d, &xd, &yd);
+	double hit = body_f == body_d ? sqrt((xf - xd) * (xf - xd) + (yf - yd) * (yf - yd)) : 0;
+	double time = td >= 0 ? td : (double)max_time;
+	flyShot<float>(speed, angle, (float)time, &xf, &yf);
+	flyShot<double>(speed, angle, time, &xd, &yd);
+	double flight = sqrt((xf - xd) * (xf - xd) + (yf - yd) * (yf - yd));
+	printf("%.3f %.3f %d %d %.6f %.6f %.3g %.3g\n", speed, angle, body_f, body_d, tf, td, hit, flight);
+	if(body_f != body_d)
+		(*other_box)++;
+	if(hit > *hit_error)
+		*hit_error = hit;
+	if(flight > *flight_error)
+		*flight_error = flight;
+}
+
+/* Replaces the level with a floor and a thin wall and fires at the wall
+ * with every integrator while drag and a strong wind push the ball against
+ * it. Returns 1, and says which, if the ball ever ended a step inside the
+ * wall or behind it. */
+static int checkWall(int max_steps)
+{
+	for(int i = 0; i < (int)obstacles.size(); i++)
+		removeObstacle(i);
+	rigid_world.clear();
+	clearKinematics();
+	clearTargets();
+	addObstacle(-10.0f, 10.0f, -4.5f, -3.5f, 0.0f, 0.51f, 0.0f);
+	const Box wall = { 0.5f, 0.52f, -3.5f, 3.0f };
+	addObstacle(wall.xmin, wall.xmax, wall.ymin, wall.ymax, 0.4f, 0.6f, 0.6f);
+
+	static const int integrators[] = { INTEGRATOR_EULER, INTEGRATOR_RK4, INTEGRATOR_RK45 };
+	static const char* names[] = { "euler", "rk4", "rk45" };
+	static const real winds[] = { 10, 40 };
+	int saved_integrator = flight_integrator;
+	FlightParams saved_params = flight_params;
+	int failed = 0;
+	for(int k = 0; k < 3; k++)
+		for(int w = 0; w < 2; w++)
+		{
+			flight_integrator = integrators[k];
+			flight_params.drag = 0.5f;
+			flight_params.wind_x = winds[w];
+			resetBall();
+			u = 5;
+			thita = 30;
+			fireBall();
+			real deepest = 0;
+			int past = 0;
+			for(int step = 0; step < max_steps; step++)
+			{
+				updateBallPosition();
+				int state = advanceBall();
+				real nx, ny;
+				real gap = boxDistance(wall, x_cannonball, y_cannonball, &nx, &ny) - ball_radius;
+				if(x_cannonball > wall.xmax)
+					past = 1;
+				if(gap < deepest)
+					deepest = gap;
+				if(state != BALL_FLYING)
+					break;
+			}
+			resetBall();
+			if(past)
+				fprintf(stderr, "wall: %s, wind %g: the ball went through the wall\n", names[k], (double)winds[w]);
+			else if(deepest < -1e-3f)
+				fprintf(stderr, "wall: %s, wind %g: the ball got %.4f into the wall\n", names[k], (double)winds[w], -(double)deepest);
+			if(past || deepest < -1e-3f)
+				failed = 1;
+		}
+	flight_integrator = saved_integrator;
+	flight_params = saved_params;
+	fprintf(stderr, "wall: %s\n", failed ? "FAILED" : "ok");
+	return failed;
+}
+
+/* ./game --headless [--hz N] [--steps N] [--analytic] [--first-hit] [--events] [--deterministic] [--bench-batch N] [--bench-pairs N] [--bench-stack N [--stacks K]] [--bench-joints N] [--bench-blast N] [--check-wall] [--check-double]
+ * Reads one shot per line from stdin as "<initial velocity> <angle in degrees>"
+ * and prints one result line per shot on stdout. --events also logs what
+ * happened to each stepped shot on stderr. --analytic resolves the
+ * shots with solveShot() instead of stepping them, --first-hit only tells
+ * what each shot hits first with firstHit(); both need the closed-form
+ * flight and a level without blocks or moving boxes. --bench-batch times the
+ * ProjectileBatch kernel on N balls instead, --bench-pairs the broadphase
+ * on N moving boxes, --bench-stack the rigid body solver on N blocks in K
+ * pyramids (1 by default) and exits with 1 if they did not stand still and
+ * fall asleep, --bench-joints the joint solver on N planks of
+ * hanging bridges, --bench-blast one blast per step reaching N blocks.
+ * --check-wall fires into a thin wall against a strong wind with every
+ * integrator and exits with 1 if the ball ever gets into it.
+ * --check-double runs every shot through the float and the double
+ * versions of the sweep and of the RK4 flight and prints how far apart
+ * they end up. */
+int runHeadless(int argc, char** argv)
+{
+	int max_steps = -1;
+	int bench_balls = 0;
+	int bench_boxes = 0;
+	int bench_blocks = 0;
+	int bench_stacks = 1;
+	int bench_planks = 0;
+	int bench_blast = 0;
+	int check_wall = 0;
+	int check_double = 0;
+	int analytic = 0;
+	int first_hit = 0;
+	int events = 0;
+	parseSimulationArgs(argc, argv);
+	for(int i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "--steps") == 0 && i + 1 < argc)
+			max_steps = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--bench-batch") == 0 && i + 1 < argc)
+			bench_balls = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--bench-pairs") == 0 && i + 1 < argc)
+			bench_boxes = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--bench-stack") == 0 && i + 1 < argc)
+			bench_blocks = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--bench-joints") == 0 && i + 1 < argc)
+			bench_planks = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--bench-blast") == 0 && i + 1 < argc)
+			bench_blast = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--stacks") == 0 && i + 1 < argc)
+			bench_stacks = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--analytic") == 0)
+			analytic = 1;
+		else if(strcmp(argv[i], "--first-hit") == 0)
+			first_hit = 1;
+		else if(strcmp(argv[i], "--events") == 0)
+			events = 1;
+		else if(strcmp(argv[i], "--check-wall") == 0)
+			check_wall = 1;
+		else if(strcmp(argv[i], "--check-double") == 0)
+			check_double = 1;
+	}
+	if(max_steps < 0)
+		max_steps = (int)(10 * physics_hz); // the 10 second timeout of the game
+
+	if((analytic || first_hit) && flight_integrator != FLIGHT_CLOSED_FORM)
+	{
+		fprintf(stderr, "--analytic and --first-hit only support the closed-form flight, ignoring them\n");
+		analytic = 0;
+		first_hit = 0;
+	}
+	if((analytic || first_hit) && (rigid_world.levelBodies() > 0 || !kinematics.empty()))
+	{
+		fprintf(stderr, "--analytic and --first-hit only see the static boxes of the level, not its blocks or moving boxes, ignoring them\n");
+		analytic = 0;
+		first_hit = 0;
+	}
+	if(bench_balls > 0)
+	{
+		benchBatch(bench_balls, max_steps);
+		return 0;
+	}
+	if(bench_boxes > 0)
+	{
+		benchPairs(bench_boxes, 100);
+		return 0;
+	}
+	if(bench_blocks > 0)
+	{
+		return benchStack(bench_blocks, bench_stacks > 0 ? bench_stacks : 1, max_steps);
+	}
+	if(bench_planks > 0)
+	{
+		benchJoints(bench_planks, max_steps);
+		return 0;
+	}
+	if(bench_blast > 0)
+	{
+		benchBlast(bench_blast, max_steps);
+		return 0;
+	}
+	if(check_wall)
+		return checkWall(max_steps);
+
+	log_collisions = events;
+	initBall();
+	unsigned int log_cursor = sim_events.end();
+	unsigned int lost = 0;
+
+	// Deterministic runs print exact floats (%a) and the trace hash so the
+	// output can be cached and compared byte for byte
+	if(check_double)
+		printf("# u thita body body_double t t_double hit_error flight_error\n");
+	else if(first_hit)
+		printf("# u thita body t x y nx ny\n");
+	else if(analytic)
+		printf("# u thita bounces target1_t target2_t out_of_bounds x_end y_end\n");
+	else if(deterministic)
+		printf("# u thita steps target1_step target2_step out_of_bounds x_end y_end trace_hash\n");
+	else
+		printf("# u thita steps target1_step target2_step out_of_bounds x_end y_end\n");
+	clock_t start = clock();
+	int shots = 0;
+	int other_box = 0;
+	double hit_error = 0, flight_error = 0;
+	float speed, angle;
+	while(scanf("%f %f", &speed, &angle) == 2)
+	{
+		shots++;
+		if(check_double)
+		{
+			checkDouble(speed, angle, max_steps * sim_dt, &other_box, &hit_error, &flight_error);
+			continue;
+		}
+		if(first_hit)
+		{
+			QueryHit h;
+			if(!firstHit(speed, angle, max_steps * sim_dt, &h))
+				printf("%.3f %.3f -1\n", speed, angle);
+			else if(deterministic)
+				printf("%.3f %.3f %d %a %a %a %a %a\n", speed, angle, h.body, h.t, h.x, h.y, h.nx, h.ny);
+			else
+				printf("%.3f %.3f %d %.4f %.4f %.4f %.4f %.4f\n", speed, angle, h.body, h.t, h.x, h.y, h.nx, h.ny);
+			continue;
+		}
+		if(analytic)
+		{
+			SolvedShot r = solveShot(speed, angle, max_steps * sim_dt);
+			if(deterministic)
+				printf("%.3f %.3f %d %a %a %d %a %a\n", r.u, r.thita, r.bounces, r.target1_t, r.target2_t, r.out_of_bounds, r.x_end, r.y_end);
+			else
+				printf("%.3f %.3f %d %.4f %.4f %d %.4f %.4f\n", r.u, r.thita, r.bounces, r.target1_t, r.target2_t, r.out_of_bounds, r.x_end, r.y_end);
+			continue;
+		}
+		ShotResult r = simulateShot(speed, angle, max_steps);
+		SimEvent ev;
+		while(sim_events.read(&log_cursor, &ev, &lost))
+			if(log_collisions)
+				printEvent(stderr, ev);
+		if(deterministic)
+			printf("%.3f %.3f %d %d %d %d %a %a %08x\n", r.u, r.thita, r.steps, r.target1_step, r.target2_step, r.out_of_bounds, r.x_end, r.y_end, r.trace_hash);
+		else
+			printf("%.3f %.3f %d %d %d %d %.4f %.4f\n", r.u, r.thita, r.steps, r.target1_step, r.target2_step, r.out_of_bounds, r.x_end, r.y_end);
+	}
+	double elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+	fprintf(stderr, "%d shots in %.3f s\n", shots, elapsed);
+	if(check_double)
+		fprintf(stderr, "float against double: %d shots hit another box, contacts up to %.3g apart, flights up to %.3g apart\n",
+		        other_box, hit_error, flight_error);
+	if(log_collisions && lost)
+		fprintf(stderr, "%u events were overwritten before they were logged\n", lost);
+	return 0;
+}
@@ -0,0 +1,127 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "integrator.h"
+#include "scene_query.h"
+
+/* Cannon ball physics shared by the game loop and the headless runner.
+ * Nothing in here may touch OpenGL or GLFW. What happens to the ball
+ * (contacts, coming to rest, leaving the play area) goes to sim_events
+ * (events.h) instead of flags. */
+
+extern real u;
+extern real g;
+extern real thita;
+extern real thita_ball;
+extern int ball_in_play;    // 1 from fireBall() until the ball is reset
+extern int fl;
+extern real t;
+extern real x_cannonball;
+extern real y_cannonball;
+extern real e;
+extern real v;
+extern real ux;
+extern real uy;
+extern real vx;
+extern real vy;
+extern real x_till_collision;
+extern real y_till_collision;
+extern real t_till_now;
+extern int log_collisions;
+extern real ball_radius;
+extern real ball_mass;      // against the blocks of rigid_world
+extern real prev_x_cannonball;
+extern real prev_y_cannonball;
+extern real physics_hz;
+extern real time_scale;
+extern real sim_dt;
+extern int flight_integrator;
+extern FlightParams flight_params;
+extern real integrator_tol;
+extern real mu;            // friction between the ball and every surface
+extern real rest_speed;    // contacts slower than this don't bounce
+extern int ball_asleep;     // 1 once the ball came to rest
+extern real sleep_energy;  // kinetic energy per unit mass the ball rests below
+extern real sleep_time;    // time it has to stay below it, touching something
+extern int split_birds;    // birds splitBall() adds
+extern real split_spread;  // degrees between them
+extern real split_size;    // their radius over ball_radius
+extern int entity_capacity; // slots of the entity pool, made by parseSimulationArgs()
+extern real blast_radius;  // reach of explodeBall()
+extern real blast_impulse; // its push at the centre, falling off to 0 at blast_radius
+/* 1 for bit-reproducible shots: launch angles go through detmath instead of
+ * libm and RK45 uses a step controller without pow(). Steps are fixed
+ * anyway, and the build keeps the real operations unfused and in order. */
+extern int deterministic;
+
+/* flight_integrator value for the original closed-form parabola */
+#define FLIGHT_CLOSED_FORM -1
+
+/* Return values of advanceBall() */
+#define BALL_IDLE 0
+#define BALL_FLYING 1
+#define BALL_RESET 2
+#define BALL_RESTING 3
+
+void setPhysicsRate(real hz);
+void parseSimulationArgs(int argc, char** argv);
+void initBall();
+void resetBall();
+void fireBall();
+void updateBallPosition();
+int advanceBall();
+void advanceBodies();
+/* Splits the ball in flight, once per shot: split_birds birds of their own
+ * (entities.h) leave where it is, fanned out split_spread degrees apart on
+ * either side of it, and it flies on. Returns the birds made. */
+int splitBall();
+/* Blast of radius at (x, y) with a push of impulse at the centre: the
+ * blocks of rigid_world it reaches fly off, the breakable ones pushed
+ * harder than their strength shatter, the live targets it reaches are hit
+ * and a puff shows where it went off. Returns the blocks pushed. */
+int explode(real x, real y, real radius, real impulse);
+/* The bomb bird: the ball in flight blows up where it is with blast_radius
+ * and blast_impulse and is gone. Returns the blocks pushed, -1 if there
+ * was no ball to blow up. */
+int explodeBall();
+/* Moves every entity on by one physics step: the birds of a split fly,
+ * debris whose time is up or whose body went away dies, effects age.
+ * Called after advanceBall(), before advanceBodies(). Returns the birds
+ * still flying. */
+int advanceEntities();
+
+/* Result of one shot resolved without a window */
+struct ShotResult {
+	real u;
+	real thita;
+	int steps;           // physics steps simulated until the shot ended
+	int target1_step;   // step the ball hit targets[0] at, -1 if never
+	int target2_step;   // step the ball hit targets[1] at, -1 if never
+	int out_of_bounds;   // 1 if the shot ended by leaving the play area
+	real x_end;
+	real y_end;
+	unsigned int trace_hash; // FNV-1a of the ball position bits at every step
+};
+
+ShotResult simulateShot(real speed, real angle, int max_steps);
+
+/* Result of solveShot(). Times are simulated seconds since the shot was fired. */
+struct SolvedShot {
+	real u;
+	real thita;
+	int bounces;
+	real target1_t;     // -1 if the ball never entered targets[0]
+	real target2_t;     // -1 if the ball never entered targets[1]
+	int out_of_bounds;
+	real t_end;
+	real x_end;
+	real y_end;
+};
+
+SolvedShot solveShot(real speed, real angle, real max_time);
+
+/* First thing a shot hits, without simulating it. 0 if nothing. */
+int firstHit(real speed, real angle, real max_time, QueryHit* hit);
+int runHeadless(int argc, char** argv);
+
+#endif
@@ -0,0 +1,129 @@
+#include "targets.h"
+#include "events.h"
+
+using namespace std;
+
+/* The two blocks of the original game, one standing on the other */
+static const Target default_targets[] = {
+	{ { 1.5f, 2.5f, -3.0f, -2.0f }, 1, -1, 5 }, // Target1
+	{ { 1.6f, 2.4f, -2.0f, -1.0f }, 1, -1, 5 }, // Target2
+};
+
+vector<Target> targets(default_targets, default_targets + sizeof(default_targets) / sizeof(default_targets[0]));
+int score = 0;
+int target_version = 0;
+
+/* Indices of the live targets, in no particular order, and a box around
+ * them that most steps never enter */
+static vector<int> live;
+static Box live_bounds;
+static int live_version = -1;
+
+/* Rebuilds live after targets changed */
+static void updateLive()
+{
+	live.clear();
+	live_bounds.xmin = live_bounds.ymin = 1e30f;
+	live_bounds.xmax = live_bounds.ymax = -1e30f;
+	for(int i = 0; i < (int)targets.size(); i++)
+	{
+		if(!targets[i].alive)
+			continue;
+		const Box& b = targets[i].box;
+		live.push_back(i);
+		if(b.xmin < live_bounds.xmin) live_bounds.xmin = b.xmin;
+		if(b.xmax > live_bounds.xmax) live_bounds.xmax = b.xmax;
+		if(b.ymin < live_bounds.ymin) live_bounds.ymin = b.ymin;
+		if(b.ymax > live_bounds.ymax) live_bounds.ymax = b.ymax;
+	}
+	live_version = target_version;
+}
+
+int addTarget(real xmin, real xmax, real ymin, real ymax, int points)
+{
+	Target tg = { { xmin, xmax, ymin, ymax }, 1, -1, points };
+	targets.push_back(tg);
+	target_version++;
+	return (int)targets.size() - 1;
+}
+
+void clearTargets()
+{
+	targets.clear();
+	target_version++;
+}
+
+void resetTargets()
+{
+	for(int i = 0; i < (int)targets.size(); i++)
+	{
+		targets[i].alive = 1;
+		targets[i].hit_t = -1;
+	}
+	target_version++;
+}
+
+int hitTargets(real x, real y, real t)
+{
+	if(live_version != target_version)
+		updateLive();
+	if(x < live_bounds.xmin || x > live_bounds.xmax || y < live_bounds.ymin || y > live_bounds.ymax)
+		return 0;
+	int hits = 0;
+	for(int k = 0; k < (int)live.size(); k++)
+	{
+		Target& tg = targets[live[k]];
+		if(x < tg.box.xmin || x > tg.box.xmax || y < tg.box.ymin || y > tg.box.ymax)
+			continue;
+		tg.alive = 0;
+		tg.hit_t = t;
+		SimEvent ev = { EVENT_TARGET, live[k], t, x, y, 0, 0, 0 };
+		sim_events.push(ev);
+		hits++;
+		// The last live one takes its place and is looked at next
+		live[k--] = live.back();
+		live.pop_back();
+	}
+	if(hits)
+		target_version++; // live_bounds shrinks on the next call
+	return hits;
+}
+
+int blastTargets(real x, real y, real r, real t)
+{
+	if(live_version != target_version)
+		updateLive();
+	if(x < live_bounds.xmin - r || x > live_bounds.xmax + r || y < live_bounds.ymin - r || y > live_bounds.ymax + r)
+		return 0;
+	int hits = 0;
+	for(int k = 0; k < (int)live.size(); k++)
+	{
+		Target& tg = targets[live[k]];
+		// Closest point of the box to the centre
+		real cx = x < tg.box.xmin ? tg.box.xmin : (x > tg.box.xmax ? tg.box.xmax : x);
+		real cy = y < tg.box.ymin ? tg.box.ymin : (y > tg.box.ymax ? tg.box.ymax : y);
+		if((cx - x) * (cx - x) + (cy - y) * (cy - y) > r * r)
+			continue;
+		tg.alive = 0;
+		tg.hit_t = t;
+		SimEvent ev = { EVENT_TARGET, live[k], t, x, y, 0, 0, 0 };
+		sim_events.push(ev);
+		hits++;
+		live[k--] = live.back();
+		live.pop_back();
+	}
+	if(hits)
+		target_version++;
+	return hits;
+}
+
+int scoreEvents(unsigned int* cursor)
+{
+	int points = 0;
+	SimEvent ev;
+	while(sim_events.read(cursor, &ev))
+		if(ev.type == EVENT_TARGET && ev.body < (int)targets.size())
+			points += targets[ev.body].points;
+	score += points;
+	return points;
+}
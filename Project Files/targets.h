@@ -0,0 +1,45 @@
+#ifndef TARGETS_H
+#define TARGETS_H
+
+#include <vector>
+
+#include "collision.h"
+
+/* What the player shoots at. A target is hit the first time the centre of
+ * the ball is inside its box; the physics step tests that and writes an
+ * EVENT_TARGET event, scoreEvents() turns those into points and the game
+ * only draws the targets still alive. Only live targets are tested, so a
+ * level with hundreds of them costs a few comparisons per live target per
+ * step. No OpenGL in here. */
+
+struct Target {
+	Box box;
+	int alive;     // 0 once hit
+	real hit_t;    // shot time it was hit at, -1 while alive
+	int points;
+};
+
+extern std::vector<Target> targets;
+extern int score;
+extern int target_version; // changes whenever a target is added, hit or brought back
+
+/* Adds a target and returns its index */
+int addTarget(real xmin, real xmax, real ymin, real ymax, int points);
+/* Removes every target */
+void clearTargets();
+/* Brings every target back and forgets the hits */
+void resetTargets();
+
+/* Marks the live targets containing (x, y) as hit at shot time t and
+ * returns how many. Each one also goes to sim_events as EVENT_TARGET. */
+int hitTargets(real x, real y, real t);
+
+/* Same for the live targets whose box comes within r of (x, y), as a
+ * blast does */
+int blastTargets(real x, real y, real r, real t);
+
+/* Adds the points of every EVENT_TARGET after *cursor in sim_events to
+ * score. Returns the points added. */
+int scoreEvents(unsigned int* cursor);
+
+#endif